@@ -1,19 +1,24 @@
 #include "buffer.h"
 
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+
 namespace MiniServer {
 
+const size_t Buffer::READ_SIZE_MIN;
+const size_t Buffer::READ_SIZE_MAX;
+
 size_t Buffer::get_readable_bytes() const { return write_pos_ - read_pos_; }
 
-char *Buffer::get_read_ptr() {
-  // 先解除iterator再取地址
-  return &(*buffer_.begin()) + read_pos_;
-}
+char *Buffer::get_read_ptr() { return data_ + read_pos_; }
 
-char *Buffer::get_write_ptr() { return &(*buffer_.begin()) + write_pos_; }
+char *Buffer::get_write_ptr() { return data_ + write_pos_; }
 
 void Buffer::move_read_ptr(size_t len) {
   if (len > write_pos_ - read_pos_) {
-    read_pos_ = write_pos_ = 0;
+    clear();
   } else {
     read_pos_ += len;
   }
@@ -21,49 +26,172 @@ void Buffer::move_read_ptr(size_t len) {
 
 void Buffer::make_space(size_t len) {
   // 本身空间就够
-  // 1024(size) - 1023(write_pos) = 1 剩余1023这个位置
-  int remaining_bytes = buffer_.size() - write_pos_;
-  if (remaining_bytes > len) return;
-
-  // 加上已读的空间足够
-  // read_pos_ = 1 (0读过了 1没有读)
-  int used_bytes = read_pos_;
-  if (remaining_bytes + used_bytes > len) {
-    size_t readable_bytes = get_readable_bytes();
-    std::copy(get_read_ptr(), get_write_ptr(), &(*buffer_.begin()));
+  size_t remaining_bytes = capacity_ - write_pos_;
+  if (remaining_bytes >= len) return;
+
+  size_t readable_bytes = get_readable_bytes();
+  // 加上已读的空间足够,把未读数据移到开头即可(pin 住时不能移动)
+  if (pin_count_ == 0 && remaining_bytes + read_pos_ >= len) {
+    memmove(data_, get_read_ptr(), readable_bytes);
     read_pos_ = 0;
     write_pos_ = readable_bytes;
+    return;
   }
 
-  buffer_.resize(buffer_.size() + len);
+  // 容量翻倍,不够时按需要的大小
+  size_t capacity = std::max(
+      {capacity_ * 2, readable_bytes + len, initial_size_});
+  char *data;
+  bool pooled = capacity <= ChunkPool::CHUNK_SIZE;
+  if (pooled) {
+    data = ChunkPool::get_instance()->acquire();
+    capacity = ChunkPool::CHUNK_SIZE;
+  } else {
+    data = new char[capacity];
+  }
+  if (readable_bytes > 0) {
+    memcpy(data, get_read_ptr(), readable_bytes);
+  }
+  free_();
+  data_ = data;
+  capacity_ = capacity;
+  pooled_ = pooled;
+  read_pos_ = 0;
+  write_pos_ = readable_bytes;
 }
 
 void Buffer::move_write_ptr(size_t len) {
-  assert((buffer_.size() - write_pos_) >= len);
+  assert((capacity_ - write_pos_) >= len);
   write_pos_ += len;
 }
 
 void Buffer::clear() {
+  if (pin_count_ > 0) {
+    // 已有的数据还在被引用,只跳过,不覆盖
+    read_pos_ = write_pos_.load();
+    return;
+  }
+  read_pos_ = 0;
+  write_pos_ = 0;
+}
+
+void Buffer::release() {
+  free_();
   read_pos_ = 0;
   write_pos_ = 0;
 }
 
+void Buffer::free_() {
+  if (data_ == nullptr) {
+    return;
+  }
+  if (pin_count_ > 0) {
+    retired_.emplace_back(data_, pooled_);
+  } else {
+    free_storage_(data_, pooled_);
+  }
+  data_ = nullptr;
+  capacity_ = 0;
+  pooled_ = false;
+}
+
+void Buffer::free_storage_(char *data, bool pooled) {
+  if (pooled) {
+    ChunkPool::get_instance()->release(data);
+  } else {
+    delete[] data;
+  }
+}
+
+void Buffer::free_retired_() {
+  for (auto &storage : retired_) {
+    free_storage_(storage.first, storage.second);
+  }
+  retired_.clear();
+}
+
+void Buffer::pin() { pin_count_++; }
+
+void Buffer::unpin() {
+  assert(pin_count_ > 0);
+  if (--pin_count_ == 0) {
+    free_retired_();
+  }
+}
+
+void Buffer::swap(Buffer &other) {
+  assert(pin_count_ == 0 && other.pin_count_ == 0);
+  std::swap(data_, other.data_);
+  std::swap(capacity_, other.capacity_);
+  std::swap(pooled_, other.pooled_);
+  size_t read_pos = read_pos_;
+  size_t write_pos = write_pos_;
+  read_pos_ = other.read_pos_.load();
+  write_pos_ = other.write_pos_.load();
+  other.read_pos_ = read_pos;
+  other.write_pos_ = write_pos;
+}
+
 std::string Buffer::read(size_t len) {
   len = len > get_readable_bytes() ? get_readable_bytes() : len;
+  if (len == 0) {
+    return std::string();
+  }
 
-  std::string str(get_read_ptr(), get_read_ptr() + len);
+  std::string str(get_read_ptr(), len);
   read_pos_ += len;
   return str;
 }
 
 std::string Buffer::read_all() { return read(get_readable_bytes()); }
 
+StringView Buffer::peek_view(size_t len) const {
+  len = std::min(len, get_readable_bytes());
+  if (len == 0) {
+    return StringView();
+  }
+  return StringView(data_ + read_pos_, len);
+}
+
+const char *Buffer::find_crlf() const { return find_crlf(data_ + read_pos_); }
+
+const char *Buffer::find_crlf(const char *start) const {
+  const char *end = data_ + write_pos_;
+  assert(start >= data_ + read_pos_ && start <= end);
+  // 先用 memchr 找 CR,再确认后面是 LF
+  while (end - start >= 2) {
+    const char *cr =
+        static_cast<const char *>(memchr(start, '\r', end - start - 1));
+    if (cr == nullptr) {
+      return nullptr;
+    }
+    if (cr[1] == '\n') {
+      return cr;
+    }
+    start = cr + 1;
+  }
+  return nullptr;
+}
+
+void Buffer::consume(size_t len) {
+  assert(len <= get_readable_bytes());
+  read_pos_ += len;
+}
+
+void Buffer::consume_until(const char *end) {
+  assert(end >= data_ + read_pos_ && end <= data_ + write_pos_);
+  read_pos_ = end - data_;
+}
+
 void Buffer::write_buffer(const std::string &str) {
   write_buffer(str.data(), str.size());
 }
 
 // 将其他写函数转换至通用接口
 void Buffer::write_buffer(const char *str, size_t len) {
+  if (len == 0) {
+    return;
+  }
   assert(str);
   make_space(len);
   std::copy(str, str + len, get_write_ptr());
@@ -71,7 +199,6 @@ void Buffer::write_buffer(const char *str, size_t len) {
 }
 
 void Buffer::write_buffer(const void *data, size_t len) {
-  assert(data);
   write_buffer(static_cast<const char *>(data), len);
 }
 
@@ -80,26 +207,21 @@ void Buffer::write_buffer(Buffer &buff) {
 }
 
 ssize_t Buffer::read_fd(int fd, int *errno_) {
-  // IPv4的数据报最大大小是65535字节
-  char buff[65536];
-  struct iovec iov[2];
-  const size_t writeable_bytes = buffer_.size() - write_pos_;
-
-  iov[0].iov_base = get_write_ptr();
-  iov[0].iov_len = writeable_bytes;
-  iov[1].iov_base = buff;
-  iov[1].iov_len = sizeof(buff);
-
-  const ssize_t len = readv(fd, iov, 2);
-
-  if (len < 0) {
-    *errno_ = errno;
-  } else if (static_cast<size_t>(len) < writeable_bytes) {
-    write_pos_ += len;
-  } else {
-    write_pos_ = buffer_.size();
-    write_buffer(buff, len - writeable_bytes);
+  size_t expected = read_sizer_.expected(fd);
+  if (get_writable_bytes() < expected) {
+    make_space(expected);
   }
+  const size_t writeable_bytes = get_writable_bytes();
+
+  const ssize_t len = ::read(fd, get_write_ptr(), writeable_bytes);
+  read_sizer_.record(len, writeable_bytes);
+  if (len <= 0) {
+    if (len < 0) {
+      *errno_ = errno;
+    }
+    return len;
+  }
+  write_pos_ += len;
   return len;
 }
 
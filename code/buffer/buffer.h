@@ -7,14 +7,45 @@
 
 #include <atomic>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "buffer/chunk_pool.h"
+#include "buffer/read_sizer.h"
+#include "buffer/string_view.h"
+
+/*
+存储在第一次写入时才分配: 不超过 ChunkPool::CHUNK_SIZE 时从共享的块池借用,
+更大时直接向系统申请; 空间不够时容量翻倍
+连接空闲时调用 release 归还存储,空闲连接不占缓冲区
+read_fd 直接读入自己的存储,不经过栈上的中转数组,预留的空间由 ReadSizer 按读取历史估计
+peek_view 等接口不复制地查看可读数据; 解析请求时 pin 住存储,
+请求处理完成(unpin)前已有的数据不会被移动或覆盖,指向其中的视图一直有效
+*/
 namespace MiniServer {
 
 class Buffer {
  public:
-  Buffer(int size = 1024) : buffer_(size), read_pos_(0), write_pos_(0){};
-  ~Buffer() = default;
+  // read_fd 根据读取历史预留的空间范围
+  static const size_t READ_SIZE_MIN = ReadSizer::MIN_SIZE;
+  static const size_t READ_SIZE_MAX = ReadSizer::MAX_SIZE;
+
+  // size: 第一次分配时至少分配的大小
+  Buffer(int size = 1024)
+      : data_(nullptr),
+        capacity_(0),
+        pooled_(false),
+        initial_size_(size),
+        pin_count_(0),
+        read_pos_(0),
+        write_pos_(0){};
+  ~Buffer() {
+    pin_count_ = 0;
+    free_();
+    free_retired_();
+  }
+  Buffer(const Buffer&) = delete;
+  Buffer& operator=(const Buffer&) = delete;
 
   // 读取缓存(获取可读字节数,获取读指针，移动读指针)
   size_t get_readable_bytes() const;
@@ -22,16 +53,39 @@ class Buffer {
   void move_read_ptr(size_t len);
 
   // 写入缓存(确保有足够空间写入)
+  size_t get_writable_bytes() const { return capacity_ - write_pos_; }
   void make_space(size_t len);
   char* get_write_ptr();
   void move_write_ptr(size_t len);
 
   void clear();
+  // 清空并归还存储(借用的块还给块池),下次写入时重新分配
+  void release();
+  // 当前持有的存储大小, 0 表示没有
+  size_t capacity() const { return capacity_; }
+  // 交换存储和读写位置,用于不复制地转交数据(双方都不能被 pin 住)
+  void swap(Buffer& other);
 
   // 读取缓存 string
   std::string read(size_t len);
   std::string read_all();
 
+  // 不复制地查看可读数据(最多 len 字节),写入新数据后视图可能失效,除非已经 pin 住
+  StringView peek_view(size_t len = static_cast<size_t>(-1)) const;
+  // 在可读数据中从 start(默认读指针)开始查找 "\r\n",找不到返回 nullptr
+  const char* find_crlf() const;
+  const char* find_crlf(const char* start) const;
+  // 消耗 len 字节 / 消耗到 end(不含)为止,数据本身保持不变
+  void consume(size_t len);
+  void consume_until(const char* end);
+
+  // pin 住期间已有的数据(包括已消耗的)不会被移动或覆盖:
+  // 不再整理空间,clear 不再回到开头,需要更大空间时换一块新存储,
+  // 旧存储保留到最后一次 unpin 才释放
+  void pin();
+  void unpin();
+  bool is_pinned() const { return pin_count_ > 0; }
+
   // 写入缓存 (string char* Buffer)
   void write_buffer(const std::string& str);
   void write_buffer(const char* str, size_t len);
@@ -40,11 +94,28 @@ class Buffer {
 
   // 文件接口
   // errno_后缀是为了和系统的errno变量区分
+  // read_fd 一次最多读满预留的空间,非阻塞的 fd 需要调用到 EAGAIN 为止
   ssize_t read_fd(int fd, int* errno_);
+  // 下一次 read_fd 按历史预留的空间
+  size_t get_read_size() const { return read_sizer_.get_read_size(); }
   ssize_t write_fd(int fd, int* errno_);
 
  private:
-  std::vector<char> buffer_;
+  // 释放存储,不修改读写位置; pin 住时放入 retired_ 延后释放
+  void free_();
+  static void free_storage_(char* data, bool pooled);
+  void free_retired_();
+
+  char* data_;
+  size_t capacity_;
+  // data_ 是否从 ChunkPool 借用
+  bool pooled_;
+  size_t initial_size_;
+  // 根据读取历史估计 read_fd 预留的空间
+  ReadSizer read_sizer_;
+  // pin 的次数,以及 pin 住期间被换下的存储(地址,是否从块池借用)
+  int pin_count_;
+  std::vector<std::pair<char*, bool>> retired_;
   std::atomic<std::size_t> read_pos_;
   std::atomic<std::size_t> write_pos_;
 };
@@ -0,0 +1,221 @@
+#include "chain_buffer.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+
+#include <algorithm>
+
+namespace MiniServer {
+
+// clear 后最多保留的空 Buffer 数,流水线上的动态响应一般不多
+static const size_t MAX_SPARE_BUFFERS = 4;
+
+ChainBuffer::ChainBuffer()
+    : slice_index_(0), readable_bytes_(0), chunk_used_(0) {}
+
+ChainBuffer::~ChainBuffer() { clear(); }
+
+void ChainBuffer::append(const char *data, size_t len) {
+  assert(data != nullptr || len == 0);
+  if (len == 0) {
+    return;
+  }
+  if (len > CHUNK_SIZE) {
+    std::unique_ptr<char[]> chunk(new char[len]);
+    std::copy(data, data + len, chunk.get());
+    push_({SK_MEMORY, chunk.get(), len, -1, 0, false});
+    large_chunks_.push_back(std::move(chunk));
+    return;
+  }
+  if (chunks_.empty() || CHUNK_SIZE - chunk_used_ < len) {
+    chunks_.push_back(ChunkPool::get_instance()->acquire());
+    chunk_used_ = 0;
+  }
+  char *dst = chunks_.back() + chunk_used_;
+  std::copy(data, data + len, dst);
+  chunk_used_ += len;
+
+  if (slices_.size() > slice_index_) {
+    Slice &last = slices_.back();
+    if (last.in_chunk && last.data + last.len == dst) {
+      // 与上一次复制的数据相邻,合并为一个片段
+      last.len += len;
+      readable_bytes_ += len;
+      return;
+    }
+  }
+  push_({SK_MEMORY, dst, len, -1, 0, true});
+}
+
+void ChainBuffer::append(const std::string &str) {
+  append(str.data(), str.size());
+}
+
+void ChainBuffer::append_static(const char *data, size_t len) {
+  push_({SK_MEMORY, data, len, -1, 0, false});
+}
+
+void ChainBuffer::append_buffer(Buffer &buff) {
+  size_t len = buff.get_readable_bytes();
+  if (len == 0) {
+    return;
+  }
+  std::unique_ptr<Buffer> adopted;
+  if (spare_buffers_.empty()) {
+    adopted.reset(new Buffer());
+  } else {
+    adopted = std::move(spare_buffers_.back());
+    spare_buffers_.pop_back();
+  }
+  // 交换后 buff 拿到空的存储,数据留在 adopted 中直到发送完成
+  adopted->swap(buff);
+  push_({SK_MEMORY, adopted->get_read_ptr(), len, -1, 0, false});
+  buffers_.push_back(std::move(adopted));
+}
+
+void ChainBuffer::append_mapped(char *addr, size_t len) {
+  assert(addr != nullptr);
+  // 片段发送时会移动 data,按原始地址和长度记录,clear 时释放
+  mapped_.push_back({addr, len});
+  push_({SK_MAPPED, addr, len, -1, 0, false});
+}
+
+void ChainBuffer::append_file(int fd, off_t offset, size_t len) {
+  assert(fd >= 0);
+  push_({SK_FILE, nullptr, len, fd, offset, false});
+}
+
+void ChainBuffer::push_(const Slice &slice) {
+  if (slice.len == 0) {
+    // 空文件也要关闭
+    Slice empty = slice;
+    release_(empty);
+    return;
+  }
+  slices_.push_back(slice);
+  readable_bytes_ += slice.len;
+}
+
+ssize_t ChainBuffer::write_fd(int fd, int *errno_) {
+  if (slice_index_ >= slices_.size()) {
+    return 0;
+  }
+  ssize_t len;
+  Slice &first = slices_[slice_index_];
+  if (first.kind == SK_FILE) {
+    // sendfile 会更新 offset,这里只需要扣掉长度
+    off_t offset = first.offset;
+    len = sendfile(fd, first.fd, &offset, first.len);
+    if (len == 0 && first.len > 0) {
+      // 文件在发送过程中被截断,剩下的部分永远发不出去
+      *errno_ = EIO;
+      return -1;
+    }
+  } else {
+    // 连续的内存片段一次 writev 发送
+    struct iovec iov[IOV_MAX];
+    int count = 0;
+    for (size_t i = slice_index_; i < slices_.size() && count < IOV_MAX; i++) {
+      const Slice &slice = slices_[i];
+      if (slice.kind == SK_FILE) {
+        break;
+      }
+      iov[count].iov_base = const_cast<char *>(slice.data);
+      iov[count].iov_len = slice.len;
+      count++;
+    }
+    len = writev(fd, iov, count);
+  }
+  if (len < 0) {
+    *errno_ = errno;
+    return len;
+  }
+  consume_(len);
+  return len;
+}
+
+void ChainBuffer::consume_(size_t len) {
+  assert(len <= readable_bytes_);
+  readable_bytes_ -= len;
+  while (len > 0) {
+    Slice &slice = slices_[slice_index_];
+    if (len >= slice.len) {
+      // 发送完的文件立即关闭
+      len -= slice.len;
+      release_(slice);
+      slice_index_++;
+    } else {
+      if (slice.kind == SK_FILE) {
+        slice.offset += len;
+      } else {
+        slice.data += len;
+      }
+      slice.len -= len;
+      len = 0;
+    }
+  }
+}
+
+std::string ChainBuffer::to_string() const {
+  std::string str;
+  str.reserve(readable_bytes_);
+  for (size_t i = slice_index_; i < slices_.size(); i++) {
+    const Slice &slice = slices_[i];
+    if (slice.kind != SK_FILE) {
+      str.append(slice.data, slice.len);
+      continue;
+    }
+    size_t begin = str.size();
+    str.resize(begin + slice.len);
+    size_t done = 0;
+    while (done < slice.len) {
+      ssize_t n = pread(slice.fd, &str[begin + done], slice.len - done,
+                        slice.offset + done);
+      if (n <= 0) {
+        // 文件被截断,只返回读到的部分
+        str.resize(begin + done);
+        break;
+      }
+      done += n;
+    }
+  }
+  return str;
+}
+
+void ChainBuffer::clear() {
+  for (size_t i = slice_index_; i < slices_.size(); i++) {
+    release_(slices_[i]);
+  }
+  slices_.clear();
+  slice_index_ = 0;
+  for (auto &mapped : mapped_) {
+    munmap(mapped.first, mapped.second);
+  }
+  mapped_.clear();
+  readable_bytes_ = 0;
+
+  for (char *chunk : chunks_) {
+    ChunkPool::get_instance()->release(chunk);
+  }
+  chunks_.clear();
+  chunk_used_ = 0;
+  large_chunks_.clear();
+  for (auto &buffer : buffers_) {
+    if (spare_buffers_.size() < MAX_SPARE_BUFFERS) {
+      buffer->release();
+      spare_buffers_.push_back(std::move(buffer));
+    }
+  }
+  buffers_.clear();
+}
+
+void ChainBuffer::release_(Slice &slice) {
+  if (slice.kind == SK_FILE && slice.fd >= 0) {
+    close(slice.fd);
+    slice.fd = -1;
+  }
+}
+
+}  // namespace MiniServer
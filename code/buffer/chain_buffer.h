@@ -0,0 +1,104 @@
+#pragma once
+
+#include <assert.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "buffer/buffer.h"
+#include "buffer/chunk_pool.h"
+
+/*
+链式输出缓冲区,待发送的数据由若干片段按顺序组成:
+  SK_MEMORY: 内存片段,可以是自己的块中复制的数据、接管的 Buffer、调用者保证有效的静态数据
+  SK_MAPPED: 映射到内存的文件,与内存片段一起 writev, clear 时 munmap
+  SK_FILE:   文件区间,用 sendfile 发送,发送完成或 clear 时关闭文件
+write_fd 每次把连续的内存片段合并为一次 writev,遇到文件区间时 sendfile,
+响应头、动态路由的响应体、静态数据和流水线上的多个响应都不需要先拼接到一个缓冲区
+*/
+namespace MiniServer {
+
+class ChainBuffer {
+ public:
+  enum SLICE_KIND {
+    SK_MEMORY,
+    SK_MAPPED,
+    SK_FILE,
+  };
+
+  // 复制的数据存放在从 ChunkPool 借用的块中,块满了再借新块,已有数据不移动
+  static const size_t CHUNK_SIZE = ChunkPool::CHUNK_SIZE;
+
+  ChainBuffer();
+  ~ChainBuffer();
+  ChainBuffer(const ChainBuffer&) = delete;
+  ChainBuffer& operator=(const ChainBuffer&) = delete;
+
+  // 复制数据到自己的块中,与上一个复制的片段相邻时合并
+  void append(const char* data, size_t len);
+  void append(const std::string& str);
+  // 不复制,调用者保证发送完成(clear)前 data 有效,如静态的响应头
+  void append_static(const char* data, size_t len);
+  // 接管 buff 中的可读数据(交换存储,不复制), buff 变为空的缓冲区
+  void append_buffer(Buffer& buff);
+  // 映射的文件,发送完成后 munmap
+  void append_mapped(char* addr, size_t len);
+  // 文件区间 [offset, offset+len),发送完成后关闭 fd
+  void append_file(int fd, off_t offset, size_t len);
+
+  // 未发送的字节数和片段数
+  size_t get_readable_bytes() const { return readable_bytes_; }
+  size_t get_slice_count() const { return slices_.size() - slice_index_; }
+
+  // 发送一次(一次 writev 或一次 sendfile),返回发送的字节数,出错时返回 -1 并设置 errno_
+  // 文件被截断导致 sendfile 发不出剩下的部分时 errno_ 为 EIO
+  ssize_t write_fd(int fd, int* errno_);
+
+  // 复制出所有未发送的数据(文件用 pread 读取),用于测试和调试
+  std::string to_string() const;
+
+  // 释放所有片段,借用的块和接管的 Buffer 的存储都还给块池
+  void clear();
+
+ private:
+  struct Slice {
+    SLICE_KIND kind;
+    // 内存和映射文件的当前位置
+    const char* data;
+    size_t len;
+    // 文件区间的 fd 和当前偏移
+    int fd;
+    off_t offset;
+    // 是否为自己块中的数据,可以与后面复制的数据合并
+    bool in_chunk;
+  };
+
+  void push_(const Slice& slice);
+  // 跳过已发送的 len 字节
+  void consume_(size_t len);
+  // 关闭文件区间的 fd
+  static void release_(Slice& slice);
+
+  std::vector<Slice> slices_;
+  // 第一个未发送完的片段
+  size_t slice_index_;
+  size_t readable_bytes_;
+
+  // 复制数据用的块,最后一块还有 chunk_used_ 之后的空间
+  std::vector<char*> chunks_;
+  size_t chunk_used_;
+  // 超过块大小的数据单独分配,发送完成后释放
+  std::vector<std::unique_ptr<char[]>> large_chunks_;
+  // 接管的 Buffer,以及 clear 后留作交换的空 Buffer(不持有存储)
+  std::vector<std::unique_ptr<Buffer>> buffers_;
+  std::vector<std::unique_ptr<Buffer>> spare_buffers_;
+  // 映射的文件(地址,长度), clear 时 munmap
+  std::vector<std::pair<char*, size_t>> mapped_;
+};
+
+}  // namespace MiniServer
@@ -0,0 +1,142 @@
+#include "chunk_pool.h"
+
+#include <algorithm>
+
+namespace MiniServer {
+
+const size_t ChunkPool::CHUNK_SIZE;
+const size_t ChunkPool::THREAD_CACHE_SIZE;
+
+// 线程的缓存已经析构: 线程退出时,之后析构的对象(如静态对象)仍可能借还块
+// bool 不需要析构,在线程退出的整个过程中都可以访问
+static thread_local bool cache_destroyed = false;
+
+// 线程退出时把缓存的块还给全局链表
+struct ChunkPool::ThreadCache {
+  std::vector<char*> chunks;
+
+  ThreadCache() { chunks.reserve(THREAD_CACHE_SIZE); }
+  ~ThreadCache() {
+    ChunkPool::get_instance()->flush_(chunks, 0);
+    cache_destroyed = true;
+  }
+};
+
+ChunkPool::ChunkPool()
+    : max_free_(1024),
+      in_use_(0),
+      high_water_(0),
+      allocated_(0),
+      acquire_count_(0),
+      release_count_(0) {}
+
+ChunkPool* ChunkPool::get_instance() {
+  // 不析构: 其他静态对象和线程缓存析构时仍可能归还块
+  static ChunkPool* pool = new ChunkPool();
+  return pool;
+}
+
+ChunkPool::ThreadCache* ChunkPool::get_cache_() {
+  if (cache_destroyed) {
+    return nullptr;
+  }
+  thread_local ThreadCache cache;
+  return &cache;
+}
+
+char* ChunkPool::acquire() {
+  ThreadCache* cache = get_cache_();
+  char* chunk = nullptr;
+  if (cache == nullptr) {
+    // 线程缓存已经析构,直接访问全局链表
+    std::lock_guard<std::mutex> locker(mtx_);
+    if (!free_.empty()) {
+      chunk = free_.back();
+      free_.pop_back();
+    }
+  } else {
+    if (cache->chunks.empty()) {
+      refill_(cache->chunks);
+    }
+    if (!cache->chunks.empty()) {
+      chunk = cache->chunks.back();
+      cache->chunks.pop_back();
+    }
+  }
+  if (chunk == nullptr) {
+    chunk = new char[CHUNK_SIZE];
+    allocated_++;
+  }
+
+  acquire_count_.fetch_add(1, std::memory_order_relaxed);
+  size_t in_use = in_use_.fetch_add(1, std::memory_order_relaxed) + 1;
+  size_t high_water = high_water_.load(std::memory_order_relaxed);
+  while (in_use > high_water &&
+         !high_water_.compare_exchange_weak(high_water, in_use,
+                                            std::memory_order_relaxed)) {
+  }
+  return chunk;
+}
+
+void ChunkPool::release(char* chunk) {
+  if (chunk == nullptr) {
+    return;
+  }
+  release_count_.fetch_add(1, std::memory_order_relaxed);
+  in_use_.fetch_sub(1, std::memory_order_relaxed);
+
+  ThreadCache* cache = get_cache_();
+  if (cache == nullptr) {
+    std::vector<char*> chunks(1, chunk);
+    flush_(chunks, 0);
+    return;
+  }
+  cache->chunks.push_back(chunk);
+  if (cache->chunks.size() >= THREAD_CACHE_SIZE) {
+    flush_(cache->chunks, THREAD_CACHE_SIZE / 2);
+  }
+}
+
+void ChunkPool::set_max_free(size_t max_free) {
+  std::lock_guard<std::mutex> locker(mtx_);
+  max_free_ = max_free;
+}
+
+ChunkPoolStats ChunkPool::get_stats() const {
+  ChunkPoolStats stats;
+  stats.in_use = in_use_.load(std::memory_order_relaxed);
+  stats.high_water = high_water_.load(std::memory_order_relaxed);
+  stats.allocated = allocated_.load(std::memory_order_relaxed);
+  stats.acquire_count = acquire_count_.load(std::memory_order_relaxed);
+  stats.release_count = release_count_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void ChunkPool::flush_(std::vector<char*>& cache, size_t keep) {
+  std::vector<char*> excess;
+  {
+    std::lock_guard<std::mutex> locker(mtx_);
+    while (cache.size() > keep) {
+      if (free_.size() < max_free_) {
+        free_.push_back(cache.back());
+      } else {
+        excess.push_back(cache.back());
+      }
+      cache.pop_back();
+    }
+  }
+  // 超出上限的块在锁外释放
+  for (char* chunk : excess) {
+    delete[] chunk;
+  }
+  allocated_.fetch_sub(excess.size(), std::memory_order_relaxed);
+}
+
+void ChunkPool::refill_(std::vector<char*>& cache) {
+  std::lock_guard<std::mutex> locker(mtx_);
+  size_t count = std::min(free_.size(), THREAD_CACHE_SIZE / 2);
+  cache.insert(cache.end(), free_.end() - count, free_.end());
+  free_.resize(free_.size() - count);
+}
+
+}  // namespace MiniServer
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+/*
+所有连接共用的固定大小内存块池
+  Buffer 和 ChainBuffer 只在有数据要收发时借用块,连接空闲时归还,
+  大量空闲长连接不再各自占着几个 KB 的缓冲区
+  每个线程缓存少量空闲块,取还都不加锁; 缓存满或空时才访问全局空闲链表
+  全局空闲块超过上限后直接释放给系统
+*/
+namespace MiniServer {
+
+struct ChunkPoolStats {
+  // 正在被借用的块数及其最大值
+  size_t in_use = 0;
+  size_t high_water = 0;
+  // 已向系统申请、尚未释放的块数(借出的 + 各级缓存中的)
+  size_t allocated = 0;
+  // 借用/归还次数
+  uint64_t acquire_count = 0;
+  uint64_t release_count = 0;
+};
+
+class ChunkPool {
+ public:
+  static const size_t CHUNK_SIZE = 4096;
+  // 每个线程最多缓存的空闲块数
+  static const size_t THREAD_CACHE_SIZE = 64;
+
+  static ChunkPool* get_instance();
+
+  // 借用一个 CHUNK_SIZE 字节的块
+  char* acquire();
+  void release(char* chunk);
+
+  // 全局空闲链表最多保留的块数
+  void set_max_free(size_t max_free);
+  ChunkPoolStats get_stats() const;
+
+ private:
+  ChunkPool();
+  ~ChunkPool() = default;
+
+  struct ThreadCache;
+  // 线程退出过程中缓存已经析构时返回 nullptr
+  static ThreadCache* get_cache_();
+  // 把线程缓存中的一半块还给全局链表 / 从全局链表取一批块
+  void flush_(std::vector<char*>& cache, size_t keep);
+  void refill_(std::vector<char*>& cache);
+
+  mutable std::mutex mtx_;
+  std::vector<char*> free_;
+  size_t max_free_;
+
+  std::atomic<size_t> in_use_;
+  std::atomic<size_t> high_water_;
+  std::atomic<size_t> allocated_;
+  std::atomic<uint64_t> acquire_count_;
+  std::atomic<uint64_t> release_count_;
+};
+
+}  // namespace MiniServer
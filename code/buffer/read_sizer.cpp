@@ -0,0 +1,45 @@
+#include "read_sizer.h"
+
+#include <sys/ioctl.h>
+
+#include <algorithm>
+
+namespace MiniServer {
+
+const size_t ReadSizer::MIN_SIZE;
+const size_t ReadSizer::MAX_SIZE;
+
+size_t ReadSizer::expected(int fd) const {
+  if (!last_read_full_) {
+    return read_size_;
+  }
+  // 上次读满了,内核中可能还有一个大的请求体,不再逐次翻倍
+  // 预留不超过 MAX_SIZE: 请求 pin 住缓冲区时,扩容前的存储要等请求处理完才释放
+  int pending = 0;
+  if (ioctl(fd, FIONREAD, &pending) == 0 && pending > 0) {
+    return std::min(static_cast<size_t>(pending), MAX_SIZE);
+  }
+  return read_size_;
+}
+
+void ReadSizer::record(ssize_t len, size_t reserved) {
+  if (len <= 0) {
+    // 读到结尾或暂时没有数据(EAGAIN),下次不必再查询 FIONREAD
+    last_read_full_ = false;
+    return;
+  }
+  last_read_full_ = static_cast<size_t>(len) == reserved;
+  if (last_read_full_) {
+    read_size_ = std::min(read_size_ * 2, MAX_SIZE);
+    small_reads_ = 0;
+  } else if (static_cast<size_t>(len) <= read_size_ / 2) {
+    if (++small_reads_ >= 2) {
+      read_size_ = std::max(read_size_ / 2, MIN_SIZE);
+      small_reads_ = 0;
+    }
+  } else {
+    small_reads_ = 0;
+  }
+}
+
+}  // namespace MiniServer
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "buffer/chunk_pool.h"
+
+/*
+Buffer 和 RingBuffer 的 read_fd 共用的读取大小估计
+  按最近几次读取的大小预留空间: 读满时翻倍,连续两次读不到一半时减半
+  上次读满了预留的空间时用 FIONREAD 查询内核中的数据量,大的请求体直接按上限预留
+不加锁,由持有缓冲区的线程访问
+*/
+namespace MiniServer {
+
+class ReadSizer {
+ public:
+  // 预留空间的范围
+  static const size_t MIN_SIZE = ChunkPool::CHUNK_SIZE;
+  static const size_t MAX_SIZE = 64 * 1024;
+
+  ReadSizer()
+      : read_size_(MIN_SIZE), small_reads_(0), last_read_full_(false) {}
+
+  // 下一次从 fd 读取前应预留的空间
+  size_t expected(int fd) const;
+  // 记录一次读取: len 为 read 的返回值, reserved 为读取时可写的空间
+  void record(ssize_t len, size_t reserved);
+  // 不查询 fd 时按历史预留的空间
+  size_t get_read_size() const { return read_size_; }
+
+ private:
+  size_t read_size_;
+  // 连续读不到一半的次数
+  int small_reads_;
+  bool last_read_full_;
+};
+
+}  // namespace MiniServer
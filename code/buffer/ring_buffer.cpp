@@ -0,0 +1,188 @@
+#include "ring_buffer.h"
+
+#include <errno.h>
+
+#include <algorithm>
+
+namespace MiniServer {
+
+static size_t round_up_pow2(size_t size) {
+  size_t cap = 2;
+  while (cap < size) {
+    cap <<= 1;
+  }
+  return cap;
+}
+
+RingBuffer::RingBuffer(size_t size)
+    : buffer_(round_up_pow2(size)),
+      mask_(buffer_.size() - 1),
+      read_pos_(0),
+      write_pos_(0) {}
+
+size_t RingBuffer::get_contiguous_readable_bytes() const {
+  return std::min(get_readable_bytes(),
+                  buffer_.size() - (read_pos_ & mask_));
+}
+
+size_t RingBuffer::get_contiguous_writable_bytes() const {
+  return std::min(get_writable_bytes(),
+                  buffer_.size() - (write_pos_ & mask_));
+}
+
+void RingBuffer::move_read_ptr(size_t len) {
+  if (len >= get_readable_bytes()) {
+    // 读完后回到开头,下次写入尽量不跨过末尾
+    clear();
+  } else {
+    read_pos_ += len;
+  }
+}
+
+void RingBuffer::make_space(size_t len) {
+  if (get_writable_bytes() < len) {
+    grow_(len);
+  }
+}
+
+void RingBuffer::move_write_ptr(size_t len) {
+  assert(get_writable_bytes() >= len);
+  write_pos_ += len;
+}
+
+void RingBuffer::clear() {
+  read_pos_ = 0;
+  write_pos_ = 0;
+}
+
+int RingBuffer::get_read_iov(struct iovec iov[2]) {
+  size_t readable = get_readable_bytes();
+  if (readable == 0) {
+    return 0;
+  }
+  size_t first = get_contiguous_readable_bytes();
+  iov[0].iov_base = get_read_ptr();
+  iov[0].iov_len = first;
+  if (first == readable) {
+    return 1;
+  }
+  // 第二段从数组开头开始
+  iov[1].iov_base = buffer_.data();
+  iov[1].iov_len = readable - first;
+  return 2;
+}
+
+int RingBuffer::get_write_iov(struct iovec iov[2]) {
+  size_t writable = get_writable_bytes();
+  if (writable == 0) {
+    return 0;
+  }
+  size_t first = get_contiguous_writable_bytes();
+  iov[0].iov_base = get_write_ptr();
+  iov[0].iov_len = first;
+  if (first == writable) {
+    return 1;
+  }
+  iov[1].iov_base = buffer_.data();
+  iov[1].iov_len = writable - first;
+  return 2;
+}
+
+std::string RingBuffer::read(size_t len) {
+  len = std::min(len, get_readable_bytes());
+  std::string str;
+  str.reserve(len);
+  size_t first = std::min(len, get_contiguous_readable_bytes());
+  str.append(get_read_ptr(), first);
+  str.append(buffer_.data(), len - first);
+  move_read_ptr(len);
+  return str;
+}
+
+std::string RingBuffer::read_all() { return read(get_readable_bytes()); }
+
+void RingBuffer::write_buffer(const std::string &str) {
+  write_buffer(str.data(), str.size());
+}
+
+// 将其他写函数转换至通用接口
+void RingBuffer::write_buffer(const char *str, size_t len) {
+  assert(str);
+  make_space(len);
+  size_t first = std::min(len, get_contiguous_writable_bytes());
+  std::copy(str, str + first, get_write_ptr());
+  std::copy(str + first, str + len, buffer_.data());
+  write_pos_ += len;
+}
+
+void RingBuffer::write_buffer(const void *data, size_t len) {
+  assert(data);
+  write_buffer(static_cast<const char *>(data), len);
+}
+
+void RingBuffer::write_buffer(Buffer &buff) {
+  write_buffer(buff.get_read_ptr(), buff.get_readable_bytes());
+}
+
+void RingBuffer::write_buffer(RingBuffer &buff) {
+  // 写入自己时中途扩容会让 iov 失效,先留好空间
+  make_space(buff.get_readable_bytes());
+  struct iovec iov[2];
+  int count = buff.get_read_iov(iov);
+  for (int i = 0; i < count; i++) {
+    write_buffer(static_cast<const char *>(iov[i].iov_base), iov[i].iov_len);
+  }
+}
+
+ssize_t RingBuffer::read_fd(int fd, int *errno_) {
+  // 与 Buffer 相同,按读取历史预留空间后直接读入(最多两段),不经过栈上的中转数组
+  make_space(read_sizer_.expected(fd));
+  struct iovec iov[2];
+  int count = get_write_iov(iov);
+  const size_t writable_bytes = get_writable_bytes();
+
+  const ssize_t len = readv(fd, iov, count);
+  read_sizer_.record(len, writable_bytes);
+  if (len <= 0) {
+    if (len < 0) {
+      *errno_ = errno;
+    }
+    return len;
+  }
+  write_pos_ += len;
+  return len;
+}
+
+ssize_t RingBuffer::write_fd(int fd, int *errno_) {
+  struct iovec iov[2];
+  int count = get_read_iov(iov);
+  if (count == 0) {
+    return 0;
+  }
+  ssize_t len = writev(fd, iov, count);
+  if (len < 0) {
+    *errno_ = errno;
+    return len;
+  }
+  move_read_ptr(len);
+  return len;
+}
+
+void RingBuffer::grow_(size_t len) {
+  size_t readable = get_readable_bytes();
+  std::vector<char> buffer(round_up_pow2(std::max(buffer_.size() * 2,
+                                                  readable + len)));
+  struct iovec iov[2];
+  int count = get_read_iov(iov);
+  char *dst = buffer.data();
+  for (int i = 0; i < count; i++) {
+    const char *src = static_cast<const char *>(iov[i].iov_base);
+    dst = std::copy(src, src + iov[i].iov_len, dst);
+  }
+  buffer_.swap(buffer);
+  mask_ = buffer_.size() - 1;
+  read_pos_ = 0;
+  write_pos_ = readable;
+}
+
+}  // namespace MiniServer
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <assert.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "buffer/buffer.h"
+#include "buffer/read_sizer.h"
+
+/*
+环形缓冲区,与 Buffer 的读写指针接口相同
+  容量为 2 的幂,读写位置只增不减,取模后得到下标,读写都不需要移动已有数据
+  空间不够时容量翻倍(只在增长时复制一次),不会像 Buffer::make_space 那样反复整理和按需扩容
+  可读/可写区域最多分成两段: get_read_ptr/get_write_ptr 只返回第一段,
+  get_read_iov/get_write_iov 返回两段,直接用于 writev/readv
+不加锁,与 Buffer 一样由持有连接的线程访问
+*/
+namespace MiniServer {
+
+class RingBuffer {
+ public:
+  explicit RingBuffer(size_t size = 1024);
+  ~RingBuffer() = default;
+
+  // 读取缓存(获取可读字节数,获取读指针，移动读指针)
+  size_t get_readable_bytes() const { return write_pos_ - read_pos_; }
+  // 读指针开始连续可读的字节数(第一段)
+  size_t get_contiguous_readable_bytes() const;
+  char* get_read_ptr() { return &buffer_[read_pos_ & mask_]; }
+  void move_read_ptr(size_t len);
+
+  // 写入缓存(确保有足够空间写入)
+  size_t get_writable_bytes() const {
+    return buffer_.size() - get_readable_bytes();
+  }
+  // 写指针开始连续可写的字节数(第一段)
+  size_t get_contiguous_writable_bytes() const;
+  void make_space(size_t len);
+  char* get_write_ptr() { return &buffer_[write_pos_ & mask_]; }
+  void move_write_ptr(size_t len);
+
+  size_t capacity() const { return buffer_.size(); }
+  void clear();
+
+  // 可读/可写区域对应的 iovec,返回使用的个数(0~2)
+  int get_read_iov(struct iovec iov[2]);
+  int get_write_iov(struct iovec iov[2]);
+
+  // 读取缓存 string
+  std::string read(size_t len);
+  std::string read_all();
+
+  // 写入缓存 (string char* Buffer)
+  void write_buffer(const std::string& str);
+  void write_buffer(const char* str, size_t len);
+  void write_buffer(const void* data, size_t len);
+  void write_buffer(Buffer& buff);
+  void write_buffer(RingBuffer& buff);
+
+  // 文件接口
+  // errno_后缀是为了和系统的errno变量区分
+  // read_fd 与 Buffer 相同,一次最多读满预留的空间,非阻塞的 fd 需要调用到 EAGAIN 为止
+  ssize_t read_fd(int fd, int* errno_);
+  // 下一次 read_fd 按历史预留的空间
+  size_t get_read_size() const { return read_sizer_.get_read_size(); }
+  ssize_t write_fd(int fd, int* errno_);
+
+ private:
+  // 容量扩大到能再写入 len 字节,数据按顺序复制到新数组的开头
+  void grow_(size_t len);
+
+  std::vector<char> buffer_;
+  size_t mask_;
+  // 累计读写的字节数,取模后才是下标
+  size_t read_pos_;
+  size_t write_pos_;
+  // 根据读取历史估计 read_fd 预留的空间
+  ReadSizer read_sizer_;
+};
+
+}  // namespace MiniServer
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+
+#include <string>
+
+/*
+不持有数据的字符串视图,指向 Buffer 等其他对象中的字节
+  C++17 及以上直接使用 std::string_view
+  C++14 下是只包含解析需要的接口的简化实现
+转为 std::string 时统一写 std::string(view.data(), view.size()),两种实现都适用
+*/
+#if __cplusplus >= 201703L
+#include <string_view>
+
+namespace MiniServer {
+using StringView = std::string_view;
+}  // namespace MiniServer
+
+#else
+
+namespace MiniServer {
+
+class StringView {
+ public:
+  static const size_t npos = static_cast<size_t>(-1);
+
+  StringView() : data_(nullptr), size_(0) {}
+  StringView(const char* data, size_t size) : data_(data), size_(size) {}
+  StringView(const char* str) : data_(str), size_(strlen(str)) {}
+  StringView(const std::string& str) : data_(str.data()), size_(str.size()) {}
+
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+  size_t length() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  const char* begin() const { return data_; }
+  const char* end() const { return data_ + size_; }
+  const char& operator[](size_t pos) const { return data_[pos]; }
+  const char& front() const { return data_[0]; }
+  const char& back() const { return data_[size_ - 1]; }
+
+  void remove_prefix(size_t n) {
+    data_ += n;
+    size_ -= n;
+  }
+  void remove_suffix(size_t n) { size_ -= n; }
+
+  StringView substr(size_t pos, size_t count = npos) const {
+    if (pos > size_) {
+      pos = size_;
+    }
+    if (count > size_ - pos) {
+      count = size_ - pos;
+    }
+    return StringView(data_ + pos, count);
+  }
+
+  size_t find(char c, size_t pos = 0) const {
+    if (pos >= size_) {
+      return npos;
+    }
+    const void* found = memchr(data_ + pos, c, size_ - pos);
+    return found == nullptr ? npos
+                            : static_cast<const char*>(found) - data_;
+  }
+
+  int compare(StringView other) const {
+    size_t len = size_ < other.size_ ? size_ : other.size_;
+    int result = len == 0 ? 0 : memcmp(data_, other.data_, len);
+    if (result != 0) {
+      return result;
+    }
+    return size_ == other.size_ ? 0 : (size_ < other.size_ ? -1 : 1);
+  }
+
+ private:
+  const char* data_;
+  size_t size_;
+};
+
+inline bool operator==(StringView lhs, StringView rhs) {
+  return lhs.size() == rhs.size() && lhs.compare(rhs) == 0;
+}
+inline bool operator!=(StringView lhs, StringView rhs) {
+  return !(lhs == rhs);
+}
+
+}  // namespace MiniServer
+
+#endif
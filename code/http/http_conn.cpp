@@ -1,5 +1,7 @@
 #include "http_conn.h"
 
+#include <chrono>
+
 const static char LOG_TAG[] = "HTTP_CONN";
 
 namespace MiniServer {
@@ -7,11 +9,25 @@ namespace MiniServer {
 bool HttpConn::is_ET_;
 string HttpConn::src_dir_;
 std::atomic<int> HttpConn::user_count_;
+int HttpConn::keep_alive_max_;
+std::atomic<uint64_t> HttpConn::reuse_count_;
+bool HttpConn::use_inbox_ = false;
 
 HttpConn::HttpConn() {
   sock_fd_ = -1;
   sock_addr_ = {0};
   is_closed_ = true;
+  generation_ = 0;
+  busy_ = false;
+  last_active_ms_ = 0;
+  idle_timeout_ms_ = 0;
+  request_count_ = 0;
+  keep_alive_ = false;
+  pending_mode_ = RM_NONBLOCKING;
+  async_ready_ = false;
+  async_ok_ = false;
+  waiting_input_ = false;
+  inbox_closed_ = false;
 }
 
 HttpConn::~HttpConn() { 
@@ -23,17 +39,47 @@ void HttpConn::init(int sock_fd, const sockaddr_in sock_addr) {
   sock_fd_ = sock_fd;
   sock_addr_ = sock_addr;
   is_closed_ = false;
-  
+  generation_++;
+  busy_ = false;
+  request_count_ = 0;
+  keep_alive_ = false;
+  pending_mode_ = RM_NONBLOCKING;
+  async_ready_ = false;
+  async_body_.clear();
+
+  // request 清理(先 unpin 读缓存)
+  request_.clear();
+
   // buffer 清理
   read_buffer_.clear();
   write_buffer_.clear();
-  // request 清理
-  
-  request_.clear();
+  {
+    // 新连接等待第一个请求
+    std::lock_guard<std::mutex> locker(inbox_mtx_);
+    inbox_.clear();
+    waiting_input_ = true;
+    inbox_closed_ = false;
+  }
   LOG_INFO("[%s] Client[%d](%s:%d) in, userCount:%d", LOG_TAG, sock_fd_,
            get_ip().data(), get_port(), (int)user_count_);
 }
 
+static inline int64_t steady_now_ms() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void HttpConn::refresh_active(int idle_timeout_ms) {
+  idle_timeout_ms_.store(idle_timeout_ms, std::memory_order_relaxed);
+  last_active_ms_.store(steady_now_ms(), std::memory_order_relaxed);
+}
+
+int64_t HttpConn::get_idle_remaining_ms() const {
+  return last_active_ms_.load(std::memory_order_relaxed) +
+         idle_timeout_ms_.load(std::memory_order_relaxed) - steady_now_ms();
+}
+
 void HttpConn::close_conn() {
   if (is_closed_ == false) {
     is_closed_ = true;
@@ -41,22 +87,61 @@ void HttpConn::close_conn() {
 
     // 关闭资源
     close(sock_fd_);
-    response_.unmap_file();
-
-    read_buffer_.clear();
-    write_buffer_.clear();
     LOG_INFO("[%s] Client[%d](%s:%d) quit, UserCount:%d", LOG_TAG, sock_fd_,
              get_ip().data(), get_port(), (int)user_count_);
   }
 }
 
-void HttpConn::global_config(bool is_ET, string &src_dir, int user_count) {
+void HttpConn::release_buffers() {
+  // 缓冲区的存储都还给块池,请求中的视图先失效
+  request_.clear();
+  read_buffer_.release();
+  write_buffer_.clear();
+  async_body_.release();
+  response_.release_buffer();
+  // 关闭后循环线程可能还拿着这个连接的 recv 结果,不再开始处理
+  std::lock_guard<std::mutex> locker(inbox_mtx_);
+  inbox_.release();
+  waiting_input_ = false;
+}
+
+void HttpConn::reset() {
+  // 读缓存和 request_ 不清理,其中可能已经有下一个请求(或其已解析的部分)
+  write_buffer_.clear();
+  // 连接进入空闲,没有待处理数据时把缓冲区的存储还给块池
+  if (read_buffer_.get_readable_bytes() == 0) {
+    read_buffer_.release();
+  }
+  response_.release_buffer();
+}
+
+void HttpConn::global_config(bool is_ET, string &src_dir, int user_count,
+                             int keep_alive_max, size_t body_size_max) {
   HttpConn::is_ET_ = is_ET;
   HttpConn::src_dir_ = src_dir;
   HttpConn::user_count_ = user_count;
+  HttpConn::keep_alive_max_ = keep_alive_max;
+  HttpRequest::set_body_size_max(body_size_max);
 }
 
 ssize_t HttpConn::read(int *errno_) {
+  if (use_inbox_) {
+    // 数据已经由 io_uring 收到,只需要取走
+    std::lock_guard<std::mutex> locker(inbox_mtx_);
+    ssize_t len = static_cast<ssize_t>(inbox_.get_readable_bytes());
+    if (len == 0) {
+      *errno_ = EAGAIN;
+      return -1;
+    }
+    if (read_buffer_.get_readable_bytes() == 0 && !read_buffer_.is_pinned()) {
+      read_buffer_.swap(inbox_);
+    } else {
+      read_buffer_.write_buffer(inbox_);
+    }
+    inbox_.clear();
+    return len;
+  }
+
   ssize_t len = -1;
 
   do {
@@ -67,83 +152,160 @@ ssize_t HttpConn::read(int *errno_) {
     if (len <= 0) {
       return len;
     }
-  } while (true);
+    // 已经超过一个请求的最大长度时先处理,剩下的数据在重新注册事件后再读
+  } while (read_buffer_.get_readable_bytes() <
+           HttpRequest::HEADER_SIZE_MAX + HttpRequest::get_body_size_max());
+  return len;
+}
+
+bool HttpConn::deliver(const char *data, int len) {
+  std::lock_guard<std::mutex> locker(inbox_mtx_);
+  if (len <= 0) {
+    inbox_closed_ = true;
+  } else if (!inbox_closed_) {
+    if (inbox_.get_readable_bytes() + len >
+        HttpRequest::HEADER_SIZE_MAX + HttpRequest::get_body_size_max()) {
+      // 处理期间客户端发来了超过一个请求最大长度的数据,不再接收
+      LOG_WARN("[%s] Client[%d] inbox overflow!", LOG_TAG, sock_fd_);
+      inbox_closed_ = true;
+    } else {
+      inbox_.write_buffer(data, len);
+    }
+  }
+  if (!waiting_input_) {
+    // 正在处理,处理完后 wait_input 会看到这些数据
+    return false;
+  }
+  waiting_input_ = false;
+  return true;
+}
+
+HttpConn::INPUT_STATE HttpConn::wait_input() {
+  std::lock_guard<std::mutex> locker(inbox_mtx_);
+  if (inbox_.get_readable_bytes() > 0) {
+    return IS_PENDING;
+  }
+  if (inbox_closed_) {
+    return IS_CLOSED;
+  }
+  // 与 deliver 在同一把锁内切换,不会漏掉数据: 之后收到的数据由循环线程开始处理
+  busy_.store(false, std::memory_order_release);
+  waiting_input_ = true;
+  return IS_WAITING;
 }
 
 ssize_t HttpConn::write(int *errno_) {
   ssize_t len = -1;
 
   do {
-    len = writev(sock_fd_, iov_, iov_count_);
+    // 连续的内存片段一次 writev,文件区间 sendfile,已发送的部分在其中跳过
+    len = write_buffer_.write_fd(sock_fd_, errno_);
     // 和 read 一样,不能指望在没东西可写的时候 len=0
     // 应该根据 get_writable_bytes() 判断是否成功
     if (len <= 0) {
-      *errno_ = errno;
       return len;
     }
+  } while (write_buffer_.get_readable_bytes() > 0);
 
-    if (static_cast<size_t>(len) > iov_[0].iov_len) {
-      // 响应头传输完成
-      // 调整一下响应体的未传输部分
-      iov_[1].iov_base = (uint8_t *)iov_[1].iov_base + (len - iov_[0].iov_len);
-      iov_[1].iov_len -= (len - iov_[0].iov_len);
-      // 下一次不再传输响应头
-      if (iov_[0].iov_len) {
-        write_buffer_.clear();
-        iov_[0].iov_len = 0;
-      }
-    } else {
-      // 响应头没传输完成 调整一下响应头
-      iov_[0].iov_base = (uint8_t *)iov_[0].iov_base + len;
-      iov_[0].iov_len -= len;
-      write_buffer_.move_read_ptr(len);
-    }
+  return len;
+}
 
-  } while (true);
+void HttpConn::set_async_result(bool ok, Buffer &body) {
+  async_body_.clear();
+  async_body_.swap(body);
+  async_ok_ = ok;
+  async_ready_ = true;
 }
 
-bool HttpConn::process() {
+bool HttpConn::process(bool allow_blocking) {
   //修复bug 貌似一个conn会被多次调用parse读取buffer内容，使用conn内部锁加锁
   // std::lock_guard<std::mutex> time_lock(mtx_);
-  request_.init();
-  if (read_buffer_.get_readable_bytes() <= 0) {
-    return false;
+  if (pending_mode_ == RM_NONBLOCKING) {
+    request_.init();
   }
 
-  auto result = request_.parse(read_buffer_);
-  if (result == HttpRequest::PARSE_RESULT::PR_SUCCESS) {
-    response_.init(src_dir_, request_.get_path(), request_.get_is_keep_alive(),
-                   200);
-  } else if (result == HttpRequest::PARSE_RESULT::PR_INCOMPLETE) {
-    // 报文体未接收完毕
-    LOG_DEBUG("[%s] Try to continue to receive.", LOG_TAG)
-    return false;
-  } else {
-    // 返回失败报文
-    // 其实已经没有别的result了
-    assert(result == HttpRequest::PARSE_RESULT::PR_ERROR);
-    response_.init(src_dir_, request_.get_path(), false, 500);
-  }
-  // 响应报文
+  // 多个响应依次追加到链式缓冲区,已有片段不会移动
+  int part_count = 0;
+
   write_buffer_.clear();
-  response_.make_response(this->request_, write_buffer_);
-  iov_[0].iov_base = const_cast<char *>(write_buffer_.get_read_ptr());
-  iov_[0].iov_len = write_buffer_.get_readable_bytes();
-  iov_count_ = 1;
-
-  if (response_.get_file_size() > 0) {
-    iov_[1].iov_base = response_.get_file();
-    iov_[1].iov_len = response_.get_file_size();
-    iov_count_ = 2;
-  } else {
-    iov_[1].iov_base = nullptr;
-    iov_[1].iov_len = 0;
-    iov_count_ = 1;
+  // 依次处理读缓存中所有已经完整到达的请求(HTTP/1.1 pipelining)
+  while (part_count < MAX_PIPELINE) {
+    HttpRequest::PARSE_RESULT result;
+    // 继续处理之前停下的协程路由请求
+    bool resume_async = false;
+    if (pending_mode_ != RM_NONBLOCKING) {
+      // 阻塞路由只在阻塞线程池中继续,协程路由要等结果
+      if ((pending_mode_ == RM_BLOCKING && !allow_blocking) ||
+          (pending_mode_ == RM_COROUTINE && !async_ready_)) {
+        break;
+      }
+      resume_async = pending_mode_ == RM_COROUTINE;
+      pending_mode_ = RM_NONBLOCKING;
+      result = HttpRequest::PARSE_RESULT::PR_SUCCESS;
+    } else {
+      if (read_buffer_.get_readable_bytes() == 0) {
+        break;
+      }
+      result = request_.parse(read_buffer_);
+      if (result == HttpRequest::PARSE_RESULT::PR_INCOMPLETE) {
+        // 报文未接收完毕
+        LOG_DEBUG("[%s] Try to continue to receive.", LOG_TAG)
+        break;
+      }
+      if (result == HttpRequest::PARSE_RESULT::PR_SUCCESS) {
+        ROUTER_MODE mode = HttpResponse::get_router_mode(request_.get_path());
+        if ((mode == RM_BLOCKING && !allow_blocking) || mode == RM_COROUTINE) {
+          // 前面的响应先发送,这个请求留给阻塞线程池或协程(还未计数,长连接状态不变)
+          pending_mode_ = mode;
+          break;
+        }
+      }
+    }
+
+    if (request_count_ > 0) {
+      reuse_count_++;
+    }
+    request_count_++;
+
+    if (result == HttpRequest::PARSE_RESULT::PR_SUCCESS) {
+      // 达到单连接最大请求数后,这次回复完成就关闭连接
+      keep_alive_ = request_.get_is_keep_alive() &&
+                    request_count_ < keep_alive_max_;
+      response_.init(src_dir_, request_.get_path(), keep_alive_, 200);
+      if (resume_async) {
+        async_ready_ = false;
+        response_.set_dynamic_result(async_ok_, async_body_);
+        async_body_.release();
+      }
+    } else {
+      // 返回失败报文
+      // 其实已经没有别的result了
+      assert(result == HttpRequest::PARSE_RESULT::PR_ERROR);
+      keep_alive_ = false;
+      response_.init(src_dir_, request_.get_path(), false,
+                     request_.get_error_code());
+    }
+
+    // 响应报文
+    response_.make_response(this->request_, write_buffer_);
+    part_count++;
+
+    // 准备解析下一个请求
+    request_.clear();
+    if (!keep_alive_) {
+      // 这个响应之后连接就会关闭,后面的请求不再处理
+      break;
+    }
+  }
+
+  if (part_count == 0) {
+    return false;
   }
 
-  LOG_DEBUG("[%s] filesize:%d, response size:%d", LOG_TAG,
-            response_.get_file_size(), get_writable_bytes());
+  LOG_DEBUG("[%s] responses:%d, slices:%d, response size:%d", LOG_TAG,
+            part_count, (int)write_buffer_.get_slice_count(),
+            (int)write_buffer_.get_readable_bytes());
   return true;
 }
 
-}  // namespace MiniServer
\ No newline at end of file
+}  // namespace MiniServer
@@ -4,9 +4,13 @@
 #include <unistd.h>
 
 #include <atomic>
+#include <mutex>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "buffer/buffer.h"
+#include "buffer/chain_buffer.h"
 #include "http_request.h"
 #include "http_response.h"
 #include "log/log.h"
@@ -22,29 +26,77 @@ class HttpConn {
 
   // 控制函数
   void init(int sock_fd, const sockaddr_in sock_addr);
+  // 只关闭 socket,不动缓冲区: 关闭时其他线程可能还在读这个连接的状态
   void close_conn();
+  // 关闭后把缓冲区的存储还给块池,只能在没有任务处理这个连接时调用
+  void release_buffers();
+  // 长连接回复完成后,清理本次请求/响应的状态,等待同一连接上的下一个请求
+  void reset();
 
   // 通用静态设置
-  static void global_config(bool is_ET, string &src_dir, int user_count);
+  static void global_config(bool is_ET, string &src_dir, int user_count,
+                            int keep_alive_max, size_t body_size_max);
+  // io_uring 完成模式: 数据由循环线程 deliver 到连接中, read 不再读 socket
+  static void set_recv_inbox(bool use_inbox) { use_inbox_ = use_inbox; }
 
   // 功能函数
   ssize_t read(int *errno_);
   ssize_t write(int *errno_);
-  bool process();
+  // allow_blocking 为 false 时遇到阻塞路由的请求会停下,留给阻塞线程池继续处理
+  // 遇到协程路由的请求总是停下,设置协程的结果后再继续
+  bool process(bool allow_blocking = false);
 
   int get_fd() const { return sock_fd_; }
+  // 每次 init 加一,fd 被复用后可以区分新旧连接
+  uint32_t get_generation() const { return generation_; }
   sockaddr_in get_addr() const { return sock_addr_; }
   int get_port() const { return sock_addr_.sin_port; }
   string get_ip() const { return string(inet_ntoa(sock_addr_.sin_addr)); };
   static int get_user_count() { return user_count_; }
+  // 在复用的长连接上处理的请求数
+  static uint64_t get_reuse_count() { return reuse_count_; }
 
   size_t get_writable_bytes() const {
-    return iov_[0].iov_len + iov_[1].iov_len;
+    return write_buffer_.get_readable_bytes();
   };
 
-  bool is_keep_alive() const { return request_.get_is_keep_alive(); };
+  // 当前回复完成后是否保持连接(请求要求且未超过单连接最大请求数)
+  bool is_keep_alive() const { return keep_alive_; };
+  // 读缓存中是否还有未处理的数据(客户端提前发来的下一个请求)
+  bool has_pending_data() const {
+    return read_buffer_.get_readable_bytes() > 0;
+  }
 
   bool is_closed() const { return is_closed_; }
+  // 连接已交给线程池(或阻塞线程池)处理,重新注册事件前其他线程不能关闭它
+  bool is_busy() const { return busy_.load(std::memory_order_acquire); }
+  void set_busy(bool busy) { busy_.store(busy, std::memory_order_release); }
+  // 已解析出一个阻塞路由的请求,等待在阻塞线程池中 process(true)
+  bool has_blocking_request() const { return pending_mode_ == RM_BLOCKING; }
+  // 已解析出一个协程路由的请求,等待 set_async_result 后再 process
+  bool has_coroutine_request() const {
+    return pending_mode_ == RM_COROUTINE && !async_ready_;
+  }
+  // 停下的请求,协程路由需要复制一份
+  const HttpRequest &get_request() const { return request_; }
+  // 协程路由的结果,下次 process 时用它生成响应; body 的内容被转交
+  void set_async_result(bool ok, Buffer &body);
+
+  // 完成模式下循环线程交付 recv 的结果, len <= 0 表示对端关闭或出错
+  // 返回 true 表示连接正在等待数据,调用者开始处理(之后连接属于处理它的线程)
+  bool deliver(const char *data, int len);
+  // 完成模式下处理完毕,等待新的数据
+  enum INPUT_STATE {
+    IS_WAITING,  // 没有未处理的数据,连接交还给循环(同时取消 busy 标记)
+    IS_PENDING,  // 处理期间又收到了数据,继续 read 和处理
+    IS_CLOSED,   // 对端已关闭或出错,需要关闭连接
+  };
+  INPUT_STATE wait_input();
+
+  // 记录一次读写活动和之后允许的空闲时间,只写原子变量,任意线程调用
+  void refresh_active(int idle_timeout_ms);
+  // 距离空闲超时的剩余毫秒数, <= 0 表示已经超时
+  int64_t get_idle_remaining_ms() const;
 
   std::mutex mtx_;
 
@@ -52,18 +104,40 @@ class HttpConn {
   static bool is_ET_;
   static string src_dir_;
   static std::atomic<int> user_count_;
+  static int keep_alive_max_;
+  static std::atomic<uint64_t> reuse_count_;
+  static bool use_inbox_;
 
   int sock_fd_;
   struct sockaddr_in sock_addr_;
   bool is_closed_;
-
-  // iov[0] 响应头 buffer
-  // iov[1] 响应体 文件
-  int iov_count_;
-  struct iovec iov_[2];
+  std::atomic<uint32_t> generation_;
+  std::atomic<bool> busy_;
+  // 最近一次活动的时间(steady_clock 毫秒)和允许的空闲时间
+  std::atomic<int64_t> last_active_ms_;
+  std::atomic<int> idle_timeout_ms_;
+
+  // 该连接上已经开始处理的请求数
+  int request_count_;
+  bool keep_alive_;
+  // request_ 中已解析完、尚未生成响应的请求的路由方式, RM_NONBLOCKING 表示没有
+  ROUTER_MODE pending_mode_;
+  // 协程路由的结果
+  bool async_ready_;
+  bool async_ok_;
+  Buffer async_body_;
+
+  // 一次 process 最多连续处理的流水线请求数
+  static const int MAX_PIPELINE = 16;
 
   Buffer read_buffer_;
-  Buffer write_buffer_;
+  // 完成模式下已收到、还没有被 read 取走的数据,循环线程和处理线程都会访问
+  std::mutex inbox_mtx_;
+  Buffer inbox_;
+  bool waiting_input_;
+  bool inbox_closed_;
+  // 待发送的数据,按请求顺序依次为每个响应的响应头和响应体
+  ChainBuffer write_buffer_;
 
   HttpRequest request_;
   HttpResponse response_;
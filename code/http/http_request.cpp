@@ -1,30 +1,87 @@
 #include "http_request.h"
 
+#include <ctype.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "http/http_scanner.h"
+
 const static char LOG_TAG[] = "HTTP_REQUEST";
 
 namespace MiniServer {
-void HttpRequest::init() {
-  // 如果是解析到请求体部分，就继续解析，不清空
-  if (state_ != PARSE_STATE::PS_BODY) {
-    state_ = PARSE_STATE::PS_REQUEST_LINES;
-    method_ = "";
-    path_ = "";
-    version_ = "";
-    body_ = "";
+// view 在 [old_base, old_base+len) 中的位置平移到 new_base
+static StringView rebase(StringView view, const char *old_base,
+                         const char *new_base) {
+  if (view.empty()) {
+    return StringView();
+  }
+  return StringView(new_base + (view.data() - old_base), view.size());
+}
+
+size_t HttpRequest::body_size_max_ = 1024 * 1024;
+
+HttpRequest::HttpRequest(const HttpRequest &other)
+    : state_(PS_REQUEST_LINES), pinned_buffer_(nullptr), scanned_(0) {
+  *this = other;
+}
+
+HttpRequest &HttpRequest::operator=(const HttpRequest &other) {
+  if (this == &other) {
+    return *this;
+  }
+  clear();
+  state_ = other.state_;
+  // 请求头的偏移相对于 head_,直接复制
+  headers_ = other.headers_;
+  std::copy(other.header_slots_, other.header_slots_ + HK_COUNT,
+            header_slots_);
+  content_length_ = other.content_length_;
+  post_ = other.post_;
+  error_code_ = other.error_code_;
+  // 请求头和请求体可能在不同的存储中,分别复制后平移视图
+  owned_.reserve(other.head_.size() + other.body_.size());
+  owned_.append(other.head_.data(), other.head_.size());
+  owned_.append(other.body_.data(), other.body_.size());
+  const char *head = owned_.data();
+  head_ = StringView(head, other.head_.size());
+  method_ = rebase(other.method_, other.head_.data(), head);
+  path_ = rebase(other.path_, other.head_.data(), head);
+  version_ = rebase(other.version_, other.head_.data(), head);
+  if (!other.body_.empty()) {
+    body_ = StringView(head + other.head_.size(), other.body_.size());
+  }
+  return *this;
+}
 
-    header_.clear();
-    post_ = Json();
+void HttpRequest::init() {
+  // 如果是解析到请求体部分或请求头还没接收完，就继续解析，不清空
+  if (state_ != PARSE_STATE::PS_BODY && scanned_ == 0) {
+    clear();
   }
 }
 void HttpRequest::clear() {
   state_ = PARSE_STATE::PS_REQUEST_LINES;
-  method_ = "";
-  path_ = "";
-  version_ = "";
-  body_ = "";
+  head_ = StringView();
+  method_ = StringView();
+  path_ = StringView();
+  version_ = StringView();
+  body_ = StringView();
+  owned_.clear();
+  unpin_();
 
-  header_.clear();
+  headers_.clear();
+  std::fill(header_slots_, header_slots_ + HK_COUNT, -1);
+  content_length_ = 0;
   post_ = Json();
+  scanned_ = 0;
+  error_code_ = 500;
+}
+void HttpRequest::unpin_() {
+  if (pinned_buffer_ != nullptr) {
+    pinned_buffer_->unpin();
+    pinned_buffer_ = nullptr;
+  }
 }
 HttpRequest::PARSE_RESULT HttpRequest::parse(Buffer &buffer) {
   const char CRLF[] = "\r\n";
@@ -32,97 +89,177 @@ HttpRequest::PARSE_RESULT HttpRequest::parse(Buffer &buffer) {
     return PARSE_RESULT::PR_ERROR;
   }
 
-  string line;
-  const char *begin_ptr = buffer.get_read_ptr();
-  const char *end_ptr = buffer.get_write_ptr();
+  if (state_ == PARSE_STATE::PS_REQUEST_LINES) {
+    // 忽略请求之间多余的空行(RFC 7230 3.5)
+    while (buffer.get_readable_bytes() >= 2 &&
+           std::equal(CRLF, CRLF + 2, buffer.get_read_ptr())) {
+      buffer.consume(2);
+      scanned_ = scanned_ > 2 ? scanned_ - 2 : 0;
+    }
+    // 请求行和请求头完整到达后才开始解析,否则等待后续数据
+    // 这样读缓存中只会消耗完整的请求,后面的请求(pipelining)原样保留
+    // 结尾的 CRLFCRLF 可能跨过上次查找的末尾,往前退 3 个字节
+    StringView data = buffer.peek_view();
+    const char *head_end = HttpScanner::find_header_end(
+        data.begin() + (scanned_ > 3 ? scanned_ - 3 : 0), data.end());
+    size_t head_size =
+        head_end == nullptr ? data.size() : head_end + 4 - data.begin();
+    if (head_size > HEADER_SIZE_MAX) {
+      LOG_ERROR("[%s] Request header too large: %d", LOG_TAG, (int)head_size);
+      state_ = PARSE_STATE::PS_ERROR;
+      error_code_ = 431;
+      return PARSE_RESULT::PR_ERROR;
+    }
+    if (head_end == nullptr) {
+      scanned_ = data.size();
+      return PARSE_RESULT::PR_INCOMPLETE;
+    }
+    scanned_ = 0;
+    // 从这里开始视图指向读缓存,请求处理完成(clear)前不能移动
+    if (pinned_buffer_ == nullptr) {
+      buffer.pin();
+      pinned_buffer_ = &buffer;
+    }
+    head_ = StringView(data.data(), head_end + 4 - data.data());
+  }
 
-  while (end_ptr >= begin_ptr) {
-    // 请求行 和 请求头
-    const char *line_end = nullptr;
+  while (state_ != PARSE_STATE::PS_FINISH &&
+         state_ != PARSE_STATE::PS_ERROR) {
+    StringView line;
+    // 本次解析从缓存中消耗的字节数
+    size_t consumed = 0;
     if (state_ != PARSE_STATE::PS_BODY) {
-      line_end = std::search(begin_ptr, end_ptr, CRLF, CRLF + 2);
-      line = string(begin_ptr, line_end);
+      // 请求行 和 请求头: 从当前位置到请求头结束,扫描时找到行尾
+      line = StringView(buffer.get_read_ptr(),
+                        head_.end() - buffer.get_read_ptr());
     } else {
-      // 解析请求体
-      line_end = end_ptr;
-      line = string(begin_ptr, line_end);
-      {
-        int content_length = -1;
-        if (header_.count("Content-Length") != 0) {
-          content_length = std::stoi(header_["Content-Length"]) + 2;
-        } else if (header_.count("content-length") != 0) {
-          content_length = std::stoi(header_["content-length"]) + 2;
-        } else {
-          // post请求必须包含Content-Length
-          LOG_ERROR("[%s] Missing key: Content-Length", LOG_TAG);
-          state_ = PARSE_STATE::PS_ERROR;
-          return PARSE_RESULT::PR_ERROR;
-        }
-
-        LOG_DEBUG("[%s] Content Length:%d/%d", LOG_TAG, line.size(),
-                  content_length);
-        if (content_length > line.size()) {
-          LOG_DEBUG("[%s] Incomplete post data.", LOG_TAG);
-          return PARSE_RESULT::PR_INCOMPLETE;
-        } else if (content_length < line.size()) {
-          LOG_ERROR("[%s] Error while parsing, recevied unexpected data",
-                    LOG_TAG);
-          state_ = PARSE_STATE::PS_ERROR;
-          return PARSE_RESULT::PR_ERROR;
-        }
+      // 解析请求体,只取 Content-Length 长度,后面可能紧跟着下一个请求
+      const size_t content_length = content_length_;
+      LOG_DEBUG("[%s] Content Length:%d/%d", LOG_TAG,
+                buffer.get_readable_bytes(), content_length);
+      if (content_length > buffer.get_readable_bytes()) {
+        LOG_DEBUG("[%s] Incomplete body.", LOG_TAG);
+        return PARSE_RESULT::PR_INCOMPLETE;
       }
+      line = buffer.peek_view(content_length);
+      consumed = content_length;
     }
+
     switch (state_) {
       case PARSE_STATE::PS_REQUEST_LINES:
-        state_ = parse_request_line(line);
+        state_ = parse_request_line(line, &consumed);
         break;
-      
+
       case PARSE_STATE::PS_HEADERS:
-        state_ = parse_header(line);
+        state_ = parse_header(line, &consumed);
         break;
 
       case PARSE_STATE::PS_BODY:
         state_ = parse_body(line);
         break;
 
-      case PARSE_STATE::PS_FINISH:
-        return PARSE_RESULT::PR_SUCCESS;
-
-      case PARSE_STATE::PS_ERROR:
-        return PARSE_RESULT::PR_ERROR;
-
       default:
         break;
     }
 
-    if (state_ != PARSE_STATE::PS_BODY) {
-      buffer.move_read_ptr(line_end - begin_ptr + 2);
-      begin_ptr = line_end + 2;
-    }
+    buffer.consume(consumed);
   }
 
+  if (state_ == PARSE_STATE::PS_ERROR) {
+    return PARSE_RESULT::PR_ERROR;
+  }
   return PARSE_RESULT::PR_SUCCESS;
 }
-bool HttpRequest::get_is_keep_alive() const {
-  //?
-  if (header_.count("Connection") == 1) {
-    return header_.find("Connection")->second == "keep-alive";
+// ASCII 字母不区分大小写比较
+static bool equals_ignore_case(StringView lhs, StringView rhs) {
+  if (lhs.size() != rhs.size()) {
+    return false;
   }
-  return false;
+  for (size_t i = 0; i < lhs.size(); i++) {
+    if (tolower(static_cast<unsigned char>(lhs[i])) !=
+        tolower(static_cast<unsigned char>(rhs[i]))) {
+      return false;
+    }
+  }
+  return true;
 }
-const string HttpRequest::query_header(const string &key) const {
-  assert(key != "");
-  if (header_.count(key) == 1) {
-    return header_.find(key)->second;
+
+// 按 HEADER_KEY 的顺序
+#define HEADER_NAME(name) \
+  { name, sizeof(name) - 1 }
+static const struct {
+  const char *name;
+  size_t length;
+} HEADER_NAMES[HttpRequest::HK_COUNT] = {
+    HEADER_NAME("Host"),
+    HEADER_NAME("Connection"),
+    HEADER_NAME("Content-Length"),
+    HEADER_NAME("Content-Type"),
+    HEADER_NAME("Transfer-Encoding"),
+    HEADER_NAME("Accept"),
+    HEADER_NAME("Accept-Encoding"),
+    HEADER_NAME("Accept-Language"),
+    HEADER_NAME("User-Agent"),
+    HEADER_NAME("Cookie"),
+    HEADER_NAME("Referer"),
+    HEADER_NAME("Range"),
+    HEADER_NAME("If-Modified-Since"),
+    HEADER_NAME("If-None-Match"),
+    HEADER_NAME("X-Forwarded-For"),
+};
+#undef HEADER_NAME
+
+HttpRequest::HEADER_KEY HttpRequest::intern_header(StringView name) {
+  // 先比较长度,长度相同的常用请求头很少
+  for (int key = 0; key < HK_COUNT; key++) {
+    if (HEADER_NAMES[key].length == name.size() &&
+        equals_ignore_case(name, StringView(HEADER_NAMES[key].name,
+                                            HEADER_NAMES[key].length))) {
+      return static_cast<HEADER_KEY>(key);
+    }
   }
-  return "";
+  return HK_UNKNOWN;
 }
-const string HttpRequest::query_header(const char *key) const {
-  assert(key != nullptr);
-  if (header_.count(key) == 1) {
-    return header_.find(key)->second;
+
+bool HttpRequest::get_is_keep_alive() const {
+  StringView connection = query_header(HK_CONNECTION);
+  // 值的大小写不固定(keep-alive/Keep-Alive/close/Close)
+  if (equals_ignore_case(connection, "keep-alive")) {
+    return true;
   }
-  return "";
+  if (equals_ignore_case(connection, "close")) {
+    return false;
+  }
+  // HTTP/1.1 默认长连接, HTTP/1.0 需要显式声明
+  return version_ == "1.1";
+}
+StringView HttpRequest::query_header(HEADER_KEY key) const {
+  assert(key > HK_UNKNOWN && key < HK_COUNT);
+  int index = header_slots_[key];
+  return index < 0 ? StringView() : get_header_value(index);
+}
+StringView HttpRequest::query_header(StringView name) const {
+  assert(!name.empty());
+  HEADER_KEY key = intern_header(name);
+  if (key != HK_UNKNOWN) {
+    return query_header(key);
+  }
+  for (size_t i = headers_.size(); i > 0; i--) {
+    if (equals_ignore_case(get_header_name(i - 1), name)) {
+      return get_header_value(i - 1);
+    }
+  }
+  return StringView();
+}
+StringView HttpRequest::get_header_name(size_t index) const {
+  assert(index < headers_.size());
+  const HeaderField &field = headers_[index];
+  return StringView(head_.data() + field.name_offset, field.name_length);
+}
+StringView HttpRequest::get_header_value(size_t index) const {
+  assert(index < headers_.size());
+  const HeaderField &field = headers_[index];
+  return StringView(head_.data() + field.value_offset, field.value_length);
 }
 const Json HttpRequest::query_post(const string &key) const {
   assert(key != "");
@@ -132,44 +269,159 @@ const Json HttpRequest::query_post(const char *key) const {
   assert(key != nullptr);
   return post_[string(key)];
 }
-HttpRequest::PARSE_STATE HttpRequest::parse_request_line(const string &line) {
-  std::regex pattern("^([^ ]*) ([^ ]*) HTTP/([^ ]*)$");
-  std::smatch sub_match;
+// p 处是否为行尾的 CRLF
+static inline bool is_line_end(const char *p, const char *end) {
+  return end - p >= 2 && p[0] == '\r' && p[1] == '\n';
+}
+
+static inline bool is_space_char(char c) { return c == ' ' || c == '\t'; }
 
-  bool result = std::regex_match(line, sub_match, pattern);
-  if (result) {
-    method_ = sub_match[1];
-    path_ = sub_match[2];
-    version_ = sub_match[3];
-    return PARSE_STATE::PS_HEADERS;
+HttpRequest::PARSE_STATE HttpRequest::parse_request_line(StringView data,
+                                                         size_t *consumed) {
+  // 请求行: 方法 SP 请求目标 SP HTTP/版本 CRLF
+  static const char PROTOCOL[] = "HTTP/";
+  const size_t PROTOCOL_LEN = sizeof(PROTOCOL) - 1;
+  const char *p = data.begin();
+  const char *end = data.end();
+
+  const char *method_end = HttpScanner::scan_token(p, end);
+  if (method_end == p || method_end == end || *method_end != ' ') {
+    LOG_ERROR("[%s] Parse request line error!", LOG_TAG);
+    return PARSE_STATE::PS_ERROR;
+  }
+  method_ = StringView(p, method_end - p);
+
+  p = method_end + 1;
+  const char *target_end = HttpScanner::scan_target(p, end);
+  if (target_end == p || target_end == end || *target_end != ' ') {
+    LOG_ERROR("[%s] Parse request line error!", LOG_TAG);
+    return PARSE_STATE::PS_ERROR;
+  }
+  path_ = StringView(p, target_end - p);
+
+  p = target_end + 1;
+  if (static_cast<size_t>(end - p) < PROTOCOL_LEN ||
+      memcmp(p, PROTOCOL, PROTOCOL_LEN) != 0) {
+    LOG_ERROR("[%s] Parse request line error!", LOG_TAG);
+    return PARSE_STATE::PS_ERROR;
   }
-  LOG_ERROR("[%s] Parse request line error!", LOG_TAG);
-  return PARSE_STATE::PS_ERROR;
+  p += PROTOCOL_LEN;
+  const char *version_end = HttpScanner::scan_target(p, end);
+  if (version_end == p || !is_line_end(version_end, end)) {
+    LOG_ERROR("[%s] Parse request line error!", LOG_TAG);
+    return PARSE_STATE::PS_ERROR;
+  }
+  version_ = StringView(p, version_end - p);
+
+  *consumed = version_end + 2 - data.begin();
+  return PARSE_STATE::PS_HEADERS;
 }
-HttpRequest::PARSE_STATE HttpRequest::parse_header(const string &line) {
-  if (line.size() == 0) {
-    if (method_ == "post" || method_ == "POST") {
-      return PARSE_STATE::PS_BODY;
+HttpRequest::PARSE_STATE HttpRequest::parse_header(StringView data,
+                                                   size_t *consumed) {
+  const char *p = data.begin();
+  const char *end = data.end();
+  if (is_line_end(p, end)) {
+    *consumed = 2;
+    return frame_body_();
+  }
+
+  // 名称: 非空的 token,紧跟冒号(冒号前不允许空白)
+  const char *name_end = HttpScanner::scan_token(p, end);
+  if (name_end == p || name_end == end || *name_end != ':') {
+    LOG_ERROR("[%s] Parse header error!", LOG_TAG);
+    return PARSE_STATE::PS_ERROR;
+  }
+  StringView name(p, name_end - p);
+
+  // 值: 扫描到第一个控制字符,只能是行尾的 CR; 去掉首尾的空白
+  p = name_end + 1;
+  while (p != end && is_space_char(*p)) {
+    p++;
+  }
+  const char *line_end = HttpScanner::scan_value(p, end);
+  if (!is_line_end(line_end, end)) {
+    LOG_ERROR("[%s] Parse header error!", LOG_TAG);
+    return PARSE_STATE::PS_ERROR;
+  }
+  const char *value_end = line_end;
+  while (value_end != p && is_space_char(value_end[-1])) {
+    value_end--;
+  }
+
+  PARSE_STATE state = add_header_(name, StringView(p, value_end - p));
+  *consumed = line_end + 2 - data.begin();
+  return state;
+}
+HttpRequest::PARSE_STATE HttpRequest::frame_body_() {
+  // 请求体的长度只由请求头决定,与方法无关(RFC 7230 3.3.3)
+  // 否则带请求体的 GET 等请求会把请求体留在读缓存中,被当作下一个请求解析
+  if (header_slots_[HK_TRANSFER_ENCODING] >= 0) {
+    // 不支持分块传输; 同时带有 Content-Length 时两边对长度的理解可能不同,
+    // 可能被用来走私请求,都按错误处理并关闭连接
+    if (header_slots_[HK_CONTENT_LENGTH] >= 0) {
+      LOG_ERROR("[%s] Both Transfer-Encoding and Content-Length present",
+                LOG_TAG);
     } else {
-      return PARSE_STATE::PS_FINISH;
+      LOG_ERROR("[%s] Unsupported Transfer-Encoding", LOG_TAG);
     }
+    return PARSE_STATE::PS_ERROR;
   }
-  std::regex pattern_header("^([^:]*): ?(.*)$");
-  std::smatch match_header;
-  
-  if (std::regex_match(line, match_header, pattern_header)) {
-    header_[match_header[1]] = match_header[2];
-    return PARSE_STATE::PS_HEADERS;
+  if (header_slots_[HK_CONTENT_LENGTH] < 0) {
+    if (method_ == "post" || method_ == "POST") {
+      // post请求必须包含Content-Length
+      LOG_ERROR("[%s] Missing key: Content-Length", LOG_TAG);
+      return PARSE_STATE::PS_ERROR;
+    }
+    // 没有请求体
+    return PARSE_STATE::PS_FINISH;
+  }
+  if (content_length_ > body_size_max_) {
+    LOG_ERROR("[%s] Request body too large: %llu", LOG_TAG,
+              (unsigned long long)content_length_);
+    error_code_ = 413;
+    return PARSE_STATE::PS_ERROR;
+  }
+  return content_length_ > 0 ? PARSE_STATE::PS_BODY : PARSE_STATE::PS_FINISH;
+}
+HttpRequest::PARSE_STATE HttpRequest::add_header_(StringView name,
+                                                  StringView value) {
+  HEADER_KEY key = intern_header(name);
+  if (key == HK_CONTENT_LENGTH) {
+    // 只接受十进制数字; 出现多次时必须相同(RFC 7230 3.3.2),否则可能被用来走私请求
+    size_t length = 0;
+    const size_t MAX_LENGTH = static_cast<size_t>(-1) / 10 - 10;
+    for (char c : value) {
+      if (c < '0' || c > '9' || length > MAX_LENGTH) {
+        LOG_ERROR("[%s] Invalid Content-Length", LOG_TAG);
+        return PARSE_STATE::PS_ERROR;
+      }
+      length = length * 10 + (c - '0');
+    }
+    if (value.empty() || (header_slots_[HK_CONTENT_LENGTH] >= 0 &&
+                          length != content_length_)) {
+      LOG_ERROR("[%s] Invalid Content-Length", LOG_TAG);
+      return PARSE_STATE::PS_ERROR;
+    }
+    content_length_ = length;
+  }
+
+  HeaderField field;
+  field.name_offset = static_cast<uint32_t>(name.data() - head_.data());
+  field.name_length = static_cast<uint32_t>(name.size());
+  field.value_offset = static_cast<uint32_t>(value.data() - head_.data());
+  field.value_length = static_cast<uint32_t>(value.size());
+  headers_.push_back(field);
+  if (key != HK_UNKNOWN) {
+    header_slots_[key] = static_cast<int>(headers_.size()) - 1;
   }
-  // 解析错误
-  return PARSE_STATE::PS_ERROR;
+  return PARSE_STATE::PS_HEADERS;
 }
-HttpRequest::PARSE_STATE HttpRequest::parse_body(const string &line) {
-  if (header_["Content-Type"] == "application/json" ||
-      header_["content-type"] == "application/json") {
+HttpRequest::PARSE_STATE HttpRequest::parse_body(StringView line) {
+  body_ = line;
+  if (equals_ignore_case(query_header(HK_CONTENT_TYPE), "application/json")) {
     // 只解析json格式请求
     string error;
-    post_ = Json::parse(line, error);
+    post_ = Json::parse(string(line.data(), line.size()), error);
     if (error != "") {
       // 解析发生错误
       LOG_ERROR("[%s] Body(json) parse error: %s", LOG_TAG, error.data());
@@ -1,18 +1,30 @@
 #pragma once
 
 #include <error.h>
-#include <regex>
+#include <strings.h>
+
+#include <stdint.h>
+
 #include <string>
-#include <unordered_map>
-#include <unordered_set>
+#include <vector>
 
 #include "buffer/buffer.h"
+#include "buffer/string_view.h"
 #include "json11/json11.hpp"
 #include "log/log.h"
 
 using json11::Json;
 using std::string;
 
+/*
+请求行和请求体不复制,以视图的形式指向读缓存中的数据:
+  开始解析一个请求时 pin 住读缓存, clear 时 unpin,期间这些数据不会被移动或覆盖
+  复制 HttpRequest 时(如交给协程路由)把引用的数据复制到副本自己的存储中,
+  副本不依赖读缓存
+请求头也不复制,按(偏移,长度)记录在 headers_ 中,偏移相对于 head_ 的开头;
+常用的请求头在解析时确定 HEADER_KEY,按 HEADER_KEY 直接查找,其余按名称顺序比较,
+名称不区分大小写,查找不分配内存
+*/
 namespace MiniServer {
 
 class HttpRequest {
@@ -29,47 +41,121 @@ class HttpRequest {
     PR_INCOMPLETE,
     PR_SUCCESS,
   };
-  HttpRequest() {
+  // 常用的请求头
+  enum HEADER_KEY {
+    HK_UNKNOWN = -1,
+    HK_HOST,
+    HK_CONNECTION,
+    HK_CONTENT_LENGTH,
+    HK_CONTENT_TYPE,
+    HK_TRANSFER_ENCODING,
+    HK_ACCEPT,
+    HK_ACCEPT_ENCODING,
+    HK_ACCEPT_LANGUAGE,
+    HK_USER_AGENT,
+    HK_COOKIE,
+    HK_REFERER,
+    HK_RANGE,
+    HK_IF_MODIFIED_SINCE,
+    HK_IF_NONE_MATCH,
+    HK_X_FORWARDED_FOR,
+    HK_COUNT,
+  };
+  // 请求行和请求头的最大长度,超过时回复 431 并关闭连接
+  static const size_t HEADER_SIZE_MAX = 16 * 1024;
+
+  HttpRequest()
+      : state_(PS_REQUEST_LINES), pinned_buffer_(nullptr), scanned_(0) {
     init();
   }
+  // 析构时不 unpin: 读缓存可能先于请求析构,由读缓存自己释放换下的存储
   ~HttpRequest() = default;
+  HttpRequest(const HttpRequest &other);
+  HttpRequest &operator=(const HttpRequest &other);
 
   void init();
   void clear();
   PARSE_RESULT parse(Buffer &buffer);
+  // 解析失败(PR_ERROR)时回复的状态码
+  int get_error_code() const { return error_code_; }
+  // 请求体的最大长度,超过时回复 413 并关闭连接
+  static void set_body_size_max(size_t size) { body_size_max_ = size; }
+  static size_t get_body_size_max() { return body_size_max_; }
 
-  string get_path() const { return path_; }
+  string get_path() const { return string(path_.data(), path_.size()); }
 
-  string get_method() const { return method_; }
-  string get_version() const { return version_; }
+  string get_method() const { return string(method_.data(), method_.size()); }
+  string get_version() const {
+    return string(version_.data(), version_.size());
+  }
+  // 不复制的视图,在 clear 之前有效
+  StringView get_path_view() const { return path_; }
+  StringView get_body() const { return body_; }
 
   bool get_is_keep_alive() const;
 
-  const string query_header(const string &key) const;
-  const string query_header(const char *key) const;
-  const std::unordered_map<string, string> get_header() const {
-    return header_;
+  // 请求头的值,没有时为空; 同名的请求头有多个时取最后一个
+  // 返回的视图在 clear 之前有效
+  StringView query_header(HEADER_KEY key) const;
+  StringView query_header(StringView name) const;
+  StringView query_header(const string &name) const {
+    return query_header(StringView(name.data(), name.size()));
+  }
+  StringView query_header(const char *name) const {
+    return query_header(StringView(name));
   }
+  // 按到达顺序遍历所有请求头
+  size_t get_header_count() const { return headers_.size(); }
+  StringView get_header_name(size_t index) const;
+  StringView get_header_value(size_t index) const;
+  // 名称对应的 HEADER_KEY(不区分大小写),不是常用的请求头时返回 HK_UNKNOWN
+  static HEADER_KEY intern_header(StringView name);
 
   const Json query_post(const string &key) const;
   const Json query_post(const char *key) const;
   const Json get_post() const { return post_; }
 
  private:
-  PARSE_STATE parse_request_line(const string &line);
-  PARSE_STATE parse_header(const string &line);
-  PARSE_STATE parse_body(const string &line);
+  // data 从当前行开始到请求头结束,用 HttpScanner 查找分隔符并同时检查字符,
+  // 不使用正则,不分配内存; 成功时 consumed 为这一行的长度(含 CRLF)
+  PARSE_STATE parse_request_line(StringView data, size_t *consumed);
+  PARSE_STATE parse_header(StringView data, size_t *consumed);
+  PARSE_STATE parse_body(StringView line);
+  // 请求头结束后按 Content-Length 确定请求体的长度
+  PARSE_STATE frame_body_();
+  void unpin_();
+  PARSE_STATE add_header_(StringView name, StringView value);
 
   PARSE_STATE state_;
-  string method_;
-  string path_;
-  string version_;
-  string body_;
-
-  std::unordered_map<string, string> header_;
+  // 请求行和请求头整体、请求体,其余视图都指向这两段之中
+  StringView head_;
+  StringView method_;
+  StringView path_;
+  StringView version_;
+  StringView body_;
+  // pin 住的读缓存; 副本不引用读缓存,数据在 owned_ 中
+  Buffer *pinned_buffer_;
+  string owned_;
+
+  // 请求头在 head_ 中的位置,clear 时保留容量,之后的请求不再分配
+  struct HeaderField {
+    uint32_t name_offset;
+    uint32_t name_length;
+    uint32_t value_offset;
+    uint32_t value_length;
+  };
+  std::vector<HeaderField> headers_;
+  // 常用请求头在 headers_ 中的下标, -1 表示没有
+  int header_slots_[HK_COUNT];
+  // 解析出的 Content-Length
+  size_t content_length_;
   Json post_;
+  // 请求头未接收完时,从读指针开始已经查找过请求头结尾的字节数
+  // 下次从这里(往前退 3 个字节)继续查找,不重复扫描
+  size_t scanned_;
+  int error_code_;
 
-  
+  static size_t body_size_max_;
 };
 
 }  // namespace MiniServer
@@ -4,8 +4,16 @@ const static char LOG_TAG[] = "HTTP_RESPONSE";
 
 namespace MiniServer {
 unordered_map<string, router_cb> HttpResponse::dynamic_router_;
+unordered_map<string, ROUTER_MODE> HttpResponse::router_mode_;
 unordered_map<string, string> HttpResponse::static_router_ = {
     {"/", "/index.html"}};
+int HttpResponse::keep_alive_max_ = 6;
+int HttpResponse::keep_alive_timeout_s_ = 120;
+string HttpResponse::keep_alive_header_ =
+    "Connection: keep-alive\r\nKeep-Alive: max=6, timeout=120\r\n";
+
+static const char CONNECTION_CLOSE[] = "Connection: close\r\n";
+static const string TEXT_PLAIN_LINE = "Content-type: text/plain\r\n";
 
 // 预设文件类型
 const unordered_map<string, string> HttpResponse::SUFFIX_TYPE = {
@@ -32,10 +40,40 @@ const unordered_map<string, string> HttpResponse::SUFFIX_TYPE = {
 
 // 预设状态码
 const unordered_map<int, string> HttpResponse::CODE_STATUS = {
-    {200, "OK"},        {400, "Bad Request"},           {403, "Forbidden"},
-    {404, "Not Found"}, {500, "Internal Server Error"},
+    {200, "OK"},
+    {400, "Bad Request"},
+    {403, "Forbidden"},
+    {404, "Not Found"},
+    {413, "Payload Too Large"},
+    {431, "Request Header Fields Too Large"},
+    {500, "Internal Server Error"},
 };
 
+static unordered_map<int, string> make_status_lines(
+    const unordered_map<int, string> &code_status) {
+  unordered_map<int, string> lines;
+  for (const auto &item : code_status) {
+    lines[item.first] = "HTTP/1.1 " + std::to_string(item.first) + " " +
+                        item.second + "\r\n";
+  }
+  return lines;
+}
+
+static unordered_map<string, string> make_content_type_lines(
+    const unordered_map<string, string> &suffix_type) {
+  unordered_map<string, string> lines;
+  for (const auto &item : suffix_type) {
+    lines[item.first] = "Content-type: " + item.second + "\r\n";
+  }
+  return lines;
+}
+
+// 与上面两个表定义在同一文件中,按定义顺序初始化
+const unordered_map<int, string> HttpResponse::STATUS_LINE =
+    make_status_lines(HttpResponse::CODE_STATUS);
+const unordered_map<string, string> HttpResponse::CONTENT_TYPE_LINE =
+    make_content_type_lines(HttpResponse::SUFFIX_TYPE);
+
 // 预设错误代码页面文件
 const unordered_map<int, string> HttpResponse::ERROR_CODE_FILE = {
     {400, "/400.html"},
@@ -46,15 +84,15 @@ const unordered_map<int, string> HttpResponse::ERROR_CODE_FILE = {
 HttpResponse::HttpResponse() {
   code_ = -1;
   is_keep_alive_ = false;
+  has_dynamic_result_ = false;
+  dynamic_result_ = false;
 
   src_dir_ = "";
   file_path_ = "";
 
-  // 将返回的资源文件映射至内存后的指针
-  mm_file_ = nullptr;
   mm_file_stat_ = {0};
 }
-HttpResponse::~HttpResponse() { unmap_file(); }
+HttpResponse::~HttpResponse() {}
 void HttpResponse::init(const std::string &src_dir,
                         const std::string &file_path, bool is_keep_alive,
                         int code) {
@@ -65,25 +103,51 @@ void HttpResponse::init(const std::string &src_dir,
   file_path_ = file_path;
 
   dynamic_buffer_.clear();
+  has_dynamic_result_ = false;
+  // 长连接上的下一个响应可能是动态路由,不能残留上一个文件的大小
+  mm_file_stat_ = {0};
 }
 // 处理动态路由时需要request里的post_
-void HttpResponse::make_response(const HttpRequest &request, Buffer &buffer) {
-  if (dynamic_router_.count(file_path_) > 0) {
+void HttpResponse::make_response(const HttpRequest &request,
+                                 ChainBuffer &buffer) {
+  if (code_ >= 400) {
+    // 请求解析失败(如请求头或请求体过大): 不执行路由,也不读取请求的文件
+    file_path_.clear();
+    response_to_code_();
+    add_state_line_(buffer);
+    add_header_(buffer);
+    if (file_path_.empty()) {
+      add_error_content(buffer, "Request rejected.");
+    } else {
+      add_content_(buffer);
+    }
+    return;
+  }
+  if (has_dynamic_result_ || dynamic_router_.count(file_path_) > 0) {
     // 动态路由
     LOG_DEBUG("[%s] Processing dynamic request.", LOG_TAG);
 
-    dynamic_buffer_.clear();
-    if (dynamic_router_[file_path_](request, dynamic_buffer_)) {
+    bool ok;
+    if (has_dynamic_result_) {
+      // 协程路由已经执行完,结果在 dynamic_buffer_ 中
+      has_dynamic_result_ = false;
+      ok = dynamic_result_;
+    } else {
+      dynamic_buffer_.clear();
+      ok = dynamic_router_[file_path_](request, dynamic_buffer_);
+    }
+    if (ok) {
       // 动态路由成功 相应状态码
       response_to_code_();
 
       add_state_line_(buffer);
       add_header_(buffer);
 
-      buffer.write_buffer("Content-Length: " +
-                          std::to_string(dynamic_buffer_.get_readable_bytes()) +
-                          "\r\n\r\n");
-      buffer.write_buffer(dynamic_buffer_);
+      buffer.append("Content-Length: " +
+                    std::to_string(dynamic_buffer_.get_readable_bytes()) +
+                    "\r\n\r\n");
+      // 交换存储,响应体不复制
+      buffer.append_buffer(dynamic_buffer_);
       return;
     } else {
       // 动态路由出错
@@ -125,48 +189,63 @@ void HttpResponse::make_response(const HttpRequest &request, Buffer &buffer) {
   add_header_(buffer);
   add_content_(buffer);
 }
-char *HttpResponse::get_file() { return mm_file_; }
-void HttpResponse::unmap_file() {
-  if (mm_file_) {
-    munmap(mm_file_, mm_file_stat_.st_size);
-    mm_file_ = nullptr;
-    mm_file_stat_ = {0};
-  }
-}
 bool HttpResponse::register_static_router(string &src, string &des) {
   static_router_[src] = des;
   return true;
 }
-bool HttpResponse::register_dynamic_router(string &src, const router_cb &cb) {
+bool HttpResponse::register_dynamic_router(string &src, const router_cb &cb,
+                                           ROUTER_MODE mode) {
   dynamic_router_[src] = cb;
+  set_router_mode(src, mode);
   return true;
 }
-void HttpResponse::add_state_line_(Buffer &buff) {
-  string status;
-
-  if (CODE_STATUS.count(code_) == 1) {
-    status = CODE_STATUS.find(code_)->second;
+void HttpResponse::set_router_mode(const string &src, ROUTER_MODE mode) {
+  if (mode == RM_NONBLOCKING) {
+    router_mode_.erase(src);
   } else {
+    router_mode_[src] = mode;
+  }
+}
+ROUTER_MODE HttpResponse::get_router_mode(const string &path) {
+  if (router_mode_.empty()) {
+    return RM_NONBLOCKING;
+  }
+  auto it = router_mode_.find(path);
+  return it == router_mode_.end() ? RM_NONBLOCKING : it->second;
+}
+void HttpResponse::set_dynamic_result(bool ok, Buffer &body) {
+  dynamic_buffer_.clear();
+  dynamic_buffer_.swap(body);
+  has_dynamic_result_ = true;
+  dynamic_result_ = ok;
+}
+void HttpResponse::set_keep_alive(int max, int timeout_s) {
+  keep_alive_max_ = max;
+  keep_alive_timeout_s_ = timeout_s;
+  keep_alive_header_ = "Connection: keep-alive\r\nKeep-Alive: max=" +
+                       std::to_string(max) +
+                       ", timeout=" + std::to_string(timeout_s) + "\r\n";
+}
+void HttpResponse::add_state_line_(ChainBuffer &buff) {
+  auto it = STATUS_LINE.find(code_);
+  if (it == STATUS_LINE.end()) {
     // 若code_不在预定义的code_表里 代码逻辑正确时不会发生
     code_ = 400;
-    status = CODE_STATUS.find(code_)->second;
+    it = STATUS_LINE.find(code_);
   }
-
-  buff.write_buffer("HTTP/1.1 " + std::to_string(code_) + " " + status +
-                    "\r\n");
+  buff.append_static(it->second.data(), it->second.size());
 }
-void HttpResponse::add_header_(Buffer &buff) {
-  buff.write_buffer("Connection: ");
+void HttpResponse::add_header_(ChainBuffer &buff) {
   if (is_keep_alive_) {
-    buff.write_buffer("keep-alive\r\n");
-    buff.write_buffer("keep-alive: max=6, timeout=120\r\n");
+    buff.append_static(keep_alive_header_.data(), keep_alive_header_.size());
   } else {
-    buff.write_buffer("close\r\n");
+    buff.append_static(CONNECTION_CLOSE, sizeof(CONNECTION_CLOSE) - 1);
   }
-  buff.write_buffer("Content-type: " + get_file_type_() + "\r\n");
+  const string &content_type = get_content_type_line_();
+  buff.append_static(content_type.data(), content_type.size());
   // add_header_是不向缓存写入Content-Length的 因为静态和动态返回的不一样
 }
-void HttpResponse::add_content_(Buffer &buff) {
+void HttpResponse::add_content_(ChainBuffer &buff) {
   int fd = open((src_dir_ + file_path_).data(), O_RDONLY);
   if (fd < 0) {
     add_error_content(buff, "File Not Found.");
@@ -175,9 +254,19 @@ void HttpResponse::add_content_(Buffer &buff) {
     return;
   }
 
-  //?
-  int *mm_file = (int *)mmap(nullptr, mm_file_stat_.st_size, PROT_READ,
-                             MAP_PRIVATE, fd, 0);
+  size_t file_size = mm_file_stat_.st_size;
+  if (file_size >= SENDFILE_MIN_SIZE) {
+    // 大文件用 sendfile 直接从页缓存发送, fd 交给 buff 关闭
+    buff.append("Content-length: " + std::to_string(file_size) + "\r\n\r\n");
+    buff.append_file(fd, 0, file_size);
+    return;
+  }
+
+  char *mm_file = nullptr;
+  if (file_size > 0) {
+    mm_file = (char *)mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
   if (mm_file == MAP_FAILED) {
     add_error_content(buff, "File Not Found.");
     LOG_DEBUG("[%s] File \"%s\" not found.", LOG_TAG,
@@ -185,12 +274,12 @@ void HttpResponse::add_content_(Buffer &buff) {
     return;
   }
 
-  mm_file_ = (char *)mm_file;
-  close(fd);
-  buff.write_buffer("Content-length: " + std::to_string(mm_file_stat_.st_size) +
-                    "\r\n\r\n");
+  buff.append("Content-length: " + std::to_string(file_size) + "\r\n\r\n");
+  if (mm_file != nullptr) {
+    buff.append_mapped(mm_file, file_size);
+  }
 }
-void HttpResponse::add_error_content(Buffer &buff, std::string message) {
+void HttpResponse::add_error_content(ChainBuffer &buff, std::string message) {
   // 没有在服务器上正确获取文件至内存
   // 设计一个网页返回
   string body;
@@ -206,9 +295,8 @@ void HttpResponse::add_error_content(Buffer &buff, std::string message) {
   body += "<p>" + message + "</p>";
   body += "<hr><em>MiniServer</em></body></html>";
 
-  buff.write_buffer("Content-length: " + std::to_string(body.size()) +
-                    "\r\n\r\n");
-  buff.write_buffer(body);
+  buff.append("Content-length: " + std::to_string(body.size()) + "\r\n\r\n");
+  buff.append(body);
 }
 void HttpResponse::response_to_code_() {
   if (ERROR_CODE_FILE.count(code_) == 1) {
@@ -216,21 +304,21 @@ void HttpResponse::response_to_code_() {
     stat((src_dir_ + file_path_).data(), &mm_file_stat_);
   }
 }
-string HttpResponse::get_file_type_() {
+const string &HttpResponse::get_content_type_line_() {
   string::size_type idx = file_path_.find_last_of('.');
 
   // 无后缀
   if (idx == string::npos) {
-    return "text/plain";
+    return TEXT_PLAIN_LINE;
   }
 
-  string suffix = file_path_.substr(idx);
   // 后缀在预设内
-  if (SUFFIX_TYPE.count(suffix) == 1) {
-    return SUFFIX_TYPE.find(suffix)->second;
+  auto it = CONTENT_TYPE_LINE.find(file_path_.substr(idx));
+  if (it != CONTENT_TYPE_LINE.end()) {
+    return it->second;
   }
 
   // 后缀不在预设内
-  return "text/plain";
+  return TEXT_PLAIN_LINE;
 }
 }  // namespace MiniServer
\ No newline at end of file
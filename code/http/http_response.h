@@ -8,6 +8,7 @@
 #include <unordered_map>
 
 #include "buffer/buffer.h"
+#include "buffer/chain_buffer.h"
 #include "http_request.h"
 #include "log/log.h"
 using std::string;
@@ -19,6 +20,16 @@ namespace MiniServer {
 typedef std::function<bool(const HttpRequest &request, Buffer &buffer)>
     router_cb;
 
+// 动态路由的执行方式
+enum ROUTER_MODE {
+  // 在处理请求的线程中直接执行
+  RM_NONBLOCKING,
+  // 会阻塞(如查询数据库),交给单独的阻塞线程池执行
+  RM_BLOCKING,
+  // C++20 协程路由,在连接所属的循环线程中执行,等待时挂起(见 server/co_router.h)
+  RM_COROUTINE,
+};
+
 class HttpResponse {
  public:
   HttpResponse();
@@ -27,35 +38,55 @@ class HttpResponse {
   void init(const std::string &src_dir, const std::string &file_path,
             bool is_keep_alive = false, int code = -1);
 
-  void make_response(const HttpRequest &request, Buffer &buffer);
-
-  // 获取映射至内存的文件指针
-  char *get_file();
-  // 释放内存中的文件
-  void unmap_file();
+  // 响应追加到 buffer 中: 固定的响应头引用静态字符串,动态路由的响应体直接转交,
+  // 文件以映射或文件区间的形式加入,都不复制; 文件由 buffer 负责释放
+  void make_response(const HttpRequest &request, ChainBuffer &buffer);
 
+  // 本次响应的文件大小(没有文件时为 0)
   size_t get_file_size() const { return mm_file_stat_.st_size; };
   int get_code() const { return code_; };
 
+  // 超过该大小的文件用 sendfile 发送,较小的文件映射后与响应头一起 writev
+  static const size_t SENDFILE_MIN_SIZE = 64 * 1024;
+
   static bool register_static_router(string &src, string &des);
-  static bool register_dynamic_router(string &src, const router_cb &cb);
+  static bool register_dynamic_router(string &src, const router_cb &cb,
+                                      ROUTER_MODE mode = RM_NONBLOCKING);
+  // 设置路由的执行方式,协程路由的回调由 Server 保存
+  static void set_router_mode(const string &src, ROUTER_MODE mode);
+  // 没有单独设置的路由返回 RM_NONBLOCKING
+  static ROUTER_MODE get_router_mode(const string &path);
+
+  // 协程路由已经在其他地方执行完时,用它的结果代替调用路由函数
+  // 需要在 init 之后、make_response 之前调用; body 的内容被转交(交换存储)
+  void set_dynamic_result(bool ok, Buffer &body);
+  // 连接空闲时归还动态路由缓冲区的存储
+  void release_buffer() { dynamic_buffer_.release(); }
+
+  // 设置响应头中声明的长连接参数(单连接最大请求数,空闲超时秒数)
+  // 响应会引用生成的响应头,只能在处理请求之前调用
+  static void set_keep_alive(int max, int timeout_s);
 
  private:
   // 分别生成状态行 响应头 响应体
-  void add_state_line_(Buffer &buff);
-  void add_header_(Buffer &buff);
-  void add_content_(Buffer &buff);
+  void add_state_line_(ChainBuffer &buff);
+  void add_header_(ChainBuffer &buff);
+  void add_content_(ChainBuffer &buff);
 
   // 生成错误信息
-  void add_error_content(Buffer &buff, std::string message);
+  void add_error_content(ChainBuffer &buff, std::string message);
 
   // 若code_为错误码，根据code_取出对应错误时应返回的网页文件
   void response_to_code_();
 
-  string get_file_type_();
+  // 文件类型对应的 "Content-type: ...\r\n"
+  const string &get_content_type_line_();
 
   // 处理动态路由时使用的buffer
   Buffer dynamic_buffer_;
+  // set_dynamic_result 设置的结果
+  bool has_dynamic_result_;
+  bool dynamic_result_;
 
   int code_;
   bool is_keep_alive_;
@@ -64,15 +95,24 @@ class HttpResponse {
   // 静态路由的文件 动态路由的标识符
   string file_path_;
 
-  char *mm_file_;
   struct stat mm_file_stat_;
 
   static const unordered_map<string, string> SUFFIX_TYPE;
   static const unordered_map<int, string> CODE_STATUS;
+  // 预先生成的状态行和 Content-type 行,响应中直接引用
+  static const unordered_map<int, string> STATUS_LINE;
+  static const unordered_map<string, string> CONTENT_TYPE_LINE;
+  // 连接保持时的 Connection 和 Keep-Alive 两行,由 set_keep_alive 生成
+  static string keep_alive_header_;
   static const unordered_map<int, string> ERROR_CODE_FILE;
 
   // 动态路由处理需要查询数据库的POST请求 静态路由处理静态资源文件的跳转
   static unordered_map<string, router_cb> dynamic_router_;
   static unordered_map<string, string> static_router_;
+  // 不在处理请求的线程中直接执行的路由
+  static unordered_map<string, ROUTER_MODE> router_mode_;
+
+  static int keep_alive_max_;
+  static int keep_alive_timeout_s_;
 };
 }  // namespace MiniServer
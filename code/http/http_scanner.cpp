@@ -0,0 +1,298 @@
+#include "http_scanner.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+// 用函数的 target 属性单独为各个实现启用指令集,整体的编译选项不变
+#define MINISERVER_SCAN_X86
+#include <immintrin.h>
+#endif
+
+namespace MiniServer {
+
+// RFC 7230 tchar: 方法和请求头名称中允许的字符
+static constexpr bool TOKEN_CHARS[256] = {
+    // 0x00 - 0x1f 控制字符
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    //  !  "  #  $  %  &  '  (  )  *  +  ,  -  .  /
+    0, 1, 0, 1, 1, 1, 1, 1, 0, 0, 1, 1, 0, 1, 1, 0,
+    // 0-9                           :  ;  <  =  >  ?
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0,
+    // @  A-O
+    0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    // P-Z                           [  \  ]  ^  _
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 1,
+    // `  a-o
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    // p-z                           {  |  }  ~  DEL
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 0, 1, 0,
+    // 0x80 - 0xff
+};
+
+// 请求目标和版本: 可见字符和 obs-text(0x80 以上)
+static inline bool is_target_char(unsigned char c) {
+  return c > 0x20 && c != 0x7f;
+}
+
+// 请求头的值: 可见字符、obs-text、空格和制表符
+static inline bool is_value_char(unsigned char c) {
+  return c >= 0x20 ? c != 0x7f : c == '\t';
+}
+
+static const char* scan_token_scalar(const char* p, const char* end) {
+  while (p != end && TOKEN_CHARS[static_cast<unsigned char>(*p)]) {
+    p++;
+  }
+  return p;
+}
+
+static const char* scan_target_scalar(const char* p, const char* end) {
+  while (p != end && is_target_char(*p)) {
+    p++;
+  }
+  return p;
+}
+
+static const char* scan_value_scalar(const char* p, const char* end) {
+  while (p != end && is_value_char(*p)) {
+    p++;
+  }
+  return p;
+}
+
+#ifdef MINISERVER_SCAN_X86
+
+// SSE4.2: pcmpestri 一次比较 16 字节是否落在最多 8 个字符范围中,返回第一个的位置
+#define SCAN_RANGES_MODE \
+  (_SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_LEAST_SIGNIFICANT)
+
+// 不是 token 的字符,共 10 个范围,合并为 8 个后多包含了 '|' 和 '~'
+alignas(16) static const char TOKEN_RANGES[16] = {
+    '\x00', ' ', '"', '"', '(', ')', ',', ',',
+    '/',    '/', ':', '@', '[', ']', '{', '\xff',
+};
+alignas(16) static const char TARGET_RANGES[16] = {'\x00', ' ', '\x7f',
+                                                   '\x7f'};
+alignas(16) static const char VALUE_RANGES[16] = {
+    '\x00', '\x08', '\x0a', '\x1f', '\x7f', '\x7f',
+};
+
+__attribute__((target("sse4.2"))) static const char* scan_token_sse42(
+    const char* p, const char* end) {
+  const __m128i ranges =
+      _mm_load_si128(reinterpret_cast<const __m128i*>(TOKEN_RANGES));
+  while (end - p >= 16) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    int index = _mm_cmpestri(ranges, 16, block, 16, SCAN_RANGES_MODE);
+    if (index == 16) {
+      p += 16;
+      continue;
+    }
+    p += index;
+    if (!TOKEN_CHARS[static_cast<unsigned char>(*p)]) {
+      return p;
+    }
+    // '|' 或 '~',跳过继续
+    p++;
+  }
+  return scan_token_scalar(p, end);
+}
+
+__attribute__((target("sse4.2"))) static const char* scan_target_sse42(
+    const char* p, const char* end) {
+  const __m128i ranges =
+      _mm_load_si128(reinterpret_cast<const __m128i*>(TARGET_RANGES));
+  while (end - p >= 16) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    int index = _mm_cmpestri(ranges, 4, block, 16, SCAN_RANGES_MODE);
+    if (index != 16) {
+      return p + index;
+    }
+    p += 16;
+  }
+  return scan_target_scalar(p, end);
+}
+
+__attribute__((target("sse4.2"))) static const char* scan_value_sse42(
+    const char* p, const char* end) {
+  const __m128i ranges =
+      _mm_load_si128(reinterpret_cast<const __m128i*>(VALUE_RANGES));
+  while (end - p >= 16) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    int index = _mm_cmpestri(ranges, 6, block, 16, SCAN_RANGES_MODE);
+    if (index != 16) {
+      return p + index;
+    }
+    p += 16;
+  }
+  return scan_value_scalar(p, end);
+}
+
+// AVX2: 每次 32 字节,用比较得到不合法字符的掩码
+// token 字符用低 4 位查表: TOKEN_NIBBLES[低 4 位] 的第 h 位表示高 4 位为 h 的字符是否为 token
+struct TokenNibbles {
+  uint8_t bits[16];
+};
+
+static constexpr TokenNibbles make_token_nibbles() {
+  TokenNibbles nibbles = {};
+  for (int c = 0; c < 128; c++) {
+    if (TOKEN_CHARS[c]) {
+      nibbles.bits[c & 0x0f] |= static_cast<uint8_t>(1 << (c >> 4));
+    }
+  }
+  return nibbles;
+}
+
+alignas(16) static constexpr TokenNibbles TOKEN_NIBBLES = make_token_nibbles();
+// 高 4 位对应的位, 0x80 以上不是 token
+alignas(16) static const uint8_t HIGH_NIBBLE_BITS[16] = {
+    0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+__attribute__((target("avx2"))) static const char* scan_token_avx2(
+    const char* p, const char* end) {
+  const __m256i low_table = _mm256_broadcastsi128_si256(
+      _mm_load_si128(reinterpret_cast<const __m128i*>(TOKEN_NIBBLES.bits)));
+  const __m256i high_table = _mm256_broadcastsi128_si256(
+      _mm_load_si128(reinterpret_cast<const __m128i*>(HIGH_NIBBLE_BITS)));
+  const __m256i nibble_mask = _mm256_set1_epi8(0x0f);
+  const __m256i zero = _mm256_setzero_si256();
+  while (end - p >= 32) {
+    __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    __m256i low = _mm256_and_si256(block, nibble_mask);
+    __m256i high = _mm256_and_si256(_mm256_srli_epi16(block, 4), nibble_mask);
+    __m256i row = _mm256_shuffle_epi8(low_table, low);
+    __m256i bit = _mm256_shuffle_epi8(high_table, high);
+    __m256i invalid = _mm256_cmpeq_epi8(_mm256_and_si256(row, bit), zero);
+    uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(invalid));
+    if (mask != 0) {
+      return p + __builtin_ctz(mask);
+    }
+    p += 32;
+  }
+  return scan_token_scalar(p, end);
+}
+
+__attribute__((target("avx2"))) static const char* scan_target_avx2(
+    const char* p, const char* end) {
+  const __m256i space = _mm256_set1_epi8(0x20);
+  const __m256i del = _mm256_set1_epi8(0x7f);
+  while (end - p >= 32) {
+    __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    // 无符号比较 block <= 0x20: min(block, 0x20) == block
+    __m256i control =
+        _mm256_cmpeq_epi8(_mm256_min_epu8(block, space), block);
+    __m256i invalid =
+        _mm256_or_si256(control, _mm256_cmpeq_epi8(block, del));
+    uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(invalid));
+    if (mask != 0) {
+      return p + __builtin_ctz(mask);
+    }
+    p += 32;
+  }
+  return scan_target_scalar(p, end);
+}
+
+__attribute__((target("avx2"))) static const char* scan_value_avx2(
+    const char* p, const char* end) {
+  const __m256i unit_separator = _mm256_set1_epi8(0x1f);
+  const __m256i tab = _mm256_set1_epi8('\t');
+  const __m256i del = _mm256_set1_epi8(0x7f);
+  while (end - p >= 32) {
+    __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    // 控制字符(block <= 0x1f)中去掉制表符,加上 DEL
+    __m256i control =
+        _mm256_cmpeq_epi8(_mm256_min_epu8(block, unit_separator), block);
+    control = _mm256_andnot_si256(_mm256_cmpeq_epi8(block, tab), control);
+    __m256i invalid =
+        _mm256_or_si256(control, _mm256_cmpeq_epi8(block, del));
+    uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(invalid));
+    if (mask != 0) {
+      return p + __builtin_ctz(mask);
+    }
+    p += 32;
+  }
+  return scan_value_scalar(p, end);
+}
+
+#endif
+
+const HttpScanner::Impl* HttpScanner::select_(SCAN_LEVEL level) {
+  static const Impl SCALAR = {SL_SCALAR, scan_token_scalar, scan_target_scalar,
+                              scan_value_scalar};
+#ifdef MINISERVER_SCAN_X86
+  static const Impl SSE42 = {SL_SSE42, scan_token_sse42, scan_target_sse42,
+                             scan_value_sse42};
+  static const Impl AVX2 = {SL_AVX2, scan_token_avx2, scan_target_avx2,
+                            scan_value_avx2};
+  if (level == SL_AVX2) {
+    return &AVX2;
+  }
+  if (level == SL_SSE42) {
+    return &SSE42;
+  }
+#endif
+  (void)level;
+  return &SCALAR;
+}
+
+// 静态初始化时选择 CPU 支持的最快实现
+const HttpScanner::Impl* HttpScanner::impl_ =
+    HttpScanner::select_(HttpScanner::get_best_level());
+
+HttpScanner::SCAN_LEVEL HttpScanner::get_best_level() {
+#ifdef MINISERVER_SCAN_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return SL_AVX2;
+  }
+  if (__builtin_cpu_supports("sse4.2")) {
+    return SL_SSE42;
+  }
+#endif
+  return SL_SCALAR;
+}
+
+const char* HttpScanner::get_level_name(SCAN_LEVEL level) {
+  switch (level) {
+    case SL_AVX2:
+      return "avx2";
+    case SL_SSE42:
+      return "sse4.2";
+    default:
+      return "scalar";
+  }
+}
+
+bool HttpScanner::set_level(SCAN_LEVEL level) {
+  if (level > get_best_level()) {
+    return false;
+  }
+  impl_ = select_(level);
+  return true;
+}
+
+bool HttpScanner::is_token_char(char c) {
+  return TOKEN_CHARS[static_cast<unsigned char>(c)];
+}
+
+const char* HttpScanner::find_header_end(const char* begin, const char* end) {
+  // glibc 的 memchr 已经是向量化的,先找 CR 再比较后面三个字节
+  const char* p = begin;
+  while (end - p >= 4) {
+    p = static_cast<const char*>(memchr(p, '\r', end - p - 3));
+    if (p == nullptr) {
+      return nullptr;
+    }
+    if (p[1] == '\n' && p[2] == '\r' && p[3] == '\n') {
+      return p;
+    }
+    p++;
+  }
+  return nullptr;
+}
+
+}  // namespace MiniServer
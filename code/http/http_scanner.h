@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stddef.h>
+
+/*
+解析请求行和请求头时查找分隔符的扫描函数
+  每个函数从 begin 开始,返回第一个不属于某类字符的位置(都属于时返回 end),
+  分隔符(空格、冒号、CR)在查找的同时完成了前面字符的合法性检查
+  x86-64 上按 CPU 支持的指令集选择实现: AVX2 每次 32 字节,SSE4.2 每次 16 字节,
+  其他平台或不支持时逐字节查表
+*/
+namespace MiniServer {
+
+class HttpScanner {
+ public:
+  enum SCAN_LEVEL {
+    SL_SCALAR,
+    SL_SSE42,
+    SL_AVX2,
+  };
+
+  // 第一个不是 token 字符(RFC 7230 tchar)的位置: 方法、请求头名称
+  static const char* scan_token(const char* begin, const char* end) {
+    return impl_->scan_token(begin, end);
+  }
+  // 第一个不是可见字符(空格、控制字符、DEL)的位置: 请求目标、版本
+  static const char* scan_target(const char* begin, const char* end) {
+    return impl_->scan_target(begin, end);
+  }
+  // 第一个除制表符外的控制字符或 DEL 的位置: 请求头的值,正常情况下停在 CR
+  static const char* scan_value(const char* begin, const char* end) {
+    return impl_->scan_value(begin, end);
+  }
+  // "\r\n\r\n" 的位置,没有时返回 nullptr
+  static const char* find_header_end(const char* begin, const char* end);
+
+  static bool is_token_char(char c);
+
+  // CPU 支持的最高级别 / 当前使用的级别
+  static SCAN_LEVEL get_best_level();
+  static SCAN_LEVEL get_level() { return impl_->level; }
+  static const char* get_level_name(SCAN_LEVEL level);
+  // 指定使用的级别(测试和对比用),超过 CPU 支持的级别时不修改,返回是否成功
+  static bool set_level(SCAN_LEVEL level);
+
+ private:
+  typedef const char* (*scan_func)(const char*, const char*);
+  struct Impl {
+    SCAN_LEVEL level;
+    scan_func scan_token;
+    scan_func scan_target;
+    scan_func scan_value;
+  };
+
+  static const Impl* select_(SCAN_LEVEL level);
+
+  static const Impl* impl_;
+};
+
+}  // namespace MiniServer
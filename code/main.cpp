@@ -12,14 +12,18 @@ int main() {
 
   // 注册动态路由
   
-  server.register_dynamic_router("/action/login", router_login);
+  // 查询数据库的路由在阻塞线程池中执行
+  using MiniServer::RM_BLOCKING;
+  server.register_dynamic_router("/action/login", router_login, RM_BLOCKING);
   server.register_dynamic_router("/action/logout", router_logout);
-  server.register_dynamic_router("/action/register", router_register);
-  server.register_dynamic_router("/action/add", router_add);
-  server.register_dynamic_router("/action/query", router_query);
-  server.register_dynamic_router("/action/random_query", router_random_query);
-  server.register_dynamic_router("/action/update", router_update);
-  server.register_dynamic_router("/action/delete", router_delete);
+  server.register_dynamic_router("/action/register", router_register,
+                                 RM_BLOCKING);
+  server.register_dynamic_router("/action/add", router_add, RM_BLOCKING);
+  server.register_dynamic_router("/action/query", router_query, RM_BLOCKING);
+  server.register_dynamic_router("/action/random_query", router_random_query,
+                                 RM_BLOCKING);
+  server.register_dynamic_router("/action/update", router_update, RM_BLOCKING);
+  server.register_dynamic_router("/action/delete", router_delete, RM_BLOCKING);
   
   server.start();
 }
\ No newline at end of file
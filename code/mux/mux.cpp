@@ -4,30 +4,61 @@ const static char LOG_TAG[] = "mux";
 
 namespace MiniServer {
 
-Mux::Mux(int max_event) : mux_fd_(epoll_create(max_event)), events_(max_event) {
-  assert(mux_fd_ >= 0 && events_.size() > 0);
+Mux::Mux(int max_event, MUX_BACKEND backend)
+    : mux_fd_(-1), syscall_count_(0), events_count_(0), events_(max_event) {
+  if (backend == MUX_URING) {
+    uring_.reset(new UringPoller(max_event));
+    if (!uring_->is_valid()) {
+      LOG_WARN("[%s] io_uring is unavailable, fall back to epoll.", LOG_TAG);
+      uring_.reset();
+    } else {
+      completions_.resize(max_event);
+    }
+  }
+  if (!uring_) {
+    mux_fd_ = epoll_create(max_event);
+  }
+  assert((uring_ || mux_fd_ >= 0) && events_.size() > 0);
+}
+Mux::~Mux() {
+  if (mux_fd_ >= 0) {
+    close(mux_fd_);
+  }
 }
-Mux::~Mux() { close(mux_fd_); }
 bool Mux::add_fd(int fd, uint32_t events) {
+  return add_fd(fd, events, static_cast<mux_token>(fd));
+}
+bool Mux::mod_fd(int fd, uint32_t events) {
+  return mod_fd(fd, events, static_cast<mux_token>(fd));
+}
+bool Mux::add_fd(int fd, uint32_t events, mux_token token) {
   if (fd < 0) {
     return false;
   }
+  if (uring_) {
+    return uring_->add_fd(fd, events, token);
+  }
 
   epoll_event ev = {0};
-  ev.data.fd = fd;
+  ev.data.u64 = token;
   ev.events = events;
 
+  syscall_count_.fetch_add(1, std::memory_order_relaxed);
   return 0 == epoll_ctl(mux_fd_, EPOLL_CTL_ADD, fd, &ev);
 }
-bool Mux::mod_fd(int fd, uint32_t events) {
+bool Mux::mod_fd(int fd, uint32_t events, mux_token token) {
   if (fd < 0) {
     return false;
   }
+  if (uring_) {
+    return uring_->mod_fd(fd, events, token);
+  }
 
   epoll_event ev = {0};
-  ev.data.fd = fd;
+  ev.data.u64 = token;
   ev.events = events;
 
+  syscall_count_.fetch_add(1, std::memory_order_relaxed);
   return 0 == epoll_ctl(mux_fd_, EPOLL_CTL_MOD, fd, &ev);
 }
 bool Mux::del_fd(int fd) {
@@ -35,31 +66,66 @@ bool Mux::del_fd(int fd) {
     LOG_WARN("[%s] Delete a negative fd[%d]!", LOG_TAG, fd);
     return false;
   }
+  if (uring_) {
+    return uring_->del_fd(fd);
+  }
 
   epoll_event ev = {0};
 
+  syscall_count_.fetch_add(1, std::memory_order_relaxed);
   return 0 == epoll_ctl(mux_fd_, EPOLL_CTL_DEL, fd, &ev);
 }
+bool Mux::add_accept(int fd, mux_token token) {
+  return has_completion() && uring_->add_accept(fd, token);
+}
+bool Mux::add_recv(int fd, mux_token token) {
+  return has_completion() && uring_->add_recv(fd, token);
+}
 int Mux::wait(int timeout) {
   // 当一个线程在对epoll_wait()的调用中被阻塞时，
   // 另一个线程有可能向等待的epoll实例添加文件描述符。
   // 如果新文件描述符准备就绪，它将导致epoll_wait()调用解除阻塞。
-  events_count_ = epoll_wait(mux_fd_, &events_[0],
-                             static_cast<int>(events_.size()), timeout);
+  if (uring_) {
+    events_count_ = uring_->wait(&events_[0], &completions_[0],
+                                 static_cast<int>(events_.size()), timeout);
+  } else {
+    syscall_count_.fetch_add(1, std::memory_order_relaxed);
+    events_count_ = epoll_wait(mux_fd_, &events_[0],
+                               static_cast<int>(events_.size()), timeout);
+  }
 
   if (events_count_ < 0) {
     LOG_ERROR("[%s] epoll_wait error with error:[%d]", LOG_TAG, errno);
   }
   return events_count_;
 }
+uint64_t Mux::get_syscall_count() const {
+  return uring_ ? uring_->get_syscall_count() : syscall_count_.load();
+}
 int Mux::get_active_fd(int i) const {
   // 当epoll_wait阻塞时若被信号中断，在线程处理完信号函数后返回时，epoll_wait()不会继续阻塞，而是推出，返回-1。
   // 所以不能assert(i < events_count_)
   assert(i < events_.size() && i >= 0);
-  return events_[i].data.fd;
+  return static_cast<int>(events_[i].data.u64);
+}
+mux_token Mux::get_active_token(int i) const {
+  assert(i < events_.size() && i >= 0);
+  return events_[i].data.u64;
 }
 int Mux::get_active_events(int i) const {
   assert(i < events_.size() && i >= 0);
   return events_[i].events;
 }
+MUX_COMPLETION Mux::get_active_completion(int i) const {
+  assert(i < events_.size() && i >= 0);
+  return uring_ ? completions_[i].kind : MC_READY;
+}
+int Mux::get_active_result(int i) const {
+  assert(i < completions_.size() && i >= 0);
+  return completions_[i].result;
+}
+const char* Mux::get_active_data(int i) const {
+  assert(i < completions_.size() && i >= 0);
+  return completions_[i].data;
+}
 }  // namespace MiniServer
\ No newline at end of file
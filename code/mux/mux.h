@@ -1,34 +1,90 @@
 #pragma once
 
 #include <assert.h>
+#include <stdint.h>
 #include <sys/epoll.h>
 #include <unistd.h>
 
+#include <atomic>
+#include <memory>
 #include <vector>
 
 #include "log/log.h"
+#include "mux/uring_poller.h"
 
 namespace MiniServer {
 
+/*
+注册 fd 时携带的 64 位标记,事件触发时原样返回(epoll 的 data.u64)
+对象指针按 8 字节对齐,低 3 位用来存放类型:
+  事件循环直接拿到处理该 fd 的对象,按类型分发,不需要再用 fd 查找
+*/
+typedef uint64_t mux_token;
+static const uint64_t MUX_TOKEN_TYPE_MASK = 7;
+
+inline mux_token make_mux_token(const void* ptr, unsigned type) {
+  assert((reinterpret_cast<uintptr_t>(ptr) & MUX_TOKEN_TYPE_MASK) == 0);
+  assert(type <= MUX_TOKEN_TYPE_MASK);
+  return reinterpret_cast<uintptr_t>(ptr) | type;
+}
+inline unsigned get_token_type(mux_token token) {
+  return static_cast<unsigned>(token & MUX_TOKEN_TYPE_MASK);
+}
+template <class T>
+inline T* get_token_ptr(mux_token token) {
+  return reinterpret_cast<T*>(token & ~MUX_TOKEN_TYPE_MASK);
+}
+
+// 多路复用的实现方式
+enum MUX_BACKEND {
+  MUX_EPOLL,
+  // 内核不支持 io_uring 时自动退回 epoll
+  MUX_URING,
+};
+
 class Mux {
  public:
-  explicit Mux(int max_event = 512);
+  explicit Mux(int max_event = 512, MUX_BACKEND backend = MUX_EPOLL);
   ~Mux();
 
+  // 不带标记时,事件触发后用 get_active_fd 取回 fd
   bool add_fd(int fd, uint32_t events);
   bool mod_fd(int fd, uint32_t events);
+  // 带标记时,事件触发后用 get_active_token 取回标记(mod_fd 需要再次传入)
+  bool add_fd(int fd, uint32_t events, mux_token token);
+  bool mod_fd(int fd, uint32_t events, mux_token token);
   bool del_fd(int fd);
 
+  // io_uring 的完成模式(见 UringPoller): 新连接的 fd 和收到的数据随事件一起返回
+  // 使用 epoll 或内核不支持时返回 false,调用者仍使用就绪通知
+  bool has_completion() const { return uring_ && uring_->has_completion(); }
+  bool add_accept(int fd, mux_token token);
+  bool add_recv(int fd, mux_token token);
+
   int wait(int timeout = -1);
   int get_active_fd(int i) const;
+  mux_token get_active_token(int i) const;
   int get_active_events(int i) const;
+  // 完成事件的类型、结果和 recv 的数据(下一次 wait 之前有效); 就绪通知为 MC_READY
+  MUX_COMPLETION get_active_completion(int i) const;
+  int get_active_result(int i) const;
+  const char* get_active_data(int i) const;
+
+  // 实际使用的实现
+  MUX_BACKEND get_backend() const { return uring_ ? MUX_URING : MUX_EPOLL; }
+  // 累计的系统调用次数(epoll_ctl/epoll_wait 或 io_uring_enter)
+  uint64_t get_syscall_count() const;
 
  private:
   int mux_fd_;
+  std::unique_ptr<UringPoller> uring_;
+  std::atomic<uint64_t> syscall_count_;
 
   // 当前触发事件的信号源数量
   int events_count_;
   std::vector<struct epoll_event> events_;
+  // 只有 io_uring 使用
+  std::vector<MuxCompletion> completions_;
 };
 
 }  // namespace MiniServer
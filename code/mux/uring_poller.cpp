@@ -0,0 +1,573 @@
+#include "uring_poller.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "log/log.h"
+
+const static char LOG_TAG[] = "uring";
+
+namespace MiniServer {
+
+// POLL_REMOVE/ASYNC_CANCEL 请求自身的完成事件,直接丢弃
+static const uint64_t REMOVE_USER_DATA = 1ULL << 63;
+// user_data: 最高位之后 2 位为操作类型, 29 位代数, 低 32 位为 fd
+static const uint32_t GENERATION_MASK = 0x1fffffff;
+
+static inline uint64_t make_user_data(int fd, uint32_t generation,
+                                      MUX_COMPLETION op = MC_READY) {
+  return (static_cast<uint64_t>(op) << 61) |
+         (static_cast<uint64_t>(generation & GENERATION_MASK) << 32) |
+         static_cast<uint32_t>(fd);
+}
+
+UringPoller::UringPoller(unsigned entries)
+    : ring_fd_(-1),
+      ring_ptr_(MAP_FAILED),
+      ring_size_(0),
+      sqes_(static_cast<io_uring_sqe*>(MAP_FAILED)),
+      sqes_size_(0),
+      sq_local_tail_(0),
+      buf_ring_(nullptr),
+      bufs_(nullptr),
+      buf_tail_(0),
+      recv_multishot_(true),
+      syscall_count_(0) {
+#ifdef IORING_FEAT_EXT_ARG
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  int ring_fd = syscall(__NR_io_uring_setup, entries, &params);
+  if (ring_fd < 0) {
+    LOG_WARN("[%s] io_uring_setup error with errno:%d", LOG_TAG, errno);
+    return;
+  }
+  // 需要: 单次 mmap 映射两个队列, 带超时的等待, 完成队列满时不丢事件
+  uint32_t need =
+      IORING_FEAT_SINGLE_MMAP | IORING_FEAT_EXT_ARG | IORING_FEAT_NODROP;
+  if ((params.features & need) != need) {
+    LOG_WARN("[%s] io_uring features[0x%x] not supported!", LOG_TAG,
+             params.features);
+    close(ring_fd);
+    return;
+  }
+
+  size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  size_t cq_size =
+      params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  ring_size_ = sq_size > cq_size ? sq_size : cq_size;
+  ring_ptr_ = mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+  sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+  if (ring_ptr_ == MAP_FAILED || sqes == MAP_FAILED) {
+    LOG_WARN("[%s] io_uring mmap error with errno:%d", LOG_TAG, errno);
+    if (ring_ptr_ != MAP_FAILED) {
+      munmap(ring_ptr_, ring_size_);
+      ring_ptr_ = MAP_FAILED;
+    }
+    if (sqes != MAP_FAILED) {
+      munmap(sqes, sqes_size_);
+    }
+    close(ring_fd);
+    return;
+  }
+  sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+  char* ring = static_cast<char*>(ring_ptr_);
+  sq_head_ = reinterpret_cast<unsigned*>(ring + params.sq_off.head);
+  sq_tail_ = reinterpret_cast<unsigned*>(ring + params.sq_off.tail);
+  sq_mask_ = *reinterpret_cast<unsigned*>(ring + params.sq_off.ring_mask);
+  sq_entries_ = params.sq_entries;
+  sq_local_tail_ = *sq_tail_;
+  // 提交队列的下标数组固定为一一对应,之后按顺序使用 sqe
+  unsigned* sq_array = reinterpret_cast<unsigned*>(ring + params.sq_off.array);
+  for (unsigned i = 0; i < sq_entries_; i++) {
+    sq_array[i] = i;
+  }
+
+  cq_head_ = reinterpret_cast<unsigned*>(ring + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<unsigned*>(ring + params.cq_off.tail);
+  cq_mask_ = *reinterpret_cast<unsigned*>(ring + params.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<io_uring_cqe*>(ring + params.cq_off.cqes);
+
+  ring_fd_ = ring_fd;
+  setup_buf_ring_();
+#else
+  LOG_WARN("[%s] io_uring headers are too old!", LOG_TAG);
+#endif
+}
+
+UringPoller::~UringPoller() {
+  if (sqes_ != MAP_FAILED) {
+    munmap(sqes_, sqes_size_);
+  }
+  if (ring_ptr_ != MAP_FAILED) {
+    munmap(ring_ptr_, ring_size_);
+  }
+  if (ring_fd_ >= 0) {
+    close(ring_fd_);
+  }
+  // 关闭 io_uring 后内核不再使用 buffer ring
+  if (buf_ring_ != nullptr) {
+    munmap(buf_ring_, BUF_RING_ENTRIES * sizeof(io_uring_buf));
+  }
+  if (bufs_ != nullptr) {
+    munmap(bufs_, BUF_RING_ENTRIES * BUF_SIZE);
+  }
+}
+
+void UringPoller::setup_buf_ring_() {
+#ifdef IORING_RECV_MULTISHOT
+  // buffer ring 需要按页对齐
+  size_t ring_bytes = BUF_RING_ENTRIES * sizeof(io_uring_buf);
+  void* ring = mmap(nullptr, ring_bytes, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  void* bufs = mmap(nullptr, BUF_RING_ENTRIES * BUF_SIZE,
+                    PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  io_uring_buf_reg reg;
+  memset(&reg, 0, sizeof(reg));
+  reg.ring_addr = reinterpret_cast<uint64_t>(ring);
+  reg.ring_entries = BUF_RING_ENTRIES;
+  reg.bgid = BUF_GROUP;
+  if (ring == MAP_FAILED || bufs == MAP_FAILED ||
+      syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_PBUF_RING,
+              &reg, 1) < 0) {
+    // 内核早于 5.19, 只使用就绪通知
+    LOG_WARN("[%s] Register buffer ring error with errno:%d", LOG_TAG, errno);
+    if (ring != MAP_FAILED) {
+      munmap(ring, ring_bytes);
+    }
+    if (bufs != MAP_FAILED) {
+      munmap(bufs, BUF_RING_ENTRIES * BUF_SIZE);
+    }
+    return;
+  }
+  buf_ring_ = static_cast<io_uring_buf_ring*>(ring);
+  bufs_ = static_cast<char*>(bufs);
+  for (unsigned i = 0; i < BUF_RING_ENTRIES; i++) {
+    used_bufs_.push_back(static_cast<uint16_t>(i));
+  }
+  recycle_bufs_();
+#endif
+}
+
+void UringPoller::recycle_bufs_() {
+#ifdef IORING_RECV_MULTISHOT
+  if (used_bufs_.empty()) {
+    return;
+  }
+  // 头文件中的 bufs 是柔性数组,在 C++ 中偏移不为 0,直接按数组访问整个 ring
+  io_uring_buf* bufs = reinterpret_cast<io_uring_buf*>(buf_ring_);
+  for (uint16_t bid : used_bufs_) {
+    io_uring_buf* buf = &bufs[buf_tail_ & (BUF_RING_ENTRIES - 1)];
+    buf->addr = reinterpret_cast<uint64_t>(bufs_ + bid * BUF_SIZE);
+    buf->len = BUF_SIZE;
+    buf->bid = bid;
+    buf_tail_++;
+  }
+  // 写完缓冲区信息后再发布队尾
+  __atomic_store_n(&buf_ring_->tail, buf_tail_, __ATOMIC_RELEASE);
+  used_bufs_.clear();
+#endif
+}
+
+bool UringPoller::add_fd(int fd, uint32_t events, uint64_t token) {
+  if (fd < 0) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> locker(mtx_);
+  if (static_cast<size_t>(fd) >= fd_states_.size()) {
+    fd_states_.resize(fd + 1);
+  }
+  FdState& state = fd_states_[fd];
+  if (state.active) {
+    // 与 epoll_ctl 一致
+    errno = EEXIST;
+    return false;
+  }
+  state.active = true;
+  state.token = token;
+  state.events = events;
+  state.generation++;
+  return arm_(fd) && submit_if_needed_();
+}
+
+bool UringPoller::mod_fd(int fd, uint32_t events, uint64_t token) {
+  if (fd < 0) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> locker(mtx_);
+  if (static_cast<size_t>(fd) >= fd_states_.size() ||
+      !fd_states_[fd].active) {
+    errno = ENOENT;
+    return false;
+  }
+  FdState& state = fd_states_[fd];
+  // 单次 poll 触发后已经不在内核中,只有仍在等待时才需要先取消
+  if (state.armed && !disarm_(fd)) {
+    return false;
+  }
+  state.token = token;
+  state.events = events;
+  state.generation++;
+  return arm_(fd) && submit_if_needed_();
+}
+
+bool UringPoller::del_fd(int fd) {
+  if (fd < 0) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> locker(mtx_);
+  if (static_cast<size_t>(fd) >= fd_states_.size() ||
+      !fd_states_[fd].active) {
+    errno = ENOENT;
+    return false;
+  }
+  FdState& state = fd_states_[fd];
+  if (state.armed && !disarm_(fd)) {
+    return false;
+  }
+  // 内核中的 recv 持有 socket 的引用, 不取消的话关闭 fd 后连接也不会断开
+  if (state.op_armed && !cancel_op_(fd)) {
+    return false;
+  }
+  state.active = false;
+  state.op = MC_READY;
+  // 丢弃已经在完成队列中的旧事件
+  state.generation++;
+  state.op_generation++;
+  return submit_if_needed_();
+}
+
+bool UringPoller::add_accept(int fd, uint64_t token) {
+  if (fd < 0 || !has_completion()) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> locker(mtx_);
+  if (static_cast<size_t>(fd) >= fd_states_.size()) {
+    fd_states_.resize(fd + 1);
+  }
+  FdState& state = fd_states_[fd];
+  if (state.active) {
+    errno = EEXIST;
+    return false;
+  }
+  state.active = true;
+  state.token = token;
+  state.events = 0;
+  state.op = MC_ACCEPT;
+  return arm_op_(fd) && submit_if_needed_();
+}
+
+bool UringPoller::add_recv(int fd, uint64_t token) {
+  if (fd < 0 || !has_completion()) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> locker(mtx_);
+  if (static_cast<size_t>(fd) >= fd_states_.size()) {
+    fd_states_.resize(fd + 1);
+  }
+  FdState& state = fd_states_[fd];
+  if (state.active) {
+    errno = EEXIST;
+    return false;
+  }
+  state.active = true;
+  state.token = token;
+  state.events = 0;
+  state.op = MC_RECV;
+  return arm_op_(fd) && submit_if_needed_();
+}
+
+int UringPoller::wait(struct epoll_event* events, MuxCompletion* completions,
+                      int max_events, int timeout) {
+  while (true) {
+    // 提交延迟的修改,同时等待完成事件
+    unsigned to_submit = 0;
+    {
+      std::lock_guard<std::mutex> locker(mtx_);
+      wait_thread_ = std::this_thread::get_id();
+      // 调用者已经处理完上一次返回的数据
+      recycle_bufs_();
+      to_submit = sq_local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    }
+    unsigned ready = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE) - *cq_head_;
+    unsigned min_complete = (ready == 0 && timeout != 0) ? 1 : 0;
+    int ret = 0;
+    if (to_submit > 0 || min_complete > 0) {
+#ifdef IORING_FEAT_EXT_ARG
+      __kernel_timespec ts;
+      io_uring_getevents_arg arg;
+      memset(&arg, 0, sizeof(arg));
+      unsigned flags = IORING_ENTER_GETEVENTS;
+      if (timeout > 0 && min_complete > 0) {
+        ts.tv_sec = timeout / 1000;
+        ts.tv_nsec = (timeout % 1000) * 1000000LL;
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+        flags |= IORING_ENTER_EXT_ARG;
+        ret = enter_(to_submit, min_complete, flags, &arg, sizeof(arg));
+      } else {
+        ret = enter_(to_submit, min_complete, flags, nullptr, 0);
+      }
+#endif
+    }
+    if (ret < 0 && errno != ETIME) {
+      if (errno != EINTR) {
+        LOG_ERROR("[%s] io_uring_enter error with errno:%d", LOG_TAG, errno);
+      }
+      return -1;
+    }
+
+    // 收割完成事件,超过 max_events 的留到下一次
+    int count = 0;
+    unsigned reaped = 0;
+    {
+      std::lock_guard<std::mutex> locker(mtx_);
+      unsigned head = *cq_head_;
+      unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+      while (head != tail && count < max_events) {
+        if (handle_cqe_(&cqes_[head & cq_mask_], &events[count],
+                        &completions[count])) {
+          count++;
+        }
+        head++;
+        reaped++;
+      }
+      __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    }
+
+    // 收到的都是需要丢弃的旧事件时继续等待; 超时则直接返回
+    if (count > 0 || reaped == 0 || timeout == 0) {
+      return count;
+    }
+  }
+}
+
+io_uring_sqe* UringPoller::get_sqe_() {
+  unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+  if (sq_local_tail_ - head >= sq_entries_) {
+    // 提交队列已满,不再等待 wait 统一提交
+    submit_();
+    head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    if (sq_local_tail_ - head >= sq_entries_) {
+      LOG_ERROR("[%s] io_uring submission queue is full!", LOG_TAG);
+      return nullptr;
+    }
+  }
+  io_uring_sqe* sqe = &sqes_[sq_local_tail_ & sq_mask_];
+  memset(sqe, 0, sizeof(*sqe));
+  return sqe;
+}
+
+bool UringPoller::arm_(int fd) {
+  io_uring_sqe* sqe = get_sqe_();
+  if (sqe == nullptr) {
+    return false;
+  }
+  FdState& state = fd_states_[fd];
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = fd;
+  sqe->poll32_events = state.events & ~EPOLLONESHOT;
+  if (!(state.events & EPOLLONESHOT)) {
+    sqe->len = IORING_POLL_ADD_MULTI;
+  }
+  sqe->user_data = make_user_data(fd, state.generation);
+  __atomic_store_n(sq_tail_, ++sq_local_tail_, __ATOMIC_RELEASE);
+  state.armed = true;
+  return true;
+}
+
+bool UringPoller::disarm_(int fd) {
+  io_uring_sqe* sqe = get_sqe_();
+  if (sqe == nullptr) {
+    return false;
+  }
+  FdState& state = fd_states_[fd];
+  sqe->opcode = IORING_OP_POLL_REMOVE;
+  sqe->fd = -1;
+  sqe->addr = make_user_data(fd, state.generation);
+  sqe->user_data = REMOVE_USER_DATA;
+  __atomic_store_n(sq_tail_, ++sq_local_tail_, __ATOMIC_RELEASE);
+  state.armed = false;
+  return true;
+}
+
+bool UringPoller::arm_op_(int fd) {
+#ifdef IORING_RECV_MULTISHOT
+  io_uring_sqe* sqe = get_sqe_();
+  if (sqe == nullptr) {
+    return false;
+  }
+  FdState& state = fd_states_[fd];
+  sqe->fd = fd;
+  if (state.op == MC_ACCEPT) {
+    // 不需要对端地址,新连接由调用者设置为非阻塞
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+  } else {
+    // 由内核从 buffer ring 中选择缓冲区
+    sqe->opcode = IORING_OP_RECV;
+    sqe->ioprio = recv_multishot_ ? IORING_RECV_MULTISHOT : 0;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUF_GROUP;
+  }
+  sqe->user_data = make_user_data(fd, state.op_generation, state.op);
+  __atomic_store_n(sq_tail_, ++sq_local_tail_, __ATOMIC_RELEASE);
+  state.op_armed = true;
+  return true;
+#else
+  (void)fd;
+  return false;
+#endif
+}
+
+bool UringPoller::cancel_op_(int fd) {
+  io_uring_sqe* sqe = get_sqe_();
+  if (sqe == nullptr) {
+    return false;
+  }
+  FdState& state = fd_states_[fd];
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->fd = -1;
+  sqe->addr = make_user_data(fd, state.op_generation, state.op);
+  sqe->user_data = REMOVE_USER_DATA;
+  __atomic_store_n(sq_tail_, ++sq_local_tail_, __ATOMIC_RELEASE);
+  state.op_armed = false;
+  return true;
+}
+
+bool UringPoller::submit_() {
+  unsigned to_submit =
+      sq_local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+  if (to_submit == 0) {
+    return true;
+  }
+  if (enter_(to_submit, 0, 0, nullptr, 0) < 0) {
+    LOG_ERROR("[%s] io_uring submit error with errno:%d", LOG_TAG, errno);
+    return false;
+  }
+  return true;
+}
+
+bool UringPoller::submit_if_needed_() {
+  if (wait_thread_ == std::thread::id() ||
+      wait_thread_ == std::this_thread::get_id()) {
+    return true;
+  }
+  return submit_();
+}
+
+bool UringPoller::handle_cqe_(const io_uring_cqe* cqe,
+                              struct epoll_event* event,
+                              MuxCompletion* completion) {
+#ifdef IORING_RECV_MULTISHOT
+  if (cqe->flags & IORING_CQE_F_BUFFER) {
+    // 数据交给调用者,下一次 wait 时归还(丢弃的旧事件也一样)
+    used_bufs_.push_back(
+        static_cast<uint16_t>(cqe->flags >> IORING_CQE_BUFFER_SHIFT));
+  }
+#endif
+  if (cqe->user_data == REMOVE_USER_DATA) {
+    return false;
+  }
+  int fd = static_cast<int>(cqe->user_data & 0xffffffff);
+  uint32_t generation =
+      static_cast<uint32_t>(cqe->user_data >> 32) & GENERATION_MASK;
+  MUX_COMPLETION op = static_cast<MUX_COMPLETION>((cqe->user_data >> 61) & 3);
+  if (static_cast<size_t>(fd) >= fd_states_.size()) {
+    return false;
+  }
+  FdState& state = fd_states_[fd];
+  if (op != MC_READY) {
+    if (!state.active || state.op != op ||
+        (state.op_generation & GENERATION_MASK) != generation) {
+      return false;
+    }
+    event->data.u64 = state.token;
+    event->events = 0;
+    return handle_op_cqe_(cqe, state, completion);
+  }
+  if (!state.active || (state.generation & GENERATION_MASK) != generation) {
+    // 修改或删除之前的请求
+    return false;
+  }
+
+  completion->kind = MC_READY;
+  bool more = cqe->flags & IORING_CQE_F_MORE;
+  if (!more) {
+    state.armed = false;
+  }
+  event->data.u64 = state.token;
+  if (cqe->res < 0) {
+    LOG_WARN("[%s] Poll fd[%d] error:%d", LOG_TAG, fd, -cqe->res);
+    event->events = EPOLLERR;
+    return true;
+  }
+  event->events = static_cast<uint32_t>(cqe->res);
+  if (!more && !(state.events & EPOLLONESHOT)) {
+    // 内核提前结束了 multishot poll (如完成队列溢出),重新注册
+    arm_(fd);
+  }
+  return true;
+}
+
+bool UringPoller::handle_op_cqe_(const io_uring_cqe* cqe, FdState& state,
+                                 MuxCompletion* completion) {
+  bool more = cqe->flags & IORING_CQE_F_MORE;
+  if (!more) {
+    state.op_armed = false;
+  }
+  int fd = static_cast<int>(cqe->user_data & 0xffffffff);
+  completion->kind = state.op;
+  completion->result = cqe->res;
+  completion->data = nullptr;
+  if (state.op == MC_ACCEPT) {
+    if (!more) {
+      // 出错或内核提前结束时重新提交
+      arm_op_(fd);
+    }
+    return true;
+  }
+
+  if (cqe->res == -EINVAL && recv_multishot_) {
+    // 内核早于 6.0, 不支持 multishot recv
+    LOG_WARN("[%s] Multishot recv is not supported, use single recv.",
+             LOG_TAG);
+    recv_multishot_ = false;
+    arm_op_(fd);
+    return false;
+  }
+  if (cqe->res == -ENOBUFS) {
+    // 缓冲区都还在调用者手中,下一次 wait 归还后再接收
+    arm_op_(fd);
+    return false;
+  }
+  if (cqe->res > 0) {
+    completion->data =
+        bufs_ + (cqe->flags >> IORING_CQE_BUFFER_SHIFT) * BUF_SIZE;
+    if (!more) {
+      arm_op_(fd);
+    }
+  }
+  return true;
+}
+
+int UringPoller::enter_(unsigned to_submit, unsigned min_complete,
+                        unsigned flags, void* arg, size_t arg_size) {
+  syscall_count_.fetch_add(1, std::memory_order_relaxed);
+  return syscall(__NR_io_uring_enter, ring_fd_, to_submit, min_complete, flags,
+                 arg, arg_size);
+}
+
+}  // namespace MiniServer
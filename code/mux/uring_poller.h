@@ -0,0 +1,149 @@
+#pragma once
+
+#include <linux/io_uring.h>
+#include <sys/epoll.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+基于 io_uring 的就绪通知,对外行为与 epoll 一致,由 Mux 在运行时选择
+  1. 用 IORING_OP_POLL_ADD 代替 epoll_ctl: 带 EPOLLONESHOT 的 fd 使用单次 poll,
+     触发后需要 mod_fd 重新注册; 其他 fd 使用 multishot poll,注册一次持续通知
+  2. 等待线程自己发起的 add/mod/del 先写入提交队列,在下一次 wait 时和等待一起
+     通过一次 io_uring_enter 批量提交; 其他线程(线程池)的修改立即提交,
+     保证阻塞在 wait 中的循环能及时收到
+  3. user_data 中带有 fd 的代数,修改或删除后旧请求产生的完成事件会被丢弃
+  4. 完成模式(内核支持 provided buffer ring 时): 监听 socket 使用 multishot accept,
+     连接使用 multishot recv,内核从 buffer ring 中取缓冲区直接放入数据,
+     新连接的 fd 和收到的数据随完成事件一起返回,不再需要 accept/read 系统调用
+直接使用系统调用,不依赖 liburing
+*/
+namespace MiniServer {
+
+// wait 返回的事件类型
+enum MUX_COMPLETION {
+  // 就绪通知,与 epoll 的事件相同
+  MC_READY,
+  // multishot accept 完成: result 为新连接的 fd, 出错时为 -errno
+  MC_ACCEPT,
+  // multishot recv 完成: result 为收到的字节数, 0 表示对端关闭, 出错时为 -errno
+  // 数据在 data 中,下一次 wait 时缓冲区归还给内核
+  MC_RECV,
+};
+
+struct MuxCompletion {
+  MUX_COMPLETION kind;
+  int result;
+  const char* data;
+};
+
+class UringPoller {
+ public:
+  explicit UringPoller(unsigned entries);
+  ~UringPoller();
+  UringPoller(const UringPoller&) = delete;
+  UringPoller& operator=(const UringPoller&) = delete;
+
+  // 内核不支持或禁用了 io_uring 时创建失败
+  bool is_valid() const { return ring_fd_ >= 0; }
+
+  // token 在事件触发时写入 epoll_event 的 data.u64
+  bool add_fd(int fd, uint32_t events, uint64_t token);
+  bool mod_fd(int fd, uint32_t events, uint64_t token);
+  // 同时取消 add_accept/add_recv 的请求
+  bool del_fd(int fd);
+
+  // 完成模式可用: 已注册 buffer ring
+  bool has_completion() const { return buf_ring_ != nullptr; }
+  // 每接受一个新连接产生一个 MC_ACCEPT 事件, 内核结束 multishot 时自动重新提交
+  bool add_accept(int fd, uint64_t token);
+  // 每次收到数据产生一个 MC_RECV 事件, 对端关闭或出错后不再提交
+  // 之后仍可以用 mod_fd 等待其他事件(如 EPOLLOUT)
+  bool add_recv(int fd, uint64_t token);
+
+  // 与 epoll_wait 相同: 返回事件的数量,超时返回 0,出错返回 -1 并设置 errno
+  // completions 与 events 一一对应
+  int wait(struct epoll_event* events, MuxCompletion* completions,
+           int max_events, int timeout);
+
+  // 调用 io_uring_enter 的次数
+  uint64_t get_syscall_count() const { return syscall_count_; }
+
+ private:
+  struct FdState {
+    uint64_t token = 0;
+    uint32_t events = 0;
+    uint32_t generation = 0;
+    // 已 add_fd 且没有 del_fd
+    bool active = false;
+    // 内核中有该 fd 未完成的 poll 请求
+    bool armed = false;
+    // add_accept/add_recv 注册的操作, MC_READY 表示没有; 代数与 poll 分开计数
+    MUX_COMPLETION op = MC_READY;
+    uint32_t op_generation = 0;
+    bool op_armed = false;
+  };
+
+  // buffer ring 的缓冲区数量(2 的幂)和每个缓冲区的大小
+  static const unsigned BUF_RING_ENTRIES = 256;
+  static const unsigned BUF_SIZE = 4096;
+  static const uint16_t BUF_GROUP = 0;
+
+  // 以下函数都需要持有 mtx_
+  io_uring_sqe* get_sqe_();
+  bool arm_(int fd);
+  bool disarm_(int fd);
+  bool arm_op_(int fd);
+  bool cancel_op_(int fd);
+  // 注册 buffer ring, 失败时不使用完成模式
+  void setup_buf_ring_();
+  // 上一次 wait 交出的缓冲区归还给内核
+  void recycle_bufs_();
+  bool submit_();
+  // 等待线程中的修改延迟到下一次 wait 时提交
+  bool submit_if_needed_();
+  bool handle_cqe_(const io_uring_cqe* cqe, struct epoll_event* event,
+                   MuxCompletion* completion);
+  bool handle_op_cqe_(const io_uring_cqe* cqe, FdState& state,
+                      MuxCompletion* completion);
+
+  int enter_(unsigned to_submit, unsigned min_complete, unsigned flags,
+             void* arg, size_t arg_size);
+
+  int ring_fd_;
+  void* ring_ptr_;
+  size_t ring_size_;
+  io_uring_sqe* sqes_;
+  size_t sqes_size_;
+
+  unsigned* sq_head_;
+  unsigned* sq_tail_;
+  unsigned sq_mask_;
+  unsigned sq_entries_;
+  // 本地维护的队尾,写入 sqe 后再发布到 sq_tail_
+  unsigned sq_local_tail_;
+
+  unsigned* cq_head_;
+  unsigned* cq_tail_;
+  unsigned cq_mask_;
+  io_uring_cqe* cqes_;
+
+  struct io_uring_buf_ring* buf_ring_;
+  char* bufs_;
+  // 本地维护的 buffer ring 队尾
+  uint16_t buf_tail_;
+  std::vector<uint16_t> used_bufs_;
+  // 旧内核不支持 multishot recv 时每次收到数据后重新提交
+  bool recv_multishot_;
+
+  std::mutex mtx_;
+  std::vector<FdState> fd_states_;
+  // 调用 wait 的线程,还没有线程等待时为空
+  std::thread::id wait_thread_;
+  std::atomic<uint64_t> syscall_count_;
+};
+
+}  // namespace MiniServer
@@ -0,0 +1,54 @@
+#include "blocking_executor.h"
+
+namespace MiniServer {
+
+BlockingExecutor::BlockingExecutor(size_t thread_count)
+    : is_closed_(false), submit_count_(0), max_pending_(0), execute_count_(0) {
+  assert(thread_count > 0);
+  for (size_t i = 0; i < thread_count; i++) {
+    threads_.emplace_back([this] { run_(); });
+  }
+}
+
+BlockingExecutor::~BlockingExecutor() {
+  {
+    std::lock_guard<std::mutex> locker(mtx_);
+    is_closed_ = true;
+  }
+  cond_.notify_all();
+  for (auto& thread : threads_) {
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+}
+
+uint64_t BlockingExecutor::get_submit_count() const {
+  std::lock_guard<std::mutex> locker(mtx_);
+  return submit_count_;
+}
+
+size_t BlockingExecutor::get_max_pending() const {
+  std::lock_guard<std::mutex> locker(mtx_);
+  return max_pending_;
+}
+
+void BlockingExecutor::run_() {
+  std::unique_lock<std::mutex> locker(mtx_);
+  Task task;
+  while (true) {
+    if (tasks_.pop(task)) {
+      locker.unlock();
+      task();
+      task.reset();
+      execute_count_++;
+      locker.lock();
+    } else if (is_closed_) {
+      break;
+    } else {
+      cond_.wait(locker);
+    }
+  }
+}
+
+}  // namespace MiniServer
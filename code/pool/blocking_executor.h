@@ -0,0 +1,64 @@
+#pragma once
+
+#include <assert.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "pool/task.h"
+
+/*
+执行会阻塞的任务(如查询数据库的动态路由)的线程池
+  与处理普通请求的线程池分开,数据库慢或连接池耗尽时只有这里的线程在等待,
+  静态文件等不阻塞的请求不受影响
+  线程数一般与数据库连接池大小相同,多出的线程也只会阻塞在获取连接上
+析构时执行完已提交的任务再退出
+*/
+namespace MiniServer {
+
+class BlockingExecutor {
+ public:
+  explicit BlockingExecutor(size_t thread_count = 8);
+  ~BlockingExecutor();
+  BlockingExecutor(const BlockingExecutor&) = delete;
+  BlockingExecutor& operator=(const BlockingExecutor&) = delete;
+
+  // 完美转发
+  template <class F>
+  void AddTask(F&& task) {
+    {
+      std::lock_guard<std::mutex> locker(mtx_);
+      tasks_.push(Task(std::forward<F>(task)));
+      submit_count_++;
+      if (tasks_.size() > max_pending_) {
+        max_pending_ = tasks_.size();
+      }
+    }
+    cond_.notify_one();
+  }
+
+  size_t get_thread_count() const { return threads_.size(); }
+  // 已提交 / 已执行的任务数, 排队任务数的最大值
+  uint64_t get_submit_count() const;
+  uint64_t get_execute_count() const { return execute_count_; }
+  size_t get_max_pending() const;
+
+ private:
+  void run_();
+
+  std::vector<std::thread> threads_;
+  mutable std::mutex mtx_;
+  std::condition_variable cond_;
+  bool is_closed_;
+  TaskQueue tasks_;
+
+  uint64_t submit_count_;
+  size_t max_pending_;
+  std::atomic<uint64_t> execute_count_;
+};
+
+}  // namespace MiniServer
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+线程池中的任务对象,代替 std::function<void()>
+  只能移动,不能复制; 可调用对象不超过 INLINE_SIZE 字节时直接放在对象内部,不分配内存
+  std::function 只能内联 16 字节,而 std::bind(&Server::on_read_, this, loop, client,
+  generation) 有 48 字节,每个事件都要分配一次
+  超过大小的可调用对象仍然放到堆上
+*/
+namespace MiniServer {
+
+class Task {
+ public:
+  // 加上 ops_ 正好一个缓存行
+  static constexpr size_t INLINE_SIZE = 56;
+
+  Task() noexcept : ops_(nullptr) {}
+  template <class F, class D = typename std::decay<F>::type,
+            class = typename std::enable_if<!std::is_same<D, Task>::value>::type>
+  Task(F&& func) : ops_(nullptr) {
+    init_<D>(std::forward<F>(func), std::integral_constant<bool, fits_<D>()>());
+  }
+  Task(Task&& other) noexcept : ops_(nullptr) { move_from_(other); }
+  Task& operator=(Task&& other) noexcept {
+    if (this != &other) {
+      reset();
+      move_from_(other);
+    }
+    return *this;
+  }
+  Task(const Task&) = delete;
+  Task& operator=(const Task&) = delete;
+  ~Task() { reset(); }
+
+  void operator()() { ops_->call(storage_); }
+  explicit operator bool() const { return ops_ != nullptr; }
+
+  void reset() {
+    if (ops_ != nullptr) {
+      ops_->destroy(storage_);
+      ops_ = nullptr;
+    }
+  }
+
+  // F 是否可以不分配内存直接存放
+  template <class F>
+  static constexpr bool is_inline() {
+    return fits_<typename std::decay<F>::type>();
+  }
+
+ private:
+  struct Ops {
+    void (*call)(void* storage);
+    // 移动到 dst 并销毁 src
+    void (*move)(void* dst, void* src);
+    void (*destroy)(void* storage);
+  };
+
+  template <class D>
+  static constexpr bool fits_() {
+    return sizeof(D) <= INLINE_SIZE && alignof(D) <= alignof(max_align_t) &&
+           std::is_nothrow_move_constructible<D>::value;
+  }
+
+  // 内联存放
+  template <class D>
+  struct InlineOps {
+    static void call(void* s) { (*static_cast<D*>(s))(); }
+    static void move(void* dst, void* src) {
+      D* from = static_cast<D*>(src);
+      ::new (dst) D(std::move(*from));
+      from->~D();
+    }
+    static void destroy(void* s) { static_cast<D*>(s)->~D(); }
+    static const Ops ops;
+  };
+
+  // 堆上存放,storage_ 中只保存指针
+  template <class D>
+  struct HeapOps {
+    static D*& ptr(void* s) { return *static_cast<D**>(s); }
+    static void call(void* s) { (*ptr(s))(); }
+    static void move(void* dst, void* src) { ::new (dst) D*(ptr(src)); }
+    static void destroy(void* s) { delete ptr(s); }
+    static const Ops ops;
+  };
+
+  template <class D, class F>
+  void init_(F&& func, std::true_type) {
+    ::new (storage_) D(std::forward<F>(func));
+    ops_ = &InlineOps<D>::ops;
+  }
+  template <class D, class F>
+  void init_(F&& func, std::false_type) {
+    ::new (storage_) D*(new D(std::forward<F>(func)));
+    ops_ = &HeapOps<D>::ops;
+  }
+
+  void move_from_(Task& other) {
+    if (other.ops_ != nullptr) {
+      other.ops_->move(storage_, other.storage_);
+      ops_ = other.ops_;
+      other.ops_ = nullptr;
+    }
+  }
+
+  alignas(max_align_t) unsigned char storage_[INLINE_SIZE];
+  const Ops* ops_;
+};
+
+template <class D>
+const Task::Ops Task::InlineOps<D>::ops = {&InlineOps<D>::call,
+                                           &InlineOps<D>::move,
+                                           &InlineOps<D>::destroy};
+template <class D>
+const Task::Ops Task::HeapOps<D>::ops = {&HeapOps<D>::call, &HeapOps<D>::move,
+                                         &HeapOps<D>::destroy};
+
+/*
+环形队列,代替 std::queue(std::deque 每 512 字节一个节点,要反复分配释放)
+  满时容量翻倍,之后不再缩小,稳定后入队出队都不分配内存
+  不加锁,由线程池持锁访问; T 需要可以默认构造和移动
+*/
+template <class T>
+class RingQueue {
+ public:
+  explicit RingQueue(size_t capacity = 64) : head_(0), size_(0) {
+    size_t cap = 2;
+    while (cap < capacity) {
+      cap <<= 1;
+    }
+    ring_.resize(cap);
+  }
+
+  void push(T&& item) {
+    if (size_ == ring_.size()) {
+      grow_();
+    }
+    ring_[(head_ + size_) & (ring_.size() - 1)] = std::move(item);
+    size_++;
+  }
+  // 队列为空时返回 false
+  bool pop(T& item) {
+    if (size_ == 0) {
+      return false;
+    }
+    item = std::move(ring_[head_]);
+    head_ = (head_ + 1) & (ring_.size() - 1);
+    size_--;
+    return true;
+  }
+
+  // 队首元素,队列不能为空
+  T& front() { return ring_[head_]; }
+  bool empty() const { return size_ == 0; }
+  size_t size() const { return size_; }
+  size_t capacity() const { return ring_.size(); }
+
+ private:
+  void grow_() {
+    std::vector<T> ring(ring_.size() * 2);
+    for (size_t i = 0; i < size_; i++) {
+      ring[i] = std::move(ring_[(head_ + i) & (ring_.size() - 1)]);
+    }
+    ring_.swap(ring);
+    head_ = 0;
+  }
+
+  std::vector<T> ring_;
+  size_t head_;
+  size_t size_;
+};
+
+typedef RingQueue<Task> TaskQueue;
+
+}  // namespace MiniServer
@@ -0,0 +1,193 @@
+#include "thread_pool.h"
+
+namespace MiniServer {
+
+static ThreadPoolConfig fixed_config(size_t thread_count, size_t max_queue,
+                                     QUEUE_POLICY policy, int codel_target_ms,
+                                     int codel_interval_ms) {
+  ThreadPoolConfig config;
+  config.min_threads = thread_count;
+  config.max_threads = thread_count;
+  config.max_queue = max_queue;
+  config.policy = policy;
+  config.codel_target_ms = codel_target_ms;
+  config.codel_interval_ms = codel_interval_ms;
+  return config;
+}
+
+ThreadPool::ThreadPool(size_t threadCount, size_t max_queue,
+                       QUEUE_POLICY policy, int codel_target_ms,
+                       int codel_interval_ms)
+    : ThreadPool(fixed_config(threadCount, max_queue, policy, codel_target_ms,
+                              codel_interval_ms)) {}
+
+ThreadPool::ThreadPool(const ThreadPoolConfig& config)
+    : pool_(std::make_shared<Pool>()) {
+  assert(config.min_threads > 0 && config.max_threads >= config.min_threads);
+  pool_->config = config;
+  std::lock_guard<std::mutex> locker(pool_->mtx);
+  pool_->stats.thread_count = config.min_threads;
+  // 析构时 join 所有线程之后 Pool 才释放,线程中使用裸指针即可
+  Pool* pool = pool_.get();
+  for (size_t i = 0; i < config.min_threads; i++) {
+    pool_->threads.emplace_back([pool] { run_(pool); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  if (!static_cast<bool>(pool_)) {
+    return;
+  }
+  std::vector<std::thread> threads;
+  {
+    std::lock_guard<std::mutex> locker(pool_->mtx);
+    // 关闭后不会再增加线程,可以取出所有线程
+    pool_->isClosed = true;
+    threads.swap(pool_->threads);
+  }
+  pool_->cond.notify_all();
+  pool_->not_full.notify_all();
+  for (auto& thread : threads) {
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+}
+
+ThreadPoolStats ThreadPool::get_stats() const {
+  std::lock_guard<std::mutex> locker(pool_->mtx);
+  ThreadPoolStats stats = pool_->stats;
+  stats.queue_size = pool_->tasks.size();
+  return stats;
+}
+
+void ThreadPool::spawn_(Pool* pool) {
+  std::vector<std::thread> retired;
+  {
+    std::lock_guard<std::mutex> locker(pool->mtx);
+    // 取出已经空闲退出的线程,在锁外 join
+    for (std::thread::id id : pool->retired) {
+      for (size_t i = 0; i < pool->threads.size(); i++) {
+        if (pool->threads[i].get_id() == id) {
+          retired.push_back(std::move(pool->threads[i]));
+          pool->threads[i] = std::move(pool->threads.back());
+          pool->threads.pop_back();
+          break;
+        }
+      }
+    }
+    pool->retired.clear();
+
+    if (pool->isClosed) {
+      // 析构函数已经取走了所有线程,不能再增加
+      pool->stats.thread_count--;
+      pool->stats.grow_count--;
+    } else {
+      pool->threads.emplace_back([pool] { run_(pool); });
+    }
+  }
+  for (auto& thread : retired) {
+    thread.join();
+  }
+}
+
+void ThreadPool::run_(Pool* pool) {
+  std::unique_lock<std::mutex> locker(pool->mtx);
+  Entry entry;
+  while (true) {
+    if (pool->tasks.pop(entry)) {
+      if (pool->config.max_queue > 0) {
+        pool->not_full.notify_one();
+      }
+      int64_t now = now_us_();
+      int64_t wait = now - entry.enqueue_us;
+      if (pool->config.policy == QP_CODEL &&
+          pool->codel_overloaded(wait, now)) {
+        pool->stats.dropped++;
+        locker.unlock();
+        entry.drop();
+        locker.lock();
+        continue;
+      }
+      pool->stats.executed++;
+      pool->stats.wait_total_us += wait;
+      if (static_cast<uint64_t>(wait) > pool->stats.wait_max_us) {
+        pool->stats.wait_max_us = wait;
+      }
+      bool grow = pool->should_grow(wait);
+      locker.unlock();
+      if (grow) {
+        spawn_(pool);
+      }
+      entry.task();
+      // 在锁外析构,不延长临界区
+      entry.reset();
+      locker.lock();
+    } else if (pool->isClosed) {
+      break;
+    } else {
+      // 阻塞线程 并自动给locker解锁
+      pool->stats.idle_count++;
+      bool timeout = false;
+      if (pool->stats.thread_count > pool->config.min_threads) {
+        timeout = pool->cond.wait_for(locker, std::chrono::milliseconds(
+                                                  pool->config.idle_timeout_ms)) ==
+                  std::cv_status::timeout;
+      } else {
+        pool->cond.wait(locker);
+      }
+      pool->stats.idle_count--;
+      if (timeout && pool->tasks.empty() && !pool->isClosed &&
+          pool->stats.thread_count > pool->config.min_threads) {
+        // 空闲超时,多出的线程退出
+        pool->stats.thread_count--;
+        pool->stats.shrink_count++;
+        pool->retired.push_back(std::this_thread::get_id());
+        break;
+      }
+    }
+  }
+}
+
+bool ThreadPool::Pool::should_grow(int64_t wait_us) {
+  if (isClosed || stats.idle_count > 0 ||
+      stats.thread_count >= config.max_threads) {
+    return false;
+  }
+  int64_t grow_wait_us = static_cast<int64_t>(config.grow_wait_ms) * 1000;
+  int64_t now = now_us_();
+  if (wait_us < grow_wait_us || now - last_grow_us < grow_wait_us) {
+    return false;
+  }
+  last_grow_us = now;
+  stats.thread_count++;
+  stats.grow_count++;
+  return true;
+}
+
+bool ThreadPool::Pool::codel_overloaded(int64_t wait_us, int64_t now_us) {
+  int64_t target_us = static_cast<int64_t>(config.codel_target_ms) * 1000;
+  int64_t interval_us = static_cast<int64_t>(config.codel_interval_ms) * 1000;
+  if (now_us > interval_end_us + interval_us) {
+    // 空闲超过一个完整间隔,上一个间隔的统计已经过时
+    overloaded = false;
+    min_wait_us = wait_us;
+    interval_end_us = now_us + interval_us;
+  } else if (now_us > interval_end_us) {
+    overloaded = min_wait_us > target_us;
+    min_wait_us = wait_us;
+    interval_end_us = now_us + interval_us;
+  } else if (wait_us < min_wait_us) {
+    min_wait_us = wait_us;
+  }
+  bool drop = overloaded && wait_us > 2 * target_us;
+  if (tasks.empty()) {
+    // 队列排空,退出过载状态,下一批任务重新开始统计
+    overloaded = false;
+    min_wait_us = wait_us;
+    interval_end_us = now_us + interval_us;
+  }
+  return drop;
+}
+
+}  // namespace MiniServer
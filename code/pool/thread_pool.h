@@ -1,75 +1,197 @@
 #pragma once
 
 #include <assert.h>
+#include <stdint.h>
 
+#include <chrono>
 #include <condition_variable>
-#include <functional>
+#include <memory>
 #include <mutex>
-#include <queue>
 #include <thread>
+#include <vector>
+
+#include "pool/task.h"
 
 /*
 线程池中包含一个线程函数的队列、一个锁、一个条件变量
 初始化时新建n个线程，线程内部从队列中取出任务运行，若队列为空，则使用信号量阻塞线程，留待以后添加任务时随机唤醒线程
 一开始是没有资源（任务）的，使用条件变量阻塞线程比较合适
+队列可以设置上限,过载时按 QUEUE_POLICY 处理,被丢弃的任务会调用提交时给出的 on_drop
+线程数可以在 [min_threads, max_threads] 之间伸缩:
+  没有空闲线程且队首任务排队超过 grow_wait_ms 时增加一个线程
+  多于 min_threads 时,空闲超过 idle_timeout_ms 的线程退出
+  线程都不分离,退出的线程在下次增加线程或析构时 join
 */
 namespace MiniServer {
+
+// 任务队列过载时的处理方式
+enum QUEUE_POLICY {
+  // 队列满时阻塞提交任务的线程(事件循环),直到有空位
+  QP_BLOCK,
+  // 队列满时拒绝新任务
+  QP_REJECT,
+  // 按排队时间丢弃最早的任务(CoDel): 一个统计间隔内最短排队时间都超过目标时
+  // 认为过载,过载期间丢弃排队超过 2 倍目标的任务; 队列满时丢弃队首为新任务腾位置
+  QP_CODEL,
+};
+
+struct ThreadPoolConfig {
+  // 线程数范围,相等时线程数固定
+  size_t min_threads = 10;
+  size_t max_threads = 10;
+  // 队首任务排队超过该时间且没有空闲线程时增加线程,两次增加之间也至少间隔该时间
+  int grow_wait_ms = 10;
+  // 多出 min_threads 的线程空闲超过该时间后退出
+  int idle_timeout_ms = 60000;
+  // 队列上限, 0 不限制
+  size_t max_queue = 0;
+  QUEUE_POLICY policy = QP_BLOCK;
+  // QP_CODEL 的排队时间目标和统计间隔
+  int codel_target_ms = 5;
+  int codel_interval_ms = 100;
+};
+
+struct ThreadPoolStats {
+  // 进入队列 / 已执行 / 排队后被丢弃 / 提交时被拒绝的任务数
+  uint64_t queued = 0;
+  uint64_t executed = 0;
+  uint64_t dropped = 0;
+  uint64_t rejected = 0;
+  // 已执行任务的排队时间
+  uint64_t wait_total_us = 0;
+  uint64_t wait_max_us = 0;
+  // 当前队列长度
+  size_t queue_size = 0;
+  // 当前线程数 / 空闲线程数, 增加和退出线程的次数
+  size_t thread_count = 0;
+  size_t idle_count = 0;
+  uint64_t grow_count = 0;
+  uint64_t shrink_count = 0;
+};
+
 class ThreadPool {
  public:
-  explicit ThreadPool(size_t threadCount = 10)
-      : pool_(std::make_shared<Pool>()) {
-    assert(threadCount > 0);
-    for (size_t i = 0; i < threadCount; i++) {
-      std::thread([pool = pool_] {
-        std::unique_lock<std::mutex> locker(pool->mtx);
-        while (true) {
-          if (!pool->tasks.empty()) {
-            auto task = std::move(pool->tasks.front());
-            pool->tasks.pop();
-            locker.unlock();
-            task();
-            locker.lock();
-          } else if (pool->isClosed)
-            break;
-          else {
-            // 阻塞线程 并自动给locker解锁
-            pool->cond.wait(locker);
-          }
-        }
-      }).detach();
-    }
-  };
-  // 默认构造函数
-  ThreadPool() = default;
+  // 固定 threadCount 个线程, max_queue 为 0 时队列不限长度
+  explicit ThreadPool(size_t threadCount = 10, size_t max_queue = 0,
+                      QUEUE_POLICY policy = QP_BLOCK, int codel_target_ms = 5,
+                      int codel_interval_ms = 100);
+  explicit ThreadPool(const ThreadPoolConfig& config);
   ThreadPool(ThreadPool&&) = default;
-  ~ThreadPool() {
-    if (static_cast<bool>(pool_)) {
-      std::lock_guard<std::mutex> locker(pool_->mtx);
-      pool_->isClosed = true;
-    }
-    pool_->cond.notify_all();
-  }
+  // 执行完已提交的任务,等待所有线程退出
+  ~ThreadPool();
 
   // 完美转发
+  // 返回 false 表示任务被拒绝(QP_REJECT 且队列已满),此时已调用过 on_drop
   template <class F>
-  void AddTask(F&& task) {
+  bool AddTask(F&& task) {
+    return AddTask(std::forward<F>(task), Task());
+  }
+  template <class F, class D>
+  bool AddTask(F&& task, D&& on_drop) {
+    Entry entry;
+    entry.task = Task(std::forward<F>(task));
+    entry.on_drop = Task(std::forward<D>(on_drop));
+    // 为新任务腾出位置而丢弃的队首任务
+    Entry shed;
+    bool grow = false;
     {
-      std::lock_guard<std::mutex> locker(pool_->mtx);
-      pool_->tasks.emplace(std::forward<F>(task));
+      std::unique_lock<std::mutex> locker(pool_->mtx);
+      if (pool_->config.max_queue > 0 &&
+          pool_->tasks.size() >= pool_->config.max_queue) {
+        if (pool_->config.policy == QP_REJECT) {
+          pool_->stats.rejected++;
+          locker.unlock();
+          entry.drop();
+          return false;
+        } else if (pool_->config.policy == QP_CODEL) {
+          pool_->tasks.pop(shed);
+          pool_->stats.dropped++;
+        } else {
+          pool_->not_full.wait(locker, [this] {
+            return pool_->tasks.size() < pool_->config.max_queue ||
+                   pool_->isClosed;
+          });
+        }
+      }
+      entry.enqueue_us = now_us_();
+      pool_->tasks.push(std::move(entry));
+      pool_->stats.queued++;
+      // 工作线程都在执行耗时任务时不会出队,需要在提交时检查排队时间
+      grow = pool_->should_grow(now_us_() - pool_->tasks.front().enqueue_us);
     }
     pool_->cond.notify_one();
+    if (grow) {
+      spawn_(pool_.get());
+    }
+    shed.drop();
+    return true;
   }
 
+  ThreadPoolStats get_stats() const;
+
  private:
+  static int64_t now_us_() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  // 队列中的任务,记录入队时间用于统计排队时间
+  struct Entry {
+    Task task;
+    // 任务被丢弃或拒绝时调用,可以为空
+    Task on_drop;
+    int64_t enqueue_us = 0;
+
+    void drop() {
+      if (on_drop) {
+        on_drop();
+      }
+      reset();
+    }
+    void reset() {
+      task.reset();
+      on_drop.reset();
+    }
+  };
+
   // 将pool_z整个传给线程
   struct Pool {
     // 确保安全使用队列
     std::mutex mtx;
     // 用来唤醒线程
     std::condition_variable cond;
-    bool isClosed;
-    std::queue<std::function<void()>> tasks;
+    // QP_BLOCK 时唤醒等待空位的提交线程
+    std::condition_variable not_full;
+    bool isClosed = false;
+    // 环形队列,入队出队不分配内存
+    RingQueue<Entry> tasks;
+
+    ThreadPoolConfig config;
+    ThreadPoolStats stats;
+
+    // 所有未 join 的线程,空闲退出的线程 id 记录在 retired 中等待 join
+    std::vector<std::thread> threads;
+    std::vector<std::thread::id> retired;
+    // 最近一次增加线程的时间
+    int64_t last_grow_us = 0;
+
+    // CoDel 状态,持锁访问
+    int64_t interval_end_us = 0;
+    int64_t min_wait_us = 0;
+    bool overloaded = false;
+
+    // 持锁调用, 返回 true 时已计入线程数,由调用者在锁外创建线程
+    bool should_grow(int64_t wait_us);
+    // 每个统计间隔结束时根据间隔内的最短排队时间判断是否过载
+    // 队列排空或空闲超过一个间隔时退出过载状态
+    bool codel_overloaded(int64_t wait_us, int64_t now_us);
   };
+
+  // 创建一个工作线程(线程数已经计入),顺便 join 已经退出的线程
+  static void spawn_(Pool* pool);
+  static void run_(Pool* pool);
+
   std::shared_ptr<Pool> pool_;
 };
 }  // namespace MiniServer
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/*
+Chase-Lev 无锁双端队列(按 "Correct and Efficient Work-Stealing for Weak
+Memory Models" 中的 C11 版本实现)
+  只有所属线程可以 push/pop 底部(后进先出,缓存更热)
+  其他线程从顶部 steal(先进先出,偷走最早的任务)
+  满时由所属线程扩容,旧数组保留到析构时释放,正在 steal 的线程仍可安全读取
+T 需要是可以原子读写的平凡类型(一般为指针)
+*/
+namespace MiniServer {
+
+template <class T>
+class WorkStealDeque {
+ public:
+  explicit WorkStealDeque(size_t capacity = 256)
+      : top_(0), bottom_(0), array_(new Array(round_up_(capacity))) {
+    arrays_.emplace_back(array_.load(std::memory_order_relaxed));
+  }
+  WorkStealDeque(const WorkStealDeque&) = delete;
+  WorkStealDeque& operator=(const WorkStealDeque&) = delete;
+
+  // 只能由所属线程调用
+  void push(T item) {
+    int64_t b = bottom_.load(std::memory_order_relaxed);
+    int64_t t = top_.load(std::memory_order_acquire);
+    Array* a = array_.load(std::memory_order_relaxed);
+    if (b - t > static_cast<int64_t>(a->capacity) - 1) {
+      a = grow_(a, b, t);
+    }
+    a->put(b, item);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+  }
+
+  // 只能由所属线程调用,从底部取出最新的任务
+  bool pop(T& item) {
+    int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    Array* a = array_.load(std::memory_order_relaxed);
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top_.load(std::memory_order_relaxed);
+    if (t > b) {
+      // 队列为空
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return false;
+    }
+    item = a->get(b);
+    if (t == b) {
+      // 最后一个元素,与 steal 竞争
+      bool won = top_.compare_exchange_strong(
+          t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return won;
+    }
+    return true;
+  }
+
+  // 任意线程调用,从顶部偷走最早的任务; 竞争失败或为空时返回 false
+  bool steal(T& item) {
+    int64_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom_.load(std::memory_order_acquire);
+    if (t >= b) {
+      return false;
+    }
+    Array* a = array_.load(std::memory_order_acquire);
+    item = a->get(t);
+    return top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                        std::memory_order_relaxed);
+  }
+
+  // 近似值,只用于判断是否可能有任务
+  bool empty() const {
+    int64_t b = bottom_.load(std::memory_order_relaxed);
+    int64_t t = top_.load(std::memory_order_relaxed);
+    return b <= t;
+  }
+
+ private:
+  struct Array {
+    explicit Array(size_t cap)
+        : capacity(cap), mask(cap - 1), items(new std::atomic<T>[cap]) {}
+    T get(int64_t i) const {
+      return items[i & mask].load(std::memory_order_relaxed);
+    }
+    void put(int64_t i, T item) {
+      items[i & mask].store(item, std::memory_order_relaxed);
+    }
+
+    const size_t capacity;
+    const size_t mask;
+    std::unique_ptr<std::atomic<T>[]> items;
+  };
+
+  static size_t round_up_(size_t n) {
+    size_t cap = 2;
+    while (cap < n) {
+      cap <<= 1;
+    }
+    return cap;
+  }
+
+  Array* grow_(Array* old, int64_t b, int64_t t) {
+    Array* a = new Array(old->capacity * 2);
+    for (int64_t i = t; i < b; i++) {
+      a->put(i, old->get(i));
+    }
+    arrays_.emplace_back(a);
+    array_.store(a, std::memory_order_release);
+    return a;
+  }
+
+  // 用填充把 top_ 和 bottom_ 分到不同的缓存行,避免 push/pop 与 steal 互相干扰
+  // (C++14 的 new 不保证 alignas 超过 16 的对齐)
+  std::atomic<int64_t> top_;
+  char pad_[64];
+  std::atomic<int64_t> bottom_;
+  std::atomic<Array*> array_;
+  // 所有分配过的数组,只由所属线程修改
+  std::vector<std::unique_ptr<Array>> arrays_;
+};
+
+}  // namespace MiniServer
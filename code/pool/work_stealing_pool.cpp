@@ -0,0 +1,156 @@
+#include "work_stealing_pool.h"
+
+namespace MiniServer {
+
+WorkStealingPool::WorkStealingPool(size_t thread_count)
+    : next_(0), queued_(0), sleepers_(0), is_closed_(false), steal_count_(0) {
+  assert(thread_count > 0);
+  for (size_t i = 0; i < thread_count; i++) {
+    workers_.emplace_back(new Worker());
+  }
+  // 所有队列建好后再启动线程,线程中会访问其他线程的队列
+  for (size_t i = 0; i < thread_count; i++) {
+    workers_[i]->thread = std::thread([this, i] { run_(i); });
+  }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+  {
+    std::lock_guard<std::mutex> locker(park_mtx_);
+    is_closed_ = true;
+  }
+  park_cond_.notify_all();
+  for (auto& worker : workers_) {
+    if (worker->thread.joinable()) {
+      worker->thread.join();
+    }
+  }
+}
+
+void WorkStealingPool::submit_(task_type* task) {
+  Context& context = context_();
+  if (context.pool == this) {
+    // 工作线程中提交,放入自己的队列
+    workers_[context.index]->deque.push(task);
+  } else {
+    Worker& worker = *workers_[next_.fetch_add(1, std::memory_order_relaxed) %
+                               workers_.size()];
+    std::lock_guard<std::mutex> locker(worker.inbox_mtx);
+    worker.inbox.push_back(task);
+  }
+  queued_.fetch_add(1, std::memory_order_seq_cst);
+  unpark_();
+}
+
+void WorkStealingPool::run_(size_t index) {
+  Context& context = context_();
+  context.pool = this;
+  context.index = index;
+
+  while (true) {
+    task_type* task = take_(index);
+    if (task == nullptr && queued_.load() > 0) {
+      // 还有任务,但无锁的尝试都失败了(偷取时 CAS 竞争、收件箱正被其他线程持有),
+      // 此时 park_ 不会休眠; 阻塞地再检查一遍收件箱,仍然没有时让出 CPU,避免空转
+      task = steal_inbox_(index, true);
+      if (task == nullptr) {
+        std::this_thread::yield();
+        continue;
+      }
+    }
+    if (task != nullptr) {
+      queued_.fetch_sub(1, std::memory_order_relaxed);
+      (*task)();
+      delete task;
+      continue;
+    }
+    // 关闭时执行完所有任务再退出
+    if (is_closed_ && queued_.load() == 0) {
+      break;
+    }
+    park_();
+  }
+}
+
+WorkStealingPool::task_type* WorkStealingPool::take_(size_t index) {
+  task_type* task = nullptr;
+  if (workers_[index]->deque.pop(task)) {
+    return task;
+  }
+  task = take_inbox_(index);
+  if (task != nullptr) {
+    return task;
+  }
+  return steal_(index);
+}
+
+WorkStealingPool::task_type* WorkStealingPool::take_inbox_(size_t index) {
+  Worker& worker = *workers_[index];
+  std::vector<task_type*> inbox;
+  {
+    std::lock_guard<std::mutex> locker(worker.inbox_mtx);
+    if (worker.inbox.empty()) {
+      return nullptr;
+    }
+    inbox.swap(worker.inbox);
+  }
+  // 第一个直接执行,其余放入自己的队列,空闲的线程可以偷走
+  for (size_t i = inbox.size() - 1; i > 0; i--) {
+    worker.deque.push(inbox[i]);
+  }
+  return inbox[0];
+}
+
+WorkStealingPool::task_type* WorkStealingPool::steal_(size_t index) {
+  size_t n = workers_.size();
+  task_type* task = nullptr;
+  for (size_t i = 1; i < n; i++) {
+    Worker& victim = *workers_[(index + i) % n];
+    if (victim.deque.steal(task)) {
+      steal_count_.fetch_add(1, std::memory_order_relaxed);
+      return task;
+    }
+  }
+  return steal_inbox_(index, false);
+}
+
+WorkStealingPool::task_type* WorkStealingPool::steal_inbox_(size_t index,
+                                                           bool block) {
+  size_t n = workers_.size();
+  // 其他线程正忙时,它收件箱中的任务也可以拿走
+  for (size_t i = 1; i < n; i++) {
+    Worker& victim = *workers_[(index + i) % n];
+    std::unique_lock<std::mutex> locker(victim.inbox_mtx, std::defer_lock);
+    if (block) {
+      locker.lock();
+    } else if (!locker.try_lock()) {
+      continue;
+    }
+    if (!victim.inbox.empty()) {
+      task_type* task = victim.inbox.front();
+      victim.inbox.erase(victim.inbox.begin());
+      steal_count_.fetch_add(1, std::memory_order_relaxed);
+      return task;
+    }
+  }
+  return nullptr;
+}
+
+void WorkStealingPool::park_() {
+  std::unique_lock<std::mutex> locker(park_mtx_);
+  sleepers_.fetch_add(1, std::memory_order_seq_cst);
+  // 声明休眠之后再检查一次,期间提交的任务一定能看到或者会被唤醒
+  while (queued_.load(std::memory_order_seq_cst) == 0 && !is_closed_) {
+    park_cond_.wait(locker);
+  }
+  sleepers_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void WorkStealingPool::unpark_() {
+  if (sleepers_.load(std::memory_order_seq_cst) > 0) {
+    std::lock_guard<std::mutex> locker(park_mtx_);
+    park_cond_.notify_one();
+  }
+}
+
+}  // namespace MiniServer
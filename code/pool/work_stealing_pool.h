@@ -0,0 +1,90 @@
+#pragma once
+
+#include <assert.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "pool/task.h"
+#include "pool/work_steal_deque.h"
+
+/*
+工作窃取线程池,接口与 ThreadPool 相同(AddTask)
+  每个工作线程有一个无锁双端队列: 自己从底部后进先出地取,空闲的线程从顶部先进先出地偷
+  工作线程中提交的任务直接放入自己的队列,不加锁
+  外部线程(事件循环)提交的任务轮流放入各工作线程的收件箱,每个收件箱一把锁,互不竞争
+空闲线程的休眠(park)与唤醒(unpark):
+  提交任务先增加 queued_ 再检查 sleepers_; 休眠前先增加 sleepers_ 再检查 queued_
+  两边都是 seq_cst,至少有一方能看到对方,不会丢失唤醒; 没有线程休眠时提交任务不需要加锁
+*/
+namespace MiniServer {
+
+class WorkStealingPool {
+ public:
+  // 与 ThreadPool 相同的任务对象,可调用对象放在 Task 内部,每个任务只分配一次
+  typedef Task task_type;
+
+  explicit WorkStealingPool(size_t thread_count = 8);
+  // 执行完已提交的任务后退出,等待所有线程结束
+  ~WorkStealingPool();
+  WorkStealingPool(const WorkStealingPool&) = delete;
+  WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+  // 完美转发
+  template <class F>
+  void AddTask(F&& task) {
+    submit_(new task_type(std::forward<F>(task)));
+  }
+
+  size_t get_thread_count() const { return workers_.size(); }
+  // 从其他线程偷到的任务数
+  uint64_t get_steal_count() const { return steal_count_; }
+
+ private:
+  struct Worker {
+    WorkStealDeque<task_type*> deque;
+    // 外部线程提交的任务
+    std::mutex inbox_mtx;
+    std::vector<task_type*> inbox;
+    std::thread thread;
+  };
+
+  // 当前线程所属的线程池和工作线程下标
+  struct Context {
+    WorkStealingPool* pool = nullptr;
+    size_t index = 0;
+  };
+  static Context& context_() {
+    static thread_local Context context;
+    return context;
+  }
+
+  void submit_(task_type* task);
+  void run_(size_t index);
+  // 依次从自己的队列、自己的收件箱、其他线程获取任务
+  task_type* take_(size_t index);
+  task_type* take_inbox_(size_t index);
+  task_type* steal_(size_t index);
+  // 从其他线程的收件箱取任务, block 为 false 时跳过正被持有的收件箱
+  task_type* steal_inbox_(size_t index, bool block);
+  void park_();
+  void unpark_();
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  // 外部提交时轮流选择的工作线程
+  std::atomic<size_t> next_;
+  // 已提交尚未被取走的任务数
+  std::atomic<int64_t> queued_;
+  std::atomic<int> sleepers_;
+  std::atomic<bool> is_closed_;
+  std::atomic<uint64_t> steal_count_;
+
+  std::mutex park_mtx_;
+  std::condition_variable park_cond_;
+};
+
+}  // namespace MiniServer
@@ -0,0 +1,210 @@
+#pragma once
+
+/*
+C++20 协程路由(编译器支持协程时才启用,否则只定义不出 MINISERVER_COROUTINE)
+  路由写成返回 RouteTask 的协程,在连接所属的事件循环线程中执行,不占用线程池的线程
+  需要等待时 co_await:
+    co_blocking(fn): 在阻塞线程池中执行 fn(如同步的数据库查询),完成后回到循环线程继续
+    co_sleep(ms):    使用循环的定时器等待 ms 毫秒
+  协程只在循环线程中恢复,路由中不需要加锁; 但协程体内不能直接调用阻塞的函数
+  co_return 的 bool 与普通动态路由的返回值含义相同
+*/
+#if defined(__has_include)
+#if __has_include(<coroutine>) && defined(__cpp_impl_coroutine)
+#define MINISERVER_COROUTINE 1
+#endif
+#endif
+
+#ifdef MINISERVER_COROUTINE
+
+#include <stdint.h>
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "buffer/buffer.h"
+#include "http/http_request.h"
+#include "pool/blocking_executor.h"
+#include "server/event_loop.h"
+
+namespace MiniServer {
+
+class HttpConn;
+struct CoRouteContext;
+
+class RouteTask {
+ public:
+  struct promise_type;
+  typedef std::coroutine_handle<promise_type> handle;
+
+  // 协程结束时调用 on_done, on_done 中可以销毁 RouteTask(协程已停在最终挂起点)
+  struct FinalAwaiter {
+    bool await_ready() noexcept { return false; }
+    void await_suspend(handle h) noexcept {
+      std::function<void(bool)> on_done = std::move(h.promise().on_done);
+      bool result = h.promise().result;
+      if (on_done) {
+        on_done(result);
+      }
+    }
+    void await_resume() noexcept {}
+  };
+
+  struct promise_type {
+    CoRouteContext* context = nullptr;
+    bool result = false;
+    std::function<void(bool)> on_done;
+
+    RouteTask get_return_object() {
+      return RouteTask(handle::from_promise(*this));
+    }
+    // 先挂起,由 start 设置好上下文后再开始执行
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void return_value(bool ok) { result = ok; }
+    // 路由抛出异常按失败处理
+    void unhandled_exception() { result = false; }
+  };
+
+  RouteTask() : handle_(nullptr) {}
+  RouteTask(RouteTask&& other) noexcept : handle_(other.handle_) {
+    other.handle_ = nullptr;
+  }
+  RouteTask& operator=(RouteTask&& other) noexcept {
+    if (this != &other) {
+      destroy_();
+      handle_ = other.handle_;
+      other.handle_ = nullptr;
+    }
+    return *this;
+  }
+  RouteTask(const RouteTask&) = delete;
+  RouteTask& operator=(const RouteTask&) = delete;
+  ~RouteTask() { destroy_(); }
+
+  bool valid() const { return static_cast<bool>(handle_); }
+
+  // 开始执行协程,结束时在恢复它的线程中调用 on_done(result)
+  void start(CoRouteContext* context, std::function<void(bool)> on_done) {
+    // on_done 可能在 resume 返回前销毁 RouteTask,之后不能再访问成员
+    handle h = handle_;
+    h.promise().context = context;
+    h.promise().on_done = std::move(on_done);
+    h.resume();
+  }
+
+ private:
+  explicit RouteTask(handle h) : handle_(h) {}
+  void destroy_() {
+    if (handle_) {
+      handle_.destroy();
+      handle_ = nullptr;
+    }
+  }
+
+  handle handle_;
+};
+
+// 一次协程路由调用的上下文,由 Server 创建,协程结束后在循环线程中释放
+struct CoRouteContext {
+  EventLoop* loop = nullptr;
+  BlockingExecutor* executor = nullptr;
+  // 请求的副本,连接在等待期间超时关闭也不影响协程
+  HttpRequest request;
+  // 响应体,协程结束后复制给连接
+  Buffer body;
+  RouteTask task;
+  HttpConn* client = nullptr;
+  uint32_t generation = 0;
+};
+
+typedef std::function<RouteTask(const HttpRequest&, Buffer&)> co_router_cb;
+
+namespace detail {
+
+// 保存 co_blocking 中函数的返回值
+template <class R>
+struct CoResult {
+  std::optional<R> value;
+  template <class F>
+  void run(F& fn) {
+    value.emplace(fn());
+  }
+  R get() { return std::move(*value); }
+};
+template <>
+struct CoResult<void> {
+  template <class F>
+  void run(F& fn) {
+    fn();
+  }
+  void get() {}
+};
+
+template <class F>
+class BlockingAwaiter {
+ public:
+  typedef std::invoke_result_t<F&> result_type;
+
+  explicit BlockingAwaiter(F&& fn) : fn_(std::move(fn)) {}
+
+  bool await_ready() { return false; }
+  // 等待者在协程帧中,恢复之前一直有效
+  void await_suspend(RouteTask::handle h) {
+    CoRouteContext* context = h.promise().context;
+    EventLoop* loop = context->loop;
+    context->executor->AddTask([this, h, loop] {
+      try {
+        result_.run(fn_);
+      } catch (...) {
+        error_ = std::current_exception();
+      }
+      loop->queue_in_loop([h] { h.resume(); });
+    });
+  }
+  result_type await_resume() {
+    if (error_) {
+      std::rethrow_exception(error_);
+    }
+    return result_.get();
+  }
+
+ private:
+  F fn_;
+  CoResult<result_type> result_;
+  std::exception_ptr error_;
+};
+
+class SleepAwaiter {
+ public:
+  explicit SleepAwaiter(int ms) : ms_(ms) {}
+
+  bool await_ready() { return ms_ <= 0; }
+  void await_suspend(RouteTask::handle h) {
+    h.promise().context->loop->run_after(ms_, [h] { h.resume(); });
+  }
+  void await_resume() {}
+
+ private:
+  int ms_;
+};
+
+}  // namespace detail
+
+// 在阻塞线程池中执行 fn, co_await 的结果是 fn 的返回值(fn 抛出的异常在协程中重新抛出)
+template <class F>
+detail::BlockingAwaiter<std::decay_t<F>> co_blocking(F&& fn) {
+  return detail::BlockingAwaiter<std::decay_t<F>>(
+      std::decay_t<F>(std::forward<F>(fn)));
+}
+
+// 等待 ms 毫秒,期间循环继续处理其他连接
+inline detail::SleepAwaiter co_sleep(int ms) { return detail::SleepAwaiter(ms); }
+
+}  // namespace MiniServer
+
+#endif  // MINISERVER_COROUTINE
@@ -0,0 +1,108 @@
+#include "event_loop.h"
+
+const static char LOG_TAG[] = "EVENT_LOOP";
+
+namespace MiniServer {
+
+EventLoop::EventLoop(int index, MUX_BACKEND backend, TIMER_TYPE timer_type,
+                     bool use_timer_fd)
+    : index_(index),
+      wakeup_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+      listen_fd_(-1),
+      conn_count_(0),
+      accept_count_(0),
+      thread_id_(std::thread::id()),
+      timer_(timer_type == TT_WHEEL ? static_cast<TimerBase*>(new TimeWheel())
+                                    : new Timer()),
+      mux_(new Mux(512, backend)),
+      next_timer_id_(USER_TIMER_BASE),
+      user_timer_count_(0) {
+  assert(wakeup_fd_ >= 0);
+  // eventfd 使用水平触发,没读完计数前会一直通知
+  if (!mux_->add_fd(wakeup_fd_, EPOLLIN, make_mux_token(this, FT_WAKEUP))) {
+    LOG_ERROR("[%s] Loop[%d] add wakeup fd to mux error!", LOG_TAG, index_);
+  }
+  if (use_timer_fd) {
+    timer_fd_.reset(new TimerFd());
+    if (!mux_->add_fd(timer_fd_->get_fd(), EPOLLIN,
+                      make_mux_token(this, FT_TIMER))) {
+      LOG_ERROR("[%s] Loop[%d] add timer fd to mux error!", LOG_TAG, index_);
+    }
+  }
+}
+
+EventLoop::~EventLoop() {
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  close(wakeup_fd_);
+  if (listen_fd_ >= 0) {
+    close(listen_fd_);
+  }
+}
+
+void EventLoop::queue_in_loop(functor&& cb) {
+  {
+    std::lock_guard<std::mutex> locker(pending_mtx_);
+    pending_functors_.emplace_back(std::move(cb));
+  }
+  wakeup();
+}
+
+void EventLoop::wakeup() {
+  uint64_t one = 1;
+  ssize_t n = ::write(wakeup_fd_, &one, sizeof(one));
+  if (n != sizeof(one)) {
+    LOG_WARN("[%s] Loop[%d] wakeup write %d bytes.", LOG_TAG, index_, n);
+  }
+}
+
+void EventLoop::handle_wakeup() {
+  uint64_t count = 0;
+  ::read(wakeup_fd_, &count, sizeof(count));
+
+  // 交换出来再执行,执行任务期间其他线程仍可继续投递
+  std::vector<functor> functors;
+  {
+    std::lock_guard<std::mutex> locker(pending_mtx_);
+    functors.swap(pending_functors_);
+  }
+  for (functor& cb : functors) {
+    cb();
+  }
+}
+
+void EventLoop::handle_timer() {
+  timer_fd_->read_expirations();
+
+  std::lock_guard<std::mutex> locker(timer_mtx_);
+  // 执行到期的定时器,再按剩下最早的定时器重新设置
+  timer_fd_->arm(timer_->get_next_timeout_period());
+}
+
+void EventLoop::run_after(int timeout_ms, functor&& cb) {
+  std::lock_guard<std::mutex> locker(timer_mtx_);
+  timer_id id;
+  if (free_timer_ids_.empty()) {
+    id = next_timer_id_++;
+  } else {
+    id = free_timer_ids_.back();
+    free_timer_ids_.pop_back();
+  }
+  user_timer_count_++;
+  // 定时器回调持有 timer_mtx_,真正的回调交给 queue_in_loop 在锁外执行
+  timer_->add_timer(id, timeout_ms, [this, id, cb]() mutable {
+    free_timer_ids_.push_back(id);
+    user_timer_count_--;
+    queue_in_loop(std::move(cb));
+  });
+  schedule_timer(timeout_ms);
+}
+
+void EventLoop::schedule_timer(int timeout_ms) {
+  if (timer_fd_) {
+    timer_fd_->arm_earlier(timeout_ms);
+  }
+}
+
+}  // namespace MiniServer
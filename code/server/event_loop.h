@@ -0,0 +1,112 @@
+#pragma once
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "log/log.h"
+#include "mux/mux.h"
+#include "timer/time_wheel.h"
+#include "timer/timer.h"
+#include "timer/timer_fd.h"
+
+/*
+one loop per thread:
+每个 EventLoop 拥有自己的 Mux 和 Timer,只在所属线程中操作它们(连接由 Server 按 fd 统一存放)
+其他线程通过 queue_in_loop 把任务交给所属线程,并写 eventfd 唤醒阻塞在 wait 中的循环
+*/
+namespace MiniServer {
+
+// 注册到 Mux 时的 fd 类型,与对象指针一起组成 mux_token
+enum FD_TYPE {
+  FT_CONN,    // HttpConn*
+  FT_LISTEN,  // EventLoop*, 循环持有的监听 socket
+  FT_WAKEUP,  // EventLoop*, 循环的 eventfd
+  FT_TIMER,   // EventLoop*, 驱动循环定时器的 timerfd
+};
+
+class EventLoop {
+ public:
+  typedef std::function<void()> functor;
+
+  // use_timer_fd: 用 timerfd 通知定时器到期,循环可以无限期阻塞在 wait 中
+  EventLoop(int index, MUX_BACKEND backend = MUX_EPOLL,
+            TIMER_TYPE timer_type = TT_HEAP, bool use_timer_fd = false);
+  ~EventLoop();
+
+  // 将任务交给循环所在线程执行(线程安全)
+  void queue_in_loop(functor&& cb);
+  // 唤醒阻塞在 wait 中的循环
+  void wakeup();
+  // 循环开始运行时在所属线程中调用,记录线程 id
+  void bind_thread() { thread_id_ = std::this_thread::get_id(); }
+  // 是否在循环所属线程中,循环开始运行前总是返回 false
+  bool is_in_loop_thread() const {
+    return thread_id_.load() == std::this_thread::get_id();
+  }
+  // 循环线程收到唤醒事件后调用: 清空 eventfd 计数并执行交付的任务
+  void handle_wakeup();
+  // 循环线程收到 timerfd 事件后调用: 执行到期的定时器并设置下一次到期时间
+  void handle_timer();
+  // 新增或提前了一个 timeout_ms 后到期的定时器,必要时提前 timerfd
+  // 需要持有定时器的锁,没有使用 timerfd 时什么也不做
+  void schedule_timer(int timeout_ms);
+  bool has_timer_fd() const { return timer_fd_ != nullptr; }
+  // timeout_ms 后在循环线程中执行 cb(只在循环线程中调用),如协程路由的 co_sleep
+  // 与连接定时器共用定时器, id 从 USER_TIMER_BASE 开始分配,不与 fd 冲突
+  void run_after(int timeout_ms, functor&& cb);
+  // 尚未到期的 run_after 定时器数,不使用 timerfd 时循环需要据此查询定时器
+  int get_user_timer_count() const { return user_timer_count_; }
+
+  int get_index() const { return index_; }
+  int get_wakeup_fd() const { return wakeup_fd_; }
+  int get_conn_count() const { return conn_count_; }
+  int get_listen_fd() const { return listen_fd_; }
+  uint64_t get_accept_count() const { return accept_count_; }
+
+  // 监听 socket 的所有权交给循环,析构时关闭
+  void set_listen_fd(int listen_fd) { listen_fd_ = listen_fd; }
+
+  Mux* get_mux() { return mux_.get(); }
+  TimerBase* get_timer() { return timer_.get(); }
+  std::mutex& get_timer_mtx() { return timer_mtx_; }
+
+  void inc_conn_count() { conn_count_++; }
+  void dec_conn_count() { conn_count_--; }
+  void inc_accept_count() { accept_count_++; }
+
+  std::thread thread_;
+
+ private:
+  int index_;
+  int wakeup_fd_;
+  // 不监听时为 -1
+  int listen_fd_;
+  std::atomic<int> conn_count_;
+  std::atomic<uint64_t> accept_count_;
+  // 运行循环的线程,主循环运行在调用 Server::start 的线程中
+  std::atomic<std::thread::id> thread_id_;
+
+  std::mutex timer_mtx_;
+  std::unique_ptr<TimerBase> timer_;
+  // 不使用 timerfd 时为空, 由 timer_mtx_ 保护
+  std::unique_ptr<TimerFd> timer_fd_;
+  std::unique_ptr<Mux> mux_;
+
+  static const timer_id USER_TIMER_BASE = 1 << 16;
+  // 由 timer_mtx_ 保护: 已释放可以复用的 id 和下一个新 id
+  std::vector<timer_id> free_timer_ids_;
+  timer_id next_timer_id_;
+  std::atomic<int> user_timer_count_;
+
+  std::mutex pending_mtx_;
+  std::vector<functor> pending_functors_;
+};
+
+}  // namespace MiniServer
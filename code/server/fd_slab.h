@@ -0,0 +1,78 @@
+#pragma once
+
+#include <assert.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+/*
+以 fd 为下标的对象池,代替 unordered_map<int, T>
+按页分配(每页 PAGE_SIZE 个对象),页表在构造时按 max_fd 一次分配好,之后不再扩容:
+  1. 查找只需要两次数组下标,不计算哈希
+  2. 页一旦分配就不会移动或释放,其他线程持有的对象指针一直有效
+读取页表不加锁,只有分配新页时加锁
+*/
+namespace MiniServer {
+
+template <class T>
+class FdSlab {
+ public:
+  static const size_t PAGE_SIZE = 256;
+
+  explicit FdSlab(size_t max_fd)
+      : max_fd_(max_fd),
+        page_count_((max_fd + PAGE_SIZE - 1) / PAGE_SIZE),
+        pages_(new std::atomic<T*>[page_count_]) {
+    for (size_t i = 0; i < page_count_; i++) {
+      pages_[i].store(nullptr, std::memory_order_relaxed);
+    }
+  }
+  ~FdSlab() {
+    for (size_t i = 0; i < page_count_; i++) {
+      delete[] pages_[i].load(std::memory_order_relaxed);
+    }
+  }
+  FdSlab(const FdSlab&) = delete;
+  FdSlab& operator=(const FdSlab&) = delete;
+
+  // 获取 fd 对应的对象,所在页不存在时分配; fd 超出范围返回 nullptr
+  T* get(int fd) {
+    if (fd < 0 || static_cast<size_t>(fd) >= max_fd_) {
+      return nullptr;
+    }
+    size_t index = fd / PAGE_SIZE;
+    T* page = pages_[index].load(std::memory_order_acquire);
+    if (page == nullptr) {
+      std::lock_guard<std::mutex> locker(mtx_);
+      page = pages_[index].load(std::memory_order_relaxed);
+      if (page == nullptr) {
+        page = new T[PAGE_SIZE];
+        pages_[index].store(page, std::memory_order_release);
+      }
+    }
+    return &page[fd % PAGE_SIZE];
+  }
+
+  // 只查找不分配,对象所在页不存在时返回 nullptr
+  T* find(int fd) const {
+    if (fd < 0 || static_cast<size_t>(fd) >= max_fd_) {
+      return nullptr;
+    }
+    T* page = pages_[fd / PAGE_SIZE].load(std::memory_order_acquire);
+    if (page == nullptr) {
+      return nullptr;
+    }
+    return &page[fd % PAGE_SIZE];
+  }
+
+  size_t get_max_fd() const { return max_fd_; }
+
+ private:
+  const size_t max_fd_;
+  const size_t page_count_;
+  std::unique_ptr<std::atomic<T*>[]> pages_;
+  std::mutex mtx_;
+};
+
+}  // namespace MiniServer
@@ -7,18 +7,38 @@ namespace MiniServer {
 std::function<void(int)> shutdown_handler;
 void signal_handler(int signal) { shutdown_handler(signal); }
 
+// 连接对象在 FdSlab 中地址固定,可以直接作为事件的标记
+static inline mux_token conn_token(HttpConn* client) {
+  return make_mux_token(client, FT_CONN);
+}
+
+#ifdef MINISERVER_COROUTINE
+std::unordered_map<string, co_router_cb> Server::co_routers_;
+#endif
+
+// 线程池过载时直接回复,不经过 HttpResponse
+static const char SERVICE_UNAVAILABLE[] =
+    "HTTP/1.1 503 Service Unavailable\r\n"
+    "Content-Length: 0\r\n"
+    "Retry-After: 1\r\n"
+    "Connection: close\r\n\r\n";
+
 Server::Server(int port, bool is_ET, int timeout_ms, bool linger_close,
                const char* src_dir, const char* sql_host, int sql_port,
                const char* sql_user, const char* sql_pwd,
                const char* sql_db_name, int pool_sql_conn_num,
-               int pool_thread_num, LOG_LEVEL log_level, int log_queue_size)
+               int pool_thread_num, LOG_LEVEL log_level, int log_queue_size,
+               const ServerConfig& config)
     : port_(port),
       linger_close_(linger_close),
       timeout_ms_(timeout_ms),
       is_close_(false),
-      timer_(new Timer()),
-      thread_pool_(new ThreadPool(pool_thread_num)),
-      mux_(new Mux()) {
+      config_(config),
+      completion_(false),
+      connections_(MAX_FD),
+      next_loop_(0),
+      inline_write_count_(0),
+      delayed_write_count_(0) {
   // 获取工作目录
   // 之前使用getcwd() 感觉传入目录便于修改
   // char src_dir[256] = {0};
@@ -34,6 +54,34 @@ Server::Server(int port, bool is_ET, int timeout_ms, bool linger_close,
 
   // 初始化服务器
   init_event_mode_(is_ET);
+  init_loops_();
+  if (sub_loops_.empty()) {
+    // 单循环模式下读写事件交给线程池处理
+    if (config_.work_stealing) {
+      steal_pool_.reset(new WorkStealingPool(pool_thread_num));
+    } else {
+      ThreadPoolConfig pool_config;
+      pool_config.max_threads = pool_thread_num;
+      pool_config.min_threads = pool_thread_num;
+      if (config_.pool_min_threads > 0 &&
+          config_.pool_min_threads < pool_thread_num) {
+        pool_config.min_threads = config_.pool_min_threads;
+      }
+      pool_config.grow_wait_ms = config_.pool_grow_wait_ms;
+      pool_config.idle_timeout_ms = config_.pool_idle_timeout_ms;
+      pool_config.max_queue = config_.pool_queue_size;
+      pool_config.policy = config_.pool_queue_policy;
+      pool_config.codel_target_ms = config_.codel_target_ms;
+      pool_config.codel_interval_ms = config_.codel_interval_ms;
+      thread_pool_.reset(new ThreadPool(pool_config));
+    }
+  }
+  // 阻塞路由的线程默认与数据库连接数相同,再多也只是等待连接
+  int blocking_thread_num = config_.blocking_thread_num > 0
+                                ? config_.blocking_thread_num
+                                : pool_sql_conn_num;
+  blocking_executor_.reset(
+      new BlockingExecutor(blocking_thread_num > 0 ? blocking_thread_num : 1));
   if (!init_socket_()) {
     is_close_ = true;
   }
@@ -42,7 +90,12 @@ Server::Server(int port, bool is_ET, int timeout_ms, bool linger_close,
   }
 
   // 初始化 Http 连接
-  HttpConn::global_config(true, src_dir_, 0);
+  HttpConn::global_config(true, src_dir_, 0, config_.keep_alive_max,
+                          config_.body_size_max);
+  // 按秒通告,不足 1 秒的部分向上取整,避免通告 timeout=0
+  HttpResponse::set_keep_alive(
+      config_.keep_alive_max,
+      std::max(1, (config_.keep_alive_timeout_ms + 999) / 1000));
 
   // LOG
   {
@@ -76,62 +129,210 @@ Server::Server(int port, bool is_ET, int timeout_ms, bool linger_close,
       LOG_INFO("[%s] Log level: %s", LOG_TAG, log_level_stirng.data());
       LOG_INFO("[%s] Src dir: %s", LOG_TAG, src_dir_.data());
       LOG_INFO("[%s] SQL connection pool size: %d, Thread pool size: %d",
-               LOG_TAG, pool_sql_conn_num, pool_thread_num);
+               LOG_TAG, pool_sql_conn_num,
+               sub_loops_.empty() ? pool_thread_num : 0);
+      LOG_INFO("[%s] Sub loop num: %d, Load balance: %s", LOG_TAG,
+               (int)sub_loops_.size(),
+               config_.load_balance == LB_LEAST_CONN ? "least conn"
+                                                     : "round robin");
+      LOG_INFO("[%s] Request scanner: %s", LOG_TAG,
+               HttpScanner::get_level_name(HttpScanner::get_level()));
     }
   }
 }
 
 Server::~Server() {
-  close(listen_fd_);
-  //
   is_close_ = true;
+  std::vector<uint64_t> accept_counts = get_accept_counts();
+  for (size_t i = 0; i < accept_counts.size(); i++) {
+    LOG_INFO("[%s] Listen shard[%d] accepted: %llu", LOG_TAG, (int)i,
+             (unsigned long long)accept_counts[i]);
+  }
+  if (thread_pool_) {
+    ThreadPoolStats stats = thread_pool_->get_stats();
+    LOG_INFO("[%s] Thread pool queued: %llu, executed: %llu, dropped: %llu, "
+             "rejected: %llu, avg wait: %lluus, max wait: %lluus",
+             LOG_TAG, (unsigned long long)stats.queued,
+             (unsigned long long)stats.executed,
+             (unsigned long long)stats.dropped,
+             (unsigned long long)stats.rejected,
+             (unsigned long long)(stats.executed > 0
+                                      ? stats.wait_total_us / stats.executed
+                                      : 0),
+             (unsigned long long)stats.wait_max_us);
+    LOG_INFO("[%s] Thread pool threads: %d, grown: %llu, retired: %llu",
+             LOG_TAG, (int)stats.thread_count,
+             (unsigned long long)stats.grow_count,
+             (unsigned long long)stats.shrink_count);
+  }
+  LOG_INFO("[%s] Blocking routes executed: %llu, max pending: %d", LOG_TAG,
+           (unsigned long long)blocking_executor_->get_execute_count(),
+           (int)blocking_executor_->get_max_pending());
+#ifdef MINISERVER_COROUTINE
+  LOG_INFO("[%s] Coroutine routes finished: %llu", LOG_TAG,
+           (unsigned long long)coroutine_count_.load());
+#endif
+  if (steal_pool_) {
+    LOG_INFO("[%s] Work-stealing pool stole %llu tasks", LOG_TAG,
+             (unsigned long long)steal_pool_->get_steal_count());
+  }
+  ChunkPoolStats chunk_stats = ChunkPool::get_instance()->get_stats();
+  LOG_INFO("[%s] Buffer chunks in use: %d, high water: %d (%d KB), "
+           "allocated: %d, acquired: %llu",
+           LOG_TAG, (int)chunk_stats.in_use, (int)chunk_stats.high_water,
+           (int)(chunk_stats.high_water * ChunkPool::CHUNK_SIZE / 1024),
+           (int)chunk_stats.allocated,
+           (unsigned long long)chunk_stats.acquire_count);
+  LOG_INFO("[%s] Keep-alive reused requests: %llu", LOG_TAG,
+           (unsigned long long)HttpConn::get_reuse_count());
+  uint64_t syscall_count = main_loop_->get_mux()->get_syscall_count();
+  for (auto& sub_loop : sub_loops_) {
+    syscall_count += sub_loop->get_mux()->get_syscall_count();
+  }
+  LOG_INFO("[%s] Mux syscalls: %llu", LOG_TAG,
+           (unsigned long long)syscall_count);
+  LOG_INFO("[%s] Responses written inline: %llu, delayed to EPOLLOUT: %llu",
+           LOG_TAG, (unsigned long long)inline_write_count_.load(),
+           (unsigned long long)delayed_write_count_.load());
+  // 先等线程池执行完剩余任务(其中可能提交阻塞任务),再等阻塞线程池
+  thread_pool_.reset();
+  steal_pool_.reset();
+  blocking_executor_.reset();
+#ifdef MINISERVER_COROUTINE
+  // 循环已经停止,交给循环恢复的协程和 co_sleep 的定时器都不会再执行
+  // 销毁协程帧和上下文,循环中留下的任务只持有句柄,随循环析构时不会再访问
+  if (!co_contexts_.empty()) {
+    LOG_INFO("[%s] Destroy %d unfinished coroutine routes.", LOG_TAG,
+             (int)co_contexts_.size());
+  }
+  for (CoRouteContext* context : co_contexts_) {
+    delete context;
+  }
+  co_contexts_.clear();
+#endif
   SQLConnPool::get_instance()->close();
   LOG_INFO("[%s] ========== Server stop ==========", LOG_TAG);
   LOG_INFO("[%s] Bye~", LOG_TAG)
 }
 
 void Server::start() {
-  // Timer中所存尚未到期的最小时间
-  int ttnt_ms = -1;
   if (!is_close_) {
     LOG_INFO("[%s] ========== Server start ==========", LOG_TAG);
   }
+  for (auto& sub_loop : sub_loops_) {
+    EventLoop* loop = sub_loop.get();
+    sub_loop->thread_ = std::thread([this, loop] { loop_(loop); });
+  }
+
+  loop_(main_loop_.get());
+
+  // 主循环退出后唤醒并等待子循环退出
+  is_close_ = true;
+  for (auto& sub_loop : sub_loops_) {
+    sub_loop->wakeup();
+    if (sub_loop->thread_.joinable()) {
+      sub_loop->thread_.join();
+    }
+  }
+}
+
+void Server::loop_(EventLoop* loop) {
+  // Timer中所存尚未到期的最小时间
+  int ttnt_ms = -1;
+  Mux* mux = loop->get_mux();
+  loop->bind_thread();
   while (!is_close_) {
-    if (timeout_ms_ > 0) {
-      // timeout_ms_ > 0 启用定时器
+    if ((has_conn_timer_() || loop->get_user_timer_count() > 0) &&
+        !loop->has_timer_fd()) {
+      // 连接的超时使用定时器, 使用 timerfd 时到期会作为事件返回
+      // 协程路由的 co_sleep 也使用定时器
       // get_next_timeout 函数内会执行 tick 释放已经到期的连接
-      lock_guard<mutex> time_lock(timer_mtx_);
-      ttnt_ms = timer_->get_next_timeout_period();
+      lock_guard<mutex> time_lock(loop->get_timer_mtx());
+      ttnt_ms = loop->get_timer()->get_next_timeout_period();
     }
-    int events_count_ = mux_->wait(ttnt_ms);
+    int events_count_ = mux->wait(ttnt_ms);
     for (int i = 0; i < events_count_; i++) {
-      int fd = mux_->get_active_fd(i);
-      uint32_t event = mux_->get_active_events(i);
-
-      LOG_DEBUG("[%s] FD:[%d] \t EVENT:[%d]", LOG_TAG, fd, event);
-
-      if (fd == listen_fd_) {
-        // 有新连接
-        deal_new_conn_();
-      } else if (event & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
-        // 连接断开
-        assert(connections_.count(fd) > 0);
-        LOG_DEBUG("[%s] Connection[%d] disconnect event triggered.", LOG_TAG,
-                  fd);
-        deal_close_conn_(&connections_[fd]);
-      } else if (event & EPOLLIN) {
-        // 收到数据
-        deal_read_conn_(&connections_[fd]);
-      } else if (event & EPOLLOUT) {
-        // 发送数据
-        deal_write_conn_(&connections_[fd]);
-      } else {
-        LOG_WARN("[%s] Unexpected event: %d!", LOG_TAG, event);
+      // 标记中带有处理对象的指针,按类型分发
+      mux_token token = mux->get_active_token(i);
+      uint32_t event = mux->get_active_events(i);
+
+      LOG_DEBUG("[%s] Loop[%d] TYPE:[%u] \t EVENT:[%d]", LOG_TAG,
+                loop->get_index(), get_token_type(token), event);
+
+      switch (get_token_type(token)) {
+        case FT_CONN:
+          if (mux->get_active_completion(i) == MC_RECV) {
+            deal_recv_conn_(loop, get_token_ptr<HttpConn>(token),
+                            mux->get_active_data(i),
+                            mux->get_active_result(i));
+          } else {
+            deal_conn_event_(loop, get_token_ptr<HttpConn>(token), event);
+          }
+          break;
+        case FT_LISTEN:
+          // 有新连接
+          if (mux->get_active_completion(i) == MC_ACCEPT) {
+            deal_accepted_(get_token_ptr<EventLoop>(token),
+                           mux->get_active_result(i));
+          } else {
+            deal_new_conn_(get_token_ptr<EventLoop>(token));
+          }
+          break;
+        case FT_WAKEUP:
+          // 其他线程交付的任务(如主循环分发的新连接)
+          get_token_ptr<EventLoop>(token)->handle_wakeup();
+          break;
+        case FT_TIMER:
+          // 定时器到期
+          get_token_ptr<EventLoop>(token)->handle_timer();
+          break;
+        default:
+          LOG_WARN("[%s] Unknown token type: %u!", LOG_TAG,
+                   get_token_type(token));
+          break;
       }
     }
   }
 }
 
+void Server::deal_conn_event_(EventLoop* loop, HttpConn* client,
+                              uint32_t event) {
+  if (event & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+    // 连接断开
+    LOG_DEBUG("[%s] Connection[%d] disconnect event triggered.", LOG_TAG,
+              client->get_fd());
+    deal_close_conn_(loop, client);
+  } else if (event & EPOLLIN) {
+    // 收到数据
+    deal_read_conn_(loop, client);
+  } else if (event & EPOLLOUT) {
+    // 发送数据
+    deal_write_conn_(loop, client);
+  } else {
+    LOG_WARN("[%s] Unexpected event: %d!", LOG_TAG, event);
+  }
+}
+
+ThreadPoolStats Server::get_pool_stats() const {
+  if (thread_pool_) {
+    return thread_pool_->get_stats();
+  }
+  return ThreadPoolStats();
+}
+
+std::vector<uint64_t> Server::get_accept_counts() const {
+  std::vector<uint64_t> counts;
+  if (main_loop_ && main_loop_->get_listen_fd() >= 0) {
+    counts.push_back(main_loop_->get_accept_count());
+  }
+  for (auto& sub_loop : sub_loops_) {
+    if (sub_loop->get_listen_fd() >= 0) {
+      counts.push_back(sub_loop->get_accept_count());
+    }
+  }
+  return counts;
+}
+
 bool Server::register_static_router(string& src, string& des) {
   return HttpResponse::register_static_router(src, des);
 }
@@ -152,15 +353,35 @@ bool Server::register_static_router(const char* src, const char* des) {
   return HttpResponse::register_static_router(src_, des_);
 }
 
-bool Server::register_dynamic_router(string& src, const router_cb& cb) {
-  return HttpResponse::register_dynamic_router(src, cb);
+bool Server::register_dynamic_router(string& src, const router_cb& cb,
+                                     ROUTER_MODE mode) {
+  return HttpResponse::register_dynamic_router(src, cb, mode);
 }
-bool Server::register_dynamic_router(const char* src, const router_cb& cb) {
+bool Server::register_dynamic_router(const char* src, const router_cb& cb,
+                                     ROUTER_MODE mode) {
   assert(src != nullptr);
   string src_(src);
-  return HttpResponse::register_dynamic_router(src_, cb);
+  return HttpResponse::register_dynamic_router(src_, cb, mode);
 }
 
+#ifdef MINISERVER_COROUTINE
+bool Server::register_coroutine_router(string& src, const co_router_cb& cb) {
+  if (co_routers_.count(src) > 0) {
+    LOG_WARN("[%s] Coroutine router %s already exists!", LOG_TAG, src.data());
+    return false;
+  }
+  co_routers_[src] = cb;
+  HttpResponse::set_router_mode(src, RM_COROUTINE);
+  return true;
+}
+bool Server::register_coroutine_router(const char* src,
+                                       const co_router_cb& cb) {
+  assert(src != nullptr);
+  string src_(src);
+  return register_coroutine_router(src_, cb);
+}
+#endif
+
 void Server::init_event_mode_(bool is_ET) {
   // 边缘触发监听(监听连接到来,额外监听读取关闭)
   // 不用设置 oneshot 即便有多个请求同时到达
@@ -175,25 +396,78 @@ void Server::init_event_mode_(bool is_ET) {
   is_ET_ = is_ET;
 }
 
-bool Server::init_socket_() {
-  int ret = -1;
+void Server::init_loops_() {
+  bool use_timer_fd = config_.timer_fd && has_conn_timer_();
+  main_loop_.reset(new EventLoop(0, config_.mux_backend, config_.timer_type,
+                                 use_timer_fd));
+  for (int i = 0; i < config_.loop_num; i++) {
+    sub_loops_.emplace_back(new EventLoop(i + 1, config_.mux_backend,
+                                          config_.timer_type, use_timer_fd));
+  }
+  // 所有循环使用相同的实现
+  completion_ =
+      config_.uring_completion && main_loop_->get_mux()->has_completion();
+  HttpConn::set_recv_inbox(completion_);
+  LOG_INFO("[%s] Mux backend: %s", LOG_TAG,
+           main_loop_->get_mux()->get_backend() == MUX_URING
+               ? (completion_ ? "io_uring(completion)" : "io_uring")
+               : "epoll");
+}
 
-  // 1. 创建端口
-  struct sockaddr_in addr;
+bool Server::init_socket_() {
   if (port_ > 65535 || port_ < 1024) {
     // 超出可用端口号范围
     LOG_ERROR("[%s] Port:%d error!", LOG_TAG, port_);
     return false;
   }
 
+  // 开启 reuse_port 且存在子循环时,每个子循环各自监听一个 socket,
+  // 由内核把新连接分散到各个 socket 上,accept 不再经过主循环
+  std::vector<EventLoop*> shards;
+  if (config_.reuse_port && !sub_loops_.empty()) {
+    for (auto& sub_loop : sub_loops_) {
+      shards.push_back(sub_loop.get());
+    }
+  } else {
+    shards.push_back(main_loop_.get());
+  }
+
+  for (EventLoop* loop : shards) {
+    int listen_fd = create_listen_socket_();
+    if (listen_fd < 0) {
+      return false;
+    }
+
+    // 将监听的端口添加到所属循环的 IO 复用中
+    mux_token token = make_mux_token(loop, FT_LISTEN);
+    if (completion_ ? !loop->get_mux()->add_accept(listen_fd, token)
+                    : !loop->get_mux()->add_fd(listen_fd, listen_events_,
+                                               token)) {
+      close(listen_fd);
+      LOG_ERROR("[%s] Add listened socket to mux error!", LOG_TAG);
+      return false;
+    }
+    loop->set_listen_fd(listen_fd);
+  }
+
+  LOG_INFO("[%s] Server port:%d, Listen shards:%d, Backlog:%d", LOG_TAG, port_,
+           (int)shards.size(), config_.listen_backlog);
+  return true;
+}
+
+int Server::create_listen_socket_() {
+  int ret = -1;
+
+  // 1. 创建端口
+  struct sockaddr_in addr;
   addr.sin_family = AF_INET;
   addr.sin_addr.s_addr = htonl(INADDR_ANY);
   addr.sin_port = htons(port_);
 
-  listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
-  if (listen_fd_ < 0) {
+  int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (listen_fd < 0) {
     LOG_ERROR("[%s] Create socket error, Port: %d", LOG_TAG, port_);
-    return false;
+    return -1;
   }
 
   // 2. 设置端口
@@ -208,12 +482,12 @@ bool Server::init_socket_() {
       opt_linger.l_linger = 1;
     }
 
-    ret = setsockopt(listen_fd_, SOL_SOCKET, SO_LINGER, &opt_linger,
+    ret = setsockopt(listen_fd, SOL_SOCKET, SO_LINGER, &opt_linger,
                      sizeof(opt_linger));
     if (ret < 0) {
-      close(listen_fd_);
+      close(listen_fd);
       LOG_ERROR("[%s] Init linger error!", LOG_TAG);
-      return false;
+      return -1;
     }
   }
 
@@ -222,44 +496,48 @@ bool Server::init_socket_() {
     // SO_REUSEADDR:
     //   当服务器自己关闭连接时由于TCP四次握手处于TimeWait状态时
     //   若重启服务器 不会因端口被占用而无法bind
-    ret = setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR,
+    ret = setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR,
                      (const void*)&opt_val, sizeof(int));
     if (ret == -1) {
-      close(listen_fd_);
+      close(listen_fd);
       LOG_ERROR("[%s] Set socket setsockopt error !", LOG_TAG);
-      return false;
+      return -1;
+    }
+  }
+
+  if (config_.reuse_port) {
+    int opt_val = 1;
+    // SO_REUSEPORT:
+    //   允许多个 socket 绑定同一端口,内核按四元组哈希把连接分给不同的 socket
+    ret = setsockopt(listen_fd, SOL_SOCKET, SO_REUSEPORT,
+                     (const void*)&opt_val, sizeof(int));
+    if (ret == -1) {
+      close(listen_fd);
+      LOG_ERROR("[%s] Set SO_REUSEPORT error !", LOG_TAG);
+      return -1;
     }
   }
 
   // 3. 绑定端口
-  ret = bind(listen_fd_, (struct sockaddr*)&addr, sizeof(addr));
+  ret = bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr));
   if (ret < 0) {
-    close(listen_fd_);
+    close(listen_fd);
     LOG_ERROR("[%s] Bind port error,Port: %d", LOG_TAG, port_);
-    return false;
+    return -1;
   }
 
   // 4. 监听端口
-  ret = listen(listen_fd_, 6);
+  ret = listen(listen_fd, config_.listen_backlog);
   if (ret < 0) {
-    close(listen_fd_);
+    close(listen_fd);
     LOG_ERROR("[%s] Listen port error,Port: %d", LOG_TAG, port_);
-    return false;
+    return -1;
   }
 
-  // 5. 将监听的端口添加到 IO 复用中
-  ret = mux_->add_fd(listen_fd_, listen_events_);
-  if (ret == 0) {
-    close(listen_fd_);
-    LOG_ERROR("[%s] Add listened socket to mux error!", LOG_TAG);
-    return false;
-  }
+  // 5. 设置被监听socket为非阻塞模式
+  set_fd_noblock(listen_fd);
 
-  // 6. 设置被监听socket为非阻塞模式
-  set_fd_noblock(listen_fd_);
-
-  LOG_INFO("[%s] Server port:%d", LOG_TAG, port_);
-  return true;
+  return listen_fd;
 }
 
 bool Server::init_quit_signal_() {
@@ -269,16 +547,21 @@ bool Server::init_quit_signal_() {
   // 直接使用 lambda 函数会报类型转换错误
   // 可以用functional包装一下
   signal(SIGINT, signal_handler);
-  shutdown_handler = [this](int sig) { this->is_close_ = true; };
+  // 信号可能被任意一个循环线程接收,主动唤醒主循环(eventfd 的 write 可以在
+  // 信号处理函数中调用),子循环在 start() 中统一唤醒
+  shutdown_handler = [this](int sig) {
+    this->is_close_ = true;
+    this->main_loop_->wakeup();
+  };
   return true;
 }
 
-void Server::deal_new_conn_() {
+void Server::deal_new_conn_(EventLoop* listen_loop) {
   struct sockaddr_in addr;
   socklen_t len = sizeof(addr);
   // 一次处理多个到达的请求
   do {
-    int fd = accept(listen_fd_, (struct sockaddr*)&addr, &len);
+    int fd = accept(listen_loop->get_listen_fd(), (struct sockaddr*)&addr, &len);
     if (fd < 0) {
       if (errno == EAGAIN) {
         return;
@@ -289,45 +572,99 @@ void Server::deal_new_conn_() {
       }
     }
 
-    // 限制最大客户端数量
-    if (HttpConn::get_user_count() >= MAX_FD) {
-      LOG_WARN("[%s] Server busy!", LOG_TAG);
-      send_error_(fd, "Server Busy!");
-      return;
-    }
+    // 边沿触发下后面排队的连接不会再通知,继续 accept 直到 EAGAIN
+    accept_conn_(listen_loop, fd, addr);
+  } while (true);
+}
 
-    // 成功建立连接,将新连接加入管理列表
-    lock_guard<mutex> lock(connections_[fd].mtx_);
-    connections_[fd].init(fd, addr);
-    if (timeout_ms_ > 0) {
-      lock_guard<mutex> time_lock(timer_mtx_);
-      timer_->add_timer(
-          fd, timeout_ms_,
-          std::bind(&Server::close_conn_, this, &connections_[fd]));
-    }
+void Server::deal_accepted_(EventLoop* listen_loop, int fd) {
+  if (fd < 0) {
+    LOG_ERROR("[%s] New connection creation failed with errno:[%d]", LOG_TAG,
+              -fd);
+    return;
+  }
+  // multishot accept 不带回对端地址,只在这里查询一次用于日志
+  struct sockaddr_in addr = {0};
+  socklen_t len = sizeof(addr);
+  getpeername(fd, (struct sockaddr*)&addr, &len);
+  accept_conn_(listen_loop, fd, addr);
+}
 
-    set_fd_noblock(fd);
-    // 新建立的连接只等待读
-    mux_->add_fd(fd, conn_events_ | EPOLLIN);
-    LOG_INFO("[%s] Client[%d] in!", LOG_TAG, fd);
-  } while (true);
+void Server::accept_conn_(EventLoop* listen_loop, int fd,
+                          const sockaddr_in& addr) {
+  // 限制最大客户端数量(连接按 fd 存放,fd 也不能超出范围)
+  if (HttpConn::get_user_count() >= MAX_FD || fd >= MAX_FD) {
+    LOG_WARN("[%s] Server busy!", LOG_TAG);
+    send_error_(fd, "Server Busy!");
+    return;
+  }
+
+  listen_loop->inc_accept_count();
+
+  // 成功建立连接,将新连接加入所选循环的管理列表
+  // 子循环自己监听(reuse_port)时连接直接留在该循环
+  EventLoop* loop =
+      listen_loop == main_loop_.get() ? select_loop_() : listen_loop;
+  if (loop == listen_loop) {
+    add_conn_(loop, fd, addr);
+  } else {
+    loop->queue_in_loop([this, loop, fd, addr] { add_conn_(loop, fd, addr); });
+  }
 }
 
-void Server::deal_close_conn_(HttpConn* client) {
-  lock_guard<mutex> time_lock(timer_mtx_);
-  timer_->do_work(client->get_fd());
+void Server::deal_close_conn_(EventLoop* loop, HttpConn* client) {
+  // 持有定时器的锁,避免与定时器同时关闭连接
+  lock_guard<mutex> time_lock(loop->get_timer_mtx());
+  if (has_conn_timer_()) {
+    loop->get_timer()->cancel(client->get_fd());
+  }
+  close_conn_(loop, client);
 }
 
-void Server::deal_read_conn_(HttpConn* client) {
-  // 交给线程池异步处理
+void Server::deal_read_conn_(EventLoop* loop, HttpConn* client) {
   extent_time_(client);
-  thread_pool_->AddTask(std::bind(&Server::on_read_, this, client));
+  // 记录当前连接的代数,任务执行时 fd 可能已经关闭并分配给了新连接
+  uint32_t generation = client->get_generation();
+  if (has_pool_()) {
+    // 交给线程池异步处理,处理完之前定时器不能关闭连接
+    client->set_busy(true);
+    add_task_(std::bind(&Server::on_read_, this, loop, client, generation),
+              std::bind(&Server::on_shed_, this, loop, client, generation));
+  } else {
+    // 多 reactor 模式下直接在所属循环线程中处理
+    on_read_(loop, client, generation);
+  }
+}
+
+void Server::deal_recv_conn_(EventLoop* loop, HttpConn* client,
+                             const char* data, int len) {
+  if (client->is_closed()) {
+    return;
+  }
+  // 连接正在处理时数据留在连接中,处理完后在处理线程中继续
+  if (!client->deliver(data, len)) {
+    return;
+  }
+  if (len <= 0) {
+    LOG_DEBUG("[%s] Connection[%d] recv finished with:%d.", LOG_TAG,
+              client->get_fd(), len);
+    deal_close_conn_(loop, client);
+    return;
+  }
+  deal_read_conn_(loop, client);
 }
 
-void Server::deal_write_conn_(HttpConn* client) {
-  // 交给线程池异步处理
+void Server::deal_write_conn_(EventLoop* loop, HttpConn* client) {
   extent_time_(client);
-  thread_pool_->AddTask(std::bind(&Server::on_write_, this, client));
+  uint32_t generation = client->get_generation();
+  if (has_pool_()) {
+    // 交给线程池异步处理
+    client->set_busy(true);
+    add_task_(std::bind(&Server::on_write_, this, loop, client, generation),
+              std::bind(&Server::on_shed_, this, loop, client, generation));
+  } else {
+    on_write_(loop, client, generation);
+  }
 }
 void Server::send_error_(int fd, const string& message) {
   // fd为非阻塞模式，若tcp缓冲区满，会直接返回错误
@@ -339,17 +676,73 @@ void Server::send_error_(int fd, const string& message) {
 }
 
 void Server::extent_time_(HttpConn* client) {
-  lock_guard<mutex> time_lock(timer_mtx_);
-  lock_guard<mutex> fd_lock(client->mtx_);
-  if (client->is_closed()) {
-    LOG_WARN("[%s] Try to extend time for a closed connection[%d].", LOG_TAG,
-             client->get_fd());
+  // 只记录活动时间,不操作定时器; 定时器到期时在 on_timeout_ 中检查
+  if (has_conn_timer_()) {
+    client->refresh_active(idle_timeout_ms_());
+  }
+}
+
+void Server::on_timeout_(EventLoop* loop, HttpConn* client) {
+  int64_t remaining = client->get_idle_remaining_ms();
+  if (remaining > 0) {
+    // 期间有过读写,从最近一次活动开始重新计时
+    loop->get_timer()->add_timer(
+        client->get_fd(), static_cast<int>(remaining),
+        std::bind(&Server::on_timeout_, this, loop, client));
+    return;
+  }
+  if (client->is_busy()) {
+    // 还有任务在处理这个连接,不能在这里关闭和归还缓冲区,等它处理完再检查
+    loop->get_timer()->add_timer(
+        client->get_fd(), idle_timeout_ms_(),
+        std::bind(&Server::on_timeout_, this, loop, client));
     return;
   }
+  close_conn_(loop, client);
+}
+
+EventLoop* Server::select_loop_() {
+  if (sub_loops_.empty()) {
+    return main_loop_.get();
+  }
 
+  if (config_.load_balance == LB_LEAST_CONN) {
+    EventLoop* loop = sub_loops_[0].get();
+    for (auto& sub_loop : sub_loops_) {
+      if (sub_loop->get_conn_count() < loop->get_conn_count()) {
+        loop = sub_loop.get();
+      }
+    }
+    return loop;
+  }
+
+  // 只有主循环线程调用,不需要加锁
+  EventLoop* loop = sub_loops_[next_loop_].get();
+  next_loop_ = (next_loop_ + 1) % sub_loops_.size();
+  return loop;
+}
+
+void Server::add_conn_(EventLoop* loop, int fd, const sockaddr_in& addr) {
+  HttpConn* client = connections_.get(fd);
+  lock_guard<mutex> lock(client->mtx_);
+  client->init(fd, addr);
+  loop->inc_conn_count();
   if (timeout_ms_ > 0) {
-    timer_->adjust(client->get_fd(), timeout_ms_);
+    lock_guard<mutex> time_lock(loop->get_timer_mtx());
+    client->refresh_active(timeout_ms_);
+    loop->get_timer()->add_timer(
+        fd, timeout_ms_, std::bind(&Server::on_timeout_, this, loop, client));
+    loop->schedule_timer(timeout_ms_);
   }
+
+  set_fd_noblock(fd);
+  // 新建立的连接只等待读; 完成模式下 recv 一直保留在内核中
+  if (completion_) {
+    loop->get_mux()->add_recv(fd, conn_token(client));
+  } else {
+    loop->get_mux()->add_fd(fd, conn_events_ | EPOLLIN, conn_token(client));
+  }
+  LOG_INFO("[%s] Client[%d] in loop[%d]!", LOG_TAG, fd, loop->get_index());
 }
 
 void Server::set_fd_noblock(int fd) {
@@ -370,11 +763,16 @@ void Server::set_fd_noblock(int fd) {
   fcntl(fd, F_SETFL, fcntl(fd, F_GETFD, NULL) | O_NONBLOCK);
 }
 
-void Server::on_read_(HttpConn* client) {
+void Server::on_read_(EventLoop* loop, HttpConn* client, uint32_t generation) {
   if (client->is_closed()) {
     LOG_WARN("[%s] Read a closed connection[%d].", LOG_TAG, client->get_fd());
     return;
   }
+  if (client->get_generation() != generation) {
+    LOG_WARN("[%s] Stale read task of connection[%d].", LOG_TAG,
+             client->get_fd());
+    return;
+  }
 
   LOG_DEBUG("[%s] On read request[%d].", LOG_TAG, client->get_fd());
 
@@ -383,56 +781,124 @@ void Server::on_read_(HttpConn* client) {
   if (ret < 0 && errno_ != EAGAIN) {
     LOG_ERROR("[%s] Client[%d] read error with errno:%d(connection closed)",
               LOG_TAG, client->get_fd(), errno_);
-    deal_close_conn_(client);
+    deal_close_conn_(loop, client);
     return;
   }
 
   // 在同一线程中继续处理报文
-  on_process_(client);
+  on_process_(loop, client);
 }
 
-void Server::on_write_(HttpConn* client) {
+void Server::on_write_(EventLoop* loop, HttpConn* client,
+                       uint32_t generation) {
   if (client->is_closed()) {
     LOG_WARN("[%s] Write to a closed connection[%d].", LOG_TAG,
              client->get_fd());
     return;
   }
+  if (client->get_generation() != generation) {
+    LOG_WARN("[%s] Stale write task of connection[%d].", LOG_TAG,
+             client->get_fd());
+    return;
+  }
 
   LOG_DEBUG("[%s] On write request[%d].", LOG_TAG, client->get_fd());
 
+  if (send_response_(loop, client) == SR_KEEP_ALIVE) {
+    // 客户端可能已经发来了下一个请求,边缘触发下不会再有可读事件,直接处理
+    on_process_(loop, client);
+  }
+}
+
+void Server::on_shed_(EventLoop* loop, HttpConn* client, uint32_t generation) {
+  if (client->is_closed() || client->get_generation() != generation) {
+    return;
+  }
+  LOG_WARN("[%s] Server overloaded, shed connection[%d].", LOG_TAG,
+           client->get_fd());
+  // 发送了一半的响应后面不能再插入其他报文,直接关闭
+  if (client->get_writable_bytes() == 0) {
+    // 先读走请求,关闭时接收缓冲区有数据会发送 RST,客户端可能收不到 503
+    int errno_;
+    client->read(&errno_);
+    send(client->get_fd(), SERVICE_UNAVAILABLE, sizeof(SERVICE_UNAVAILABLE) - 1,
+         MSG_NOSIGNAL);
+  }
+  deal_close_conn_(loop, client);
+}
+
+Server::SEND_RESULT Server::send_response_(EventLoop* loop,
+                                           HttpConn* client) {
   int errno_;
   int ret = client->write(&errno_);
   if (client->get_writable_bytes() == 0) {
     // 传输完成
-    // on_process_(client);
     LOG_DEBUG("[%s] Write request successfully![%d].", LOG_TAG,
               client->get_fd());
 
-    deal_close_conn_(client);
-    return;
-  } else if (ret < 0) {
-    if (errno_ == EAGAIN) {
-      // 暂时不可写,等待机会再写
-      LOG_DEBUG("[%s] Fd[%d] delay to write.", LOG_TAG, client->get_fd());
-      mux_->mod_fd(client->get_fd(), conn_events_ | EPOLLOUT);
-      return;
+    if (client->is_keep_alive()) {
+      keep_alive_(loop, client);
+      return SR_KEEP_ALIVE;
     }
+    deal_close_conn_(loop, client);
+    return SR_FINISHED;
+  } else if (ret < 0 && errno_ == EAGAIN) {
+    // 暂时不可写,等待机会再写
+    LOG_DEBUG("[%s] Fd[%d] delay to write.", LOG_TAG, client->get_fd());
+    rearm_(loop, client, EPOLLOUT);
+    return SR_AGAIN;
   }
 
   LOG_DEBUG("[%s] Write request failed![%d].", LOG_TAG, client->get_fd());
-  deal_close_conn_(client);
-  // 传输完成
-  // mux_->mod_fd(client->get_fd(), conn_events_);
-  // if (client->is_keep_alive()) {
-  //   mux_->mod_fd(client->get_fd(), conn_events_ | EPOLLIN);
-  // } else {
-  //   LOG_INFO("[%s] Close connection[%d] after write!", LOG_TAG,
-  //            client->get_fd());
-  //   deal_close_conn_(client);
-  // }
-}
-
-void Server::on_process_(HttpConn* client) {
+  deal_close_conn_(loop, client);
+  return SR_ERROR;
+}
+
+void Server::keep_alive_(EventLoop* loop, HttpConn* client) {
+  client->reset();
+
+  // 两次请求之间使用长连接的空闲超时
+  if (has_conn_timer_()) {
+    client->refresh_active(config_.keep_alive_timeout_ms);
+    // 定时器只会按活动时间延后,空闲超时比请求超时短时才需要提前定时器
+    // 没有请求超时时连接还没有定时器,在第一次保持连接时添加
+    if (timeout_ms_ <= 0 || config_.keep_alive_timeout_ms < timeout_ms_) {
+      lock_guard<mutex> time_lock(loop->get_timer_mtx());
+      // 连接只在持有定时器的锁时关闭
+      if (!client->is_closed()) {
+        if (timeout_ms_ > 0) {
+          loop->get_timer()->adjust(client->get_fd(),
+                                    config_.keep_alive_timeout_ms);
+        } else {
+          loop->get_timer()->add_timer(
+              client->get_fd(), config_.keep_alive_timeout_ms,
+              std::bind(&Server::on_timeout_, this, loop, client));
+        }
+        loop->schedule_timer(config_.keep_alive_timeout_ms);
+        // 没有 timerfd 时循环按之前查询的到期时间阻塞,唤醒它重新查询
+        // 在循环线程中时,下一次 wait 前本来就会重新查询
+        if (!loop->has_timer_fd() && !loop->is_in_loop_thread()) {
+          loop->wakeup();
+        }
+      }
+    }
+  }
+
+  LOG_DEBUG("[%s] Keep connection[%d] alive.", LOG_TAG, client->get_fd());
+}
+
+void Server::on_blocking_(EventLoop* loop, HttpConn* client,
+                          uint32_t generation) {
+  if (client->is_closed() || client->get_generation() != generation) {
+    LOG_WARN("[%s] Stale blocking task of connection[%d].", LOG_TAG,
+             client->get_fd());
+    return;
+  }
+  on_process_(loop, client, true);
+}
+
+void Server::on_process_(EventLoop* loop, HttpConn* client,
+                         bool allow_blocking) {
   if (client->is_closed()) {
     LOG_WARN("[%s] Process a closed connection[%d].", LOG_TAG,
              client->get_fd());
@@ -441,23 +907,144 @@ void Server::on_process_(HttpConn* client) {
 
   LOG_DEBUG("[%s] On process request[%d].", LOG_TAG, client->get_fd());
 
-  if (client->process()) {
-    // 处理报文成功,等待可写时回复
-    mux_->mod_fd(client->get_fd(), conn_events_ | EPOLLOUT);
+  // 循环处理读缓冲区中已到达的请求,不递归调用以免流水线请求过多时栈过深
+  // 完成模式下处理期间又收到的数据也在这里继续处理
+  do {
+    while (client->process(allow_blocking)) {
+      if (!config_.inline_write) {
+        // 处理报文成功,等待可写时回复
+        delayed_write_count_++;
+        rearm_(loop, client, EPOLLOUT);
+        return;
+      }
+
+      // socket 发送缓冲区通常有空间,直接发送可以省掉一次 epoll_wait 和线程切换
+      SEND_RESULT result = send_response_(loop, client);
+      if (result == SR_KEEP_ALIVE || result == SR_FINISHED) {
+        inline_write_count_++;
+      } else if (result == SR_AGAIN) {
+        delayed_write_count_++;
+      }
+      if (result != SR_KEEP_ALIVE) {
+        return;
+      }
+    }
+
+    if (client->has_blocking_request()) {
+      // 阻塞路由交给单独的线程池,不占用处理普通请求的线程,完成后在那里继续处理
+      extent_time_(client);
+      client->set_busy(true);
+      blocking_executor_->AddTask(std::bind(&Server::on_blocking_, this, loop,
+                                            client, client->get_generation()));
+      return;
+    }
+#ifdef MINISERVER_COROUTINE
+    if (client->has_coroutine_request()) {
+      start_coroutine_(loop, client);
+      return;
+    }
+#endif
+
+    // 没有完整的请求,等待重新接收报文(可能是未接收完请求体)
+  } while (wait_input_(loop, client));
+}
+
+void Server::rearm_(EventLoop* loop, HttpConn* client, uint32_t events) {
+  // 先取消标记: 注册后事件可能立刻在循环线程中再次分发
+  client->set_busy(false);
+  loop->get_mux()->mod_fd(client->get_fd(), conn_events_ | events,
+                          conn_token(client));
+}
+
+bool Server::wait_input_(EventLoop* loop, HttpConn* client) {
+  if (!completion_) {
+    rearm_(loop, client, EPOLLIN);
+    return false;
+  }
+  // recv 一直在内核中,不需要重新注册
+  switch (client->wait_input()) {
+    case HttpConn::IS_PENDING: {
+      int errno_;
+      client->read(&errno_);
+      return true;
+    }
+    case HttpConn::IS_CLOSED:
+      deal_close_conn_(loop, client);
+      return false;
+    default:
+      return false;
+  }
+}
+
+#ifdef MINISERVER_COROUTINE
+void Server::start_coroutine_(EventLoop* loop, HttpConn* client) {
+  extent_time_(client);
+  CoRouteContext* context = new CoRouteContext();
+  context->loop = loop;
+  context->executor = blocking_executor_.get();
+  context->request = client->get_request();
+  context->client = client;
+  context->generation = client->get_generation();
+  {
+    lock_guard<mutex> locker(co_mtx_);
+    co_contexts_.insert(context);
+  }
+  // 请求已复制到上下文,之后只在循环线程中访问连接,定时器可以照常关闭它
+  client->set_busy(false);
+  // 单循环模式下当前在线程池中,协程总是在循环线程中执行
+  loop->queue_in_loop(std::bind(&Server::run_coroutine_, this, context));
+}
+
+void Server::run_coroutine_(CoRouteContext* context) {
+  auto it = co_routers_.find(context->request.get_path());
+  if (it == co_routers_.end()) {
+    finish_coroutine_(context, false);
+    return;
+  }
+  context->task = it->second(context->request, context->body);
+  if (!context->task.valid()) {
+    finish_coroutine_(context, false);
+    return;
+  }
+  context->task.start(context, [this, context](bool ok) {
+    finish_coroutine_(context, ok);
+  });
+}
+
+void Server::finish_coroutine_(CoRouteContext* context, bool ok) {
+  coroutine_count_++;
+  HttpConn* client = context->client;
+  if (client->is_closed() || client->get_generation() != context->generation) {
+    LOG_WARN("[%s] Coroutine of closed connection[%d] finished.", LOG_TAG,
+             client->get_fd());
   } else {
-    // 处理失败,等待重新接收报文(可能是未接收完请求体)
-    mux_->mod_fd(client->get_fd(), conn_events_ | EPOLLIN);
+    // 连接在等待协程期间没有注册事件,仍由这里独占
+    client->set_async_result(ok, context->body);
+    on_process_(context->loop, client);
+  }
+  {
+    lock_guard<mutex> locker(co_mtx_);
+    co_contexts_.erase(context);
   }
+  // 协程已停在最终挂起点,可以随上下文一起销毁
+  delete context;
 }
+#endif
 
-void Server::close_conn_(HttpConn* client) {
+void Server::close_conn_(EventLoop* loop, HttpConn* client) {
   lock_guard<mutex> fd_lock(client->mtx_);
   if (client->is_closed()) {
     LOG_WARN("[%s] Close a closed connection[%d].", LOG_TAG, client->get_fd());
     return;
   }
-  int ret = mux_->del_fd(client->get_fd());
-  LOG_WARN("[%s] connect is close due to triggered by timer[%d].", LOG_TAG,client->get_fd());
+  if (!loop->get_mux()->del_fd(client->get_fd())) {
+    LOG_WARN("[%s] Remove connection[%d] from mux error!", LOG_TAG,
+             client->get_fd());
+  }
+  LOG_DEBUG("[%s] Close connection[%d].", LOG_TAG, client->get_fd());
   client->close_conn();
+  // 定时器不会关闭正在处理的连接,关闭它的线程此时独占连接,可以归还缓冲区
+  client->release_buffers();
+  loop->dec_conn_count();
 }
 }  // namespace MiniServer
\ No newline at end of file
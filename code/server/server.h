@@ -4,77 +4,246 @@
 #include <sys/signalfd.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include "http/http_conn.h"
+#include "http/http_scanner.h"
 #include "log/log.h"
 #include "mux/mux.h"
+#include "pool/blocking_executor.h"
 #include "pool/sql_conn_pool.h"
 #include "pool/thread_pool.h"
+#include "pool/work_stealing_pool.h"
+#include "server/co_router.h"
+#include "server/event_loop.h"
+#include "server/fd_slab.h"
 #include "timer/timer.h"
 
 using std::lock_guard;
 using std::mutex;
 
 namespace MiniServer {
+
+// 主循环把新连接分发给子循环的方式
+enum LOAD_BALANCE {
+  LB_ROUND_ROBIN,
+  LB_LEAST_CONN,
+};
+
+// 构造函数之外的可选配置,默认值与单循环 + 线程池的模式一致
+struct ServerConfig {
+  // 子事件循环(线程)数量
+  //   0: 单个 epoll 循环,读写事件交给线程池处理
+  //  >0: 主循环只负责 accept,连接交给子循环,读写处理都在子循环线程中完成
+  int loop_num = 0;
+  LOAD_BALANCE load_balance = LB_ROUND_ROBIN;
+  // 为每个子循环单独创建一个 SO_REUSEPORT 的监听 socket (需要 loop_num > 0)
+  bool reuse_port = false;
+  // listen() 的全连接队列长度
+  int listen_backlog = 6;
+  // 长连接: 单个连接最多处理的请求数, 两次请求之间的空闲超时
+  int keep_alive_max = 6;
+  int keep_alive_timeout_ms = 120000;
+  // 请求体的最大长度,超过时回复 413 并关闭连接
+  size_t body_size_max = 1024 * 1024;
+  // 处理完请求后在当前线程直接发送响应,写不完(EAGAIN)时才注册 EPOLLOUT
+  // 关闭时总是等待下一次可写事件再发送
+  bool inline_write = true;
+  // 多路复用实现, io_uring 不可用时退回 epoll
+  MUX_BACKEND mux_backend = MUX_EPOLL;
+  // 使用 io_uring 时由内核完成 accept/recv (multishot + buffer ring),
+  // 关闭或内核不支持时只用 io_uring 做就绪通知
+  bool uring_completion = true;
+  // 单循环模式下使用工作窃取线程池代替单队列的 ThreadPool
+  bool work_stealing = false;
+  // 单队列线程池的队列上限(0 不限制)和过载处理方式
+  //   QP_BLOCK: 阻塞事件循环; QP_REJECT: 直接回复 503; QP_CODEL: 丢弃排队过久的请求并回复 503
+  size_t pool_queue_size = 0;
+  QUEUE_POLICY pool_queue_policy = QP_BLOCK;
+  // QP_CODEL 的排队时间目标和统计间隔
+  int codel_target_ms = 5;
+  int codel_interval_ms = 100;
+  // 单队列线程池的最少线程数(0 表示固定为 pool_thread_num,不伸缩)
+  // 线程数在 [pool_min_threads, pool_thread_num] 之间按排队时间增加,空闲超时后减少
+  int pool_min_threads = 0;
+  int pool_grow_wait_ms = 10;
+  int pool_idle_timeout_ms = 60000;
+  // 执行阻塞路由的线程数, 0 表示与数据库连接池大小相同
+  int blocking_thread_num = 0;
+  // 连接超时定时器的实现,连接数很多时时间轮的添加/调整更快
+  TIMER_TYPE timer_type = TT_HEAP;
+  // 用 timerfd 通知定时器到期,事件循环不再在每次 wait 前加锁查询定时器
+  bool timer_fd = false;
+};
+
 class Server {
  public:
   Server(int port, bool is_ET, int timeout_ms, bool linger_close,
          const char* src_dir, const char* sql_host, int sql_port,
          const char* sql_user, const char* sql_pwd, const char* sql_db_name,
          int pool_sql_conn_num, int pool_thread_num, LOG_LEVEL log_level,
-         int log_queue_size);
+         int log_queue_size, const ServerConfig& config = ServerConfig());
   ~Server();
 
   void start();
 
+  // 每个监听 socket(分片) 累计 accept 的连接数
+  std::vector<uint64_t> get_accept_counts() const;
+  // 处理完请求后直接发送完成的响应数 / 需要等待 EPOLLOUT 的响应数
+  uint64_t get_inline_write_count() const { return inline_write_count_; }
+  uint64_t get_delayed_write_count() const { return delayed_write_count_; }
+  // 单队列线程池的排队、丢弃和排队时间统计(未使用 ThreadPool 时全为 0)
+  ThreadPoolStats get_pool_stats() const;
+
   static bool register_static_router(string& src, string& des);
   static bool register_static_router(const char* src, string& des);
   static bool register_static_router(string& src, const char* des);
   static bool register_static_router(const char* src, const char* des);
-  static bool register_dynamic_router(string& src, const router_cb& cb);
-  static bool register_dynamic_router(const char* src, const router_cb& cb);
+  // mode 为 RM_BLOCKING 的路由(如查询数据库)在单独的阻塞线程池中执行
+  static bool register_dynamic_router(string& src, const router_cb& cb,
+                                      ROUTER_MODE mode = RM_NONBLOCKING);
+  static bool register_dynamic_router(const char* src, const router_cb& cb,
+                                      ROUTER_MODE mode = RM_NONBLOCKING);
+#ifdef MINISERVER_COROUTINE
+  // 协程路由在连接所属的循环线程中执行,见 co_router.h
+  static bool register_coroutine_router(string& src, const co_router_cb& cb);
+  static bool register_coroutine_router(const char* src,
+                                        const co_router_cb& cb);
+  // 已结束的协程路由数
+  uint64_t get_coroutine_count() const { return coroutine_count_; }
+#endif
 
  private:
   // 初始化函数
   void init_event_mode_(bool is_ET);
   bool init_socket_();
+  int create_listen_socket_();
   bool init_quit_signal_();
+  void init_loops_();
+
+  // 事件循环(主循环和子循环共用)
+  void loop_(EventLoop* loop);
 
   // 处理事件函数
-  void deal_new_conn_();
-  void deal_close_conn_(HttpConn* client);
-  void deal_read_conn_(HttpConn* client);
-  void deal_write_conn_(HttpConn* client);
+  void deal_new_conn_(EventLoop* listen_loop);
+  void deal_conn_event_(EventLoop* loop, HttpConn* client, uint32_t event);
+  void deal_close_conn_(EventLoop* loop, HttpConn* client);
+  void deal_read_conn_(EventLoop* loop, HttpConn* client);
+  // io_uring 完成模式: 内核已经接受的新连接和收到的数据
+  void deal_accepted_(EventLoop* listen_loop, int fd);
+  void deal_recv_conn_(EventLoop* loop, HttpConn* client, const char* data,
+                       int len);
+  void deal_write_conn_(EventLoop* loop, HttpConn* client);
 
   // 工具函数
   void send_error_(int fd, const string& message);
   void extent_time_(HttpConn* client);
   void set_fd_noblock(int fd);
+  EventLoop* select_loop_();
+  // 连接的定时器: 请求超时(timeout_ms_ > 0)时建立连接就添加,
+  // 否则只有长连接空闲超时,在第一次保持连接时添加
+  bool has_conn_timer_() const {
+    return timeout_ms_ > 0 || config_.keep_alive_timeout_ms > 0;
+  }
+  // 有读写活动后允许的空闲时间
+  int idle_timeout_ms_() const {
+    return timeout_ms_ > 0 ? timeout_ms_ : config_.keep_alive_timeout_ms;
+  }
+  // 单循环模式下读写交给线程池处理
+  bool has_pool_() const { return thread_pool_ || steal_pool_; }
+  // on_drop: 任务因过载被拒绝或丢弃时调用(工作窃取线程池不丢弃任务)
+  template <class F, class D>
+  void add_task_(F&& task, D&& on_drop) {
+    if (steal_pool_) {
+      steal_pool_->AddTask(std::forward<F>(task));
+    } else {
+      thread_pool_->AddTask(std::forward<F>(task), std::forward<D>(on_drop));
+    }
+  }
+  // 为新连接选择循环(超出连接数上限时拒绝)
+  void accept_conn_(EventLoop* listen_loop, int fd, const sockaddr_in& addr);
+  // 在 loop 所在线程中建立连接
+  void add_conn_(EventLoop* loop, int fd, const sockaddr_in& addr);
+
+  // 发送响应的结果
+  enum SEND_RESULT {
+    SR_KEEP_ALIVE,  // 发送完成,连接保持,可以继续处理下一个请求
+    SR_FINISHED,    // 发送完成,连接已关闭
+    SR_AGAIN,       // 没有发送完,已注册 EPOLLOUT
+    SR_ERROR,       // 发送出错,连接已关闭
+  };
+  SEND_RESULT send_response_(EventLoop* loop, HttpConn* client);
+  // 处理完毕,重新注册事件把连接交还给循环
+  void rearm_(EventLoop* loop, HttpConn* client, uint32_t events);
+  // 没有完整的请求,等待接收数据; 返回 true 表示完成模式下已经收到了新数据,继续处理
+  bool wait_input_(EventLoop* loop, HttpConn* client);
 
   // 回调函数(实际工作函数) 给conn里实现一个包装
-  void on_read_(HttpConn* client);
-  void on_write_(HttpConn* client);
-  void on_process_(HttpConn* client);
-  void close_conn_(HttpConn* client);
-  
+  // generation: 投递任务时连接的代数,用于丢弃过期的任务
+  void on_read_(EventLoop* loop, HttpConn* client, uint32_t generation);
+  void on_write_(EventLoop* loop, HttpConn* client, uint32_t generation);
+  // allow_blocking: 在阻塞线程池中,可以执行阻塞路由
+  void on_process_(EventLoop* loop, HttpConn* client,
+                   bool allow_blocking = false);
+  // 在阻塞线程池中继续处理阻塞路由的请求
+  void on_blocking_(EventLoop* loop, HttpConn* client, uint32_t generation);
+#ifdef MINISERVER_COROUTINE
+  // 把停下的协程路由请求交给连接所属的循环,在循环线程中启动协程
+  void start_coroutine_(EventLoop* loop, HttpConn* client);
+  void run_coroutine_(CoRouteContext* context);
+  // 协程结束(循环线程): 连接仍有效时设置结果并继续处理,然后释放上下文
+  void finish_coroutine_(CoRouteContext* context, bool ok);
+#endif
+  // 线程池过载丢弃任务: 回复 503 后关闭连接
+  void on_shed_(EventLoop* loop, HttpConn* client, uint32_t generation);
+  void close_conn_(EventLoop* loop, HttpConn* client);
+  // 定时器到期: 空闲超时则关闭连接,否则按最近活动时间重新计时(持有定时器的锁)
+  void on_timeout_(EventLoop* loop, HttpConn* client);
+  // 回复完成后保持连接,重置请求状态和空闲超时
+  void keep_alive_(EventLoop* loop, HttpConn* client);
+
   static const int MAX_FD = 65535;
   string src_dir_;
   int port_;
   bool linger_close_;
   int timeout_ms_;
-  bool is_close_;
-  int listen_fd_;
+  // 信号处理函数和各个循环线程都会访问
+  std::atomic<bool> is_close_;
   bool is_ET_;
+  ServerConfig config_;
+  // 使用 io_uring 的完成模式
+  bool completion_;
 
   uint32_t listen_events_;
   uint32_t conn_events_;
 
-  std::mutex timer_mtx_;
-  std::unique_ptr<Timer> timer_;
+  // 主循环: 监听新连接(单循环模式下也处理所有连接)
+  std::unique_ptr<EventLoop> main_loop_;
+  // 子循环: 多 reactor 模式下处理各自的连接
+  std::vector<std::unique_ptr<EventLoop>> sub_loops_;
+  // 所有循环共用,以 fd 为下标,连接归属于接收它的循环
+  FdSlab<HttpConn> connections_;
+  size_t next_loop_;
+
+  std::atomic<uint64_t> inline_write_count_;
+  std::atomic<uint64_t> delayed_write_count_;
+#ifdef MINISERVER_COROUTINE
+  std::atomic<uint64_t> coroutine_count_{0};
+  static std::unordered_map<string, co_router_cb> co_routers_;
+  // 尚未结束的协程上下文,循环停止后等待中的协程不会再恢复,析构时统一释放
+  std::mutex co_mtx_;
+  std::unordered_set<CoRouteContext*> co_contexts_;
+#endif
+
+  // 线程池最后声明,最先析构: 等待线程执行完剩余任务时循环和连接仍然有效
   std::unique_ptr<ThreadPool> thread_pool_;
-  std::unique_ptr<Mux> mux_;
-  std::unordered_map<int, HttpConn> connections_;
+  std::unique_ptr<WorkStealingPool> steal_pool_;
+  // 执行阻塞路由,同样需要先于循环和连接析构
+  std::unique_ptr<BlockingExecutor> blocking_executor_;
 };
 
 }  // namespace MiniServer
\ No newline at end of file
@@ -0,0 +1,284 @@
+#include "time_wheel.h"
+
+#include <limits.h>
+
+namespace MiniServer {
+
+TimeWheel::TimeWheel(int tick_ms)
+    : tick_ms_(tick_ms > 0 ? tick_ms : 1),
+      start_(Clock::now()),
+      current_(0),
+      size_(0) {
+  clear();
+}
+
+void TimeWheel::add_timer(timer_id id, int timeout_period,
+                          const timeout_cb& call_back) {
+  if (id >= nodes_.size()) {
+    nodes_.resize(id + 1);
+  }
+  WheelNode& node = nodes_[id];
+  if (node.active) {
+    // 已有节点
+    unlink_(id);
+  } else {
+    // 时间轮为空时不会推进,先跳到当前时间; 否则按过时的 current_ 计算槽,
+    // 下一次 tick 还要逐个走完空闲期间的所有 tick
+    if (size_ == 0) {
+      uint64_t now = now_tick_();
+      if (current_ < now) {
+        current_ = now;
+      }
+    }
+    node.active = true;
+    size_++;
+  }
+  node.cb = call_back;
+  node.expire = expire_tick_(timeout_period);
+  link_(id);
+}
+
+void TimeWheel::do_work(timer_id id) {
+  if (id >= nodes_.size() || !nodes_[id].active) {
+    return;
+  }
+  // 先删除节点再调用,回调函数中可以重新添加同一个定时器
+  WheelNode& node = nodes_[id];
+  unlink_(id);
+  node.active = false;
+  size_--;
+  timeout_cb cb = std::move(node.cb);
+  node.cb = nullptr;
+  cb();
+}
+
+void TimeWheel::adjust(timer_id id, int timeout_period) {
+  // 确保元素存在
+  assert(id < nodes_.size() && nodes_[id].active);
+  if (id >= nodes_.size() || !nodes_[id].active) {
+    return;
+  }
+  unlink_(id);
+  nodes_[id].expire = expire_tick_(timeout_period);
+  link_(id);
+}
+
+void TimeWheel::cancel(timer_id id) {
+  if (id >= nodes_.size() || !nodes_[id].active) {
+    return;
+  }
+  unlink_(id);
+  nodes_[id].active = false;
+  nodes_[id].cb = nullptr;
+  size_--;
+}
+
+void TimeWheel::clear() {
+  nodes_.clear();
+  size_ = 0;
+  for (int i = 0; i < SLOT_NUM; i++) {
+    slots_[i] = -1;
+  }
+  for (uint64_t& bits : root_bitmap_) {
+    bits = 0;
+  }
+  for (uint64_t& bits : level_bitmap_) {
+    bits = 0;
+  }
+}
+
+void TimeWheel::tick() {
+  uint64_t now = now_tick_();
+  std::vector<timer_id> expired;
+  while (current_ <= now && size_ > 0) {
+    uint64_t t = current_;
+    int index = t & (ROOT_SIZE - 1);
+    // 第 0 层走完一圈,依次把上层对应的槽分配下来
+    for (int level = 1; index == 0 && level < LEVEL_NUM; level++) {
+      index = (t >> (ROOT_BITS + (level - 1) * LEVEL_BITS)) & (LEVEL_SIZE - 1);
+      cascade_(level, index);
+    }
+
+    expired.clear();
+    take_slot_(t & (ROOT_SIZE - 1), expired);
+    // 回调函数中新加入的定时器最早在下一个 tick 触发
+    current_ = t + 1;
+    for (timer_id id : expired) {
+      WheelNode& node = nodes_[id];
+      // 已被前面的回调函数取消或调整
+      if (!node.active || node.slot != -1) {
+        continue;
+      }
+      node.active = false;
+      size_--;
+      timeout_cb cb = std::move(node.cb);
+      node.cb = nullptr;
+      cb();
+    }
+  }
+  // 时间轮为空时直接跳到当前时间
+  if (size_ == 0 && current_ <= now) {
+    current_ = now + 1;
+  }
+}
+
+int TimeWheel::get_next_timeout_period() {
+  tick();
+  if (size_ == 0) {
+    return -1;
+  }
+
+  uint64_t next = UINT64_MAX;
+  int distance =
+      find_slot_(root_bitmap_, ROOT_SIZE, current_ & (ROOT_SIZE - 1));
+  if (distance >= 0) {
+    next = current_ + distance;
+  }
+  // 上层的定时器不会早于所在槽 cascade 的时间到期
+  for (int level = 1; level < LEVEL_NUM; level++) {
+    int shift = ROOT_BITS + (level - 1) * LEVEL_BITS;
+    uint64_t first = (current_ + (1ULL << shift) - 1) >> shift;
+    distance = find_slot_(&level_bitmap_[level - 1], LEVEL_SIZE,
+                          first & (LEVEL_SIZE - 1));
+    if (distance >= 0 && ((first + distance) << shift) < next) {
+      next = (first + distance) << shift;
+    }
+  }
+
+  int64_t now_ms =
+      std::chrono::duration_cast<MS>(Clock::now() - start_).count();
+  int64_t res = static_cast<int64_t>(next) * tick_ms_ - now_ms;
+  if (res < 0) {
+    return 0;
+  }
+  return res > INT_MAX ? INT_MAX : static_cast<int>(res);
+}
+
+// 私有函数
+uint64_t TimeWheel::now_tick_() const {
+  return std::chrono::duration_cast<MS>(Clock::now() - start_).count() /
+         tick_ms_;
+}
+
+uint64_t TimeWheel::expire_tick_(int timeout_period) const {
+  if (timeout_period < 0) {
+    timeout_period = 0;
+  }
+  // 向上取整,保证不会提前触发
+  int64_t now_ms =
+      std::chrono::duration_cast<MS>(Clock::now() - start_).count();
+  return (now_ms + timeout_period + tick_ms_ - 1) / tick_ms_;
+}
+
+void TimeWheel::link_(timer_id id) {
+  WheelNode& node = nodes_[id];
+  // 已经过期的定时器放到下一个要处理的槽
+  uint64_t expire = node.expire < current_ ? current_ : node.expire;
+  uint64_t distance = expire - current_;
+  if (distance > MAX_DISTANCE) {
+    // 超出范围,先放在最高层最远的槽,cascade 时重新计算
+    expire = current_ + MAX_DISTANCE;
+    distance = MAX_DISTANCE;
+  }
+
+  int slot;
+  if (distance < ROOT_SIZE) {
+    slot = expire & (ROOT_SIZE - 1);
+    root_bitmap_[slot >> 6] |= 1ULL << (slot & 63);
+  } else {
+    int level = 1;
+    while (distance >= (1ULL << (ROOT_BITS + level * LEVEL_BITS))) {
+      level++;
+    }
+    int index =
+        (expire >> (ROOT_BITS + (level - 1) * LEVEL_BITS)) & (LEVEL_SIZE - 1);
+    slot = ROOT_SIZE + (level - 1) * LEVEL_SIZE + index;
+    level_bitmap_[level - 1] |= 1ULL << index;
+  }
+
+  // 插入链表头
+  node.slot = slot;
+  node.prev = -1;
+  node.next = slots_[slot];
+  if (node.next != -1) {
+    nodes_[node.next].prev = id;
+  }
+  slots_[slot] = id;
+}
+
+void TimeWheel::unlink_(timer_id id) {
+  WheelNode& node = nodes_[id];
+  if (node.slot == -1) {
+    return;
+  }
+  if (node.prev != -1) {
+    nodes_[node.prev].next = node.next;
+  } else {
+    slots_[node.slot] = node.next;
+  }
+  if (node.next != -1) {
+    nodes_[node.next].prev = node.prev;
+  }
+
+  if (slots_[node.slot] == -1) {
+    int slot = node.slot;
+    if (slot < ROOT_SIZE) {
+      root_bitmap_[slot >> 6] &= ~(1ULL << (slot & 63));
+    } else {
+      slot -= ROOT_SIZE;
+      level_bitmap_[slot / LEVEL_SIZE] &= ~(1ULL << (slot % LEVEL_SIZE));
+    }
+  }
+  node.slot = -1;
+  node.prev = -1;
+  node.next = -1;
+}
+
+void TimeWheel::take_slot_(int slot, std::vector<timer_id>& ids) {
+  int id = slots_[slot];
+  while (id != -1) {
+    WheelNode& node = nodes_[id];
+    ids.push_back(id);
+    id = node.next;
+    node.slot = -1;
+    node.prev = -1;
+    node.next = -1;
+  }
+  slots_[slot] = -1;
+  if (slot < ROOT_SIZE) {
+    root_bitmap_[slot >> 6] &= ~(1ULL << (slot & 63));
+  } else {
+    slot -= ROOT_SIZE;
+    level_bitmap_[slot / LEVEL_SIZE] &= ~(1ULL << (slot % LEVEL_SIZE));
+  }
+}
+
+void TimeWheel::cascade_(int level, int index) {
+  std::vector<timer_id> ids;
+  take_slot_(ROOT_SIZE + (level - 1) * LEVEL_SIZE + index, ids);
+  for (timer_id id : ids) {
+    link_(id);
+  }
+}
+
+int TimeWheel::find_slot_(const uint64_t* bitmap, int size, int begin) const {
+  int words = size / 64;
+  int word = begin >> 6;
+  // 起始字中 begin 之后的位
+  uint64_t bits = bitmap[word] & (~0ULL << (begin & 63));
+  for (int n = 0; n <= words; n++) {
+    if (bits != 0) {
+      int pos = word * 64 + __builtin_ctzll(bits);
+      return (pos - begin + size) % size;
+    }
+    word = (word + 1) % words;
+    bits = bitmap[word];
+    if (n + 1 == words) {
+      // 绕回起始字,只看 begin 之前的位
+      bits &= (1ULL << (begin & 63)) - 1;
+    }
+  }
+  return -1;
+}
+
+}  // namespace MiniServer
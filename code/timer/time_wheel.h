@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "timer.h"
+
+/*
+分层时间轮(与 Linux 内核早期的 timer wheel 相同的结构)
+  第 0 层 256 个槽,每槽 1 个 tick; 第 1~3 层各 64 个槽,每槽覆盖下一层一整圈
+  定时器按到期 tick 与当前 tick 的距离放入对应层的槽,当前 tick 走完第 0 层一圈时,
+  把上一层对应槽里的定时器重新分配(cascade)到下层
+节点按定时器 id 存放在数组中,槽内用下标组成双向链表:
+  添加/调整/取消都是 O(1),不需要哈希表和堆调整
+*/
+namespace MiniServer {
+
+class TimeWheel : public TimerBase {
+ public:
+  // tick_ms: 时间轮的精度,定时器不会早于设定时间触发,最多晚一个 tick
+  explicit TimeWheel(int tick_ms = 1);
+  ~TimeWheel(){};
+
+  void add_timer(timer_id id, int timeout_period,
+                 const timeout_cb& call_back) override;
+  void do_work(timer_id id) override;
+  void adjust(timer_id id, int timeout_period) override;
+  void cancel(timer_id id) override;
+
+  void clear() override;
+  // 推进时间轮到当前时间,调用所有到期定时器的回调函数
+  void tick() override;
+
+  // 第 0 层的定时器返回精确的剩余时间,更高层返回下一次 cascade 的时间
+  int get_next_timeout_period() override;
+
+  size_t size() const { return size_; }
+
+ private:
+  static const int LEVEL_NUM = 4;
+  static const int ROOT_BITS = 8;
+  static const int LEVEL_BITS = 6;
+  static const int ROOT_SIZE = 1 << ROOT_BITS;
+  static const int LEVEL_SIZE = 1 << LEVEL_BITS;
+  // 第 0 层之后的槽依次编号
+  static const int SLOT_NUM = ROOT_SIZE + (LEVEL_NUM - 1) * LEVEL_SIZE;
+  // 能表示的最大距离,更远的定时器放在最高层,到时会重新分配
+  static const uint64_t MAX_DISTANCE =
+      (1ULL << (ROOT_BITS + (LEVEL_NUM - 1) * LEVEL_BITS)) - 1;
+
+  struct WheelNode {
+    timeout_cb cb;
+    uint64_t expire = 0;
+    // 所在槽,不在任何槽中时为 -1
+    int slot = -1;
+    int prev = -1;
+    int next = -1;
+    bool active = false;
+  };
+
+  uint64_t now_tick_() const;
+  uint64_t expire_tick_(int timeout_period) const;
+  // 按到期时间放入对应的槽
+  void link_(timer_id id);
+  void unlink_(timer_id id);
+  // 取出整个槽的节点
+  void take_slot_(int slot, std::vector<timer_id>& ids);
+  void cascade_(int level, int index);
+  // 从 begin 开始在 bitmap 中查找第一个非空的槽(循环),返回距离,没有时返回 -1
+  int find_slot_(const uint64_t* bitmap, int size, int begin) const;
+
+  const int tick_ms_;
+  const time_stamp start_;
+  // 下一个要处理的 tick,之前的都已经处理完
+  uint64_t current_;
+  size_t size_;
+
+  std::vector<WheelNode> nodes_;
+  // 每个槽链表头的节点下标,空槽为 -1
+  int slots_[SLOT_NUM];
+  // 每层非空槽的位图,用于快速查找下一个到期的槽
+  uint64_t root_bitmap_[ROOT_SIZE / 64];
+  uint64_t level_bitmap_[LEVEL_NUM - 1];
+};
+
+}  // namespace MiniServer
@@ -36,10 +36,11 @@ void MiniServer::Timer::do_work(timer_id id) {
   if (heap_.empty() || timer_ref_.count(id) == 0) {
     return;
   }
+  // 先删除节点再调用,回调函数中可以重新添加同一个定时器
   size_t i = timer_ref_[id];
-  TimerNode& node = heap_[i];
-  node.cb();
+  timeout_cb cb = std::move(heap_[i].cb);
   delete_(i);
+  cb();
 }
 
 void MiniServer::Timer::adjust(timer_id id, int timeout_period) {
@@ -52,6 +53,13 @@ void MiniServer::Timer::adjust(timer_id id, int timeout_period) {
   }
 }
 
+void MiniServer::Timer::cancel(timer_id id) {
+  if (timer_ref_.count(id) == 0) {
+    return;
+  }
+  delete_(timer_ref_[id]);
+}
+
 // 是否应该把定时器中所有元素弹出并调用回调函数？ 目前不调用
 void MiniServer::Timer::clear() {
   timer_ref_.clear();
@@ -72,8 +80,9 @@ void MiniServer::Timer::tick() {
       break;
     }
 
-    node.cb();
+    timeout_cb cb = std::move(node.cb);
     delete_(0);
+    cb();
   }
 }
 
@@ -22,27 +22,59 @@ struct TimerNode {
   bool operator<(const TimerNode& t) { return timeout_point < t.timeout_point; }
 };
 
-class Timer {
+// 定时器的实现方式
+enum TIMER_TYPE {
+  TT_HEAP,   // 小顶堆, O(log n) 添加/调整
+  TT_WHEEL,  // 分层时间轮, O(1) 添加/调整/取消
+};
+
+// 定时器接口, Server 通过它使用不同的实现
+class TimerBase {
+ public:
+  virtual ~TimerBase(){};
+
+  /*timeout_period:定时器的存活时间*/
+  virtual void add_timer(timer_id id, int timeout_period,
+                         const timeout_cb& call_back) = 0;
+  /*启动某个定时器里的回调函数*/
+  virtual void do_work(timer_id id) = 0;
+  /*重新调整某个定时器的时间*/
+  virtual void adjust(timer_id id, int timeout_period) = 0;
+  /*删除某个定时器,不调用回调函数*/
+  virtual void cancel(timer_id id) = 0;
+
+  /*删除所有定时器*/
+  virtual void clear() = 0;
+  // 删除所有到时间的定时器并调用回调函数
+  virtual void tick() = 0;
+
+  // 获取下一个定时器触发的剩余时间,没有定时器时返回 -1
+  virtual int get_next_timeout_period() = 0;
+};
+
+class Timer : public TimerBase {
  public:
   Timer(){};
   ~Timer(){};
 
   /*timeout_period:定时器的存活时间*/
-  void add_timer(timer_id id, int timeout_period, const timeout_cb& call_back);
+  void add_timer(timer_id id, int timeout_period,
+                 const timeout_cb& call_back) override;
   void pop_timer();
 
   /*启动某个定时器里的回调函数*/
-  void do_work(timer_id id);
+  void do_work(timer_id id) override;
   /*重新调整某个定时器的时间*/
-  void adjust(timer_id id, int timeout_period);
+  void adjust(timer_id id, int timeout_period) override;
+  void cancel(timer_id id) override;
 
   /*删除所有定时器*/
-  void clear();
+  void clear() override;
   // 查看堆顶的定时器是否到时间并删除它
-  void tick();
+  void tick() override;
 
   // 获取下一个定时器触发的剩余时间
-  int get_next_timeout_period();
+  int get_next_timeout_period() override;
 
  private:
   void delete_(size_t index);
@@ -0,0 +1,63 @@
+#include "timer_fd.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <time.h>
+
+#include "log/log.h"
+
+const static char LOG_TAG[] = "TIMER_FD";
+
+namespace MiniServer {
+
+TimerFd::TimerFd()
+    : fd_(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)),
+      deadline_ms_(-1) {
+  assert(fd_ >= 0);
+}
+
+TimerFd::~TimerFd() { close(fd_); }
+
+void TimerFd::arm(int timeout_ms) {
+  struct itimerspec spec = {};
+  if (timeout_ms >= 0) {
+    // it_value 全为 0 表示停止,已经到期的定时器至少等 1 纳秒
+    spec.it_value.tv_sec = timeout_ms / 1000;
+    spec.it_value.tv_nsec = (timeout_ms % 1000) * 1000000L;
+    if (timeout_ms == 0) {
+      spec.it_value.tv_nsec = 1;
+    }
+    deadline_ms_ = now_ms_() + timeout_ms;
+  } else {
+    deadline_ms_ = -1;
+  }
+  if (timerfd_settime(fd_, 0, &spec, nullptr) < 0) {
+    LOG_ERROR("[%s] timerfd_settime error with errno:%d", LOG_TAG, errno);
+  }
+}
+
+void TimerFd::arm_earlier(int timeout_ms) {
+  if (timeout_ms < 0) {
+    return;
+  }
+  if (deadline_ms_ < 0 || now_ms_() + timeout_ms < deadline_ms_) {
+    arm(timeout_ms);
+  }
+}
+
+uint64_t TimerFd::read_expirations() {
+  uint64_t count = 0;
+  ssize_t n = ::read(fd_, &count, sizeof(count));
+  if (n != sizeof(count) && errno != EAGAIN) {
+    LOG_WARN("[%s] Read timerfd error with errno:%d", LOG_TAG, errno);
+  }
+  return count;
+}
+
+int64_t TimerFd::now_ms_() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+}  // namespace MiniServer
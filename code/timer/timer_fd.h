@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+/*
+用 timerfd 驱动定时器: 把最近的到期时间设置到 timerfd 上并注册到 Mux,
+到期时作为普通的可读事件返回,事件循环不需要在每次 wait 前计算超时时间
+*/
+namespace MiniServer {
+
+class TimerFd {
+ public:
+  TimerFd();
+  ~TimerFd();
+  TimerFd(const TimerFd&) = delete;
+  TimerFd& operator=(const TimerFd&) = delete;
+
+  int get_fd() const { return fd_; }
+
+  // timeout_ms 后触发, timeout_ms < 0 时停止
+  void arm(int timeout_ms);
+  // 只有比已设置的时间更早时才修改,用于新增或提前了某个定时器
+  void arm_earlier(int timeout_ms);
+  // 读取到期次数,清除可读状态
+  uint64_t read_expirations();
+
+ private:
+  static int64_t now_ms_();
+
+  int fd_;
+  // 已设置的到期时间(CLOCK_MONOTONIC 毫秒),未设置时为 -1
+  int64_t deadline_ms_;
+};
+
+}  // namespace MiniServer
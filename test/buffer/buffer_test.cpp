@@ -4,8 +4,15 @@
 #include <fcntl.h>
 #include <gtest/gtest.h>
 #include <stdio.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
+#include <algorithm>
+#include <chrono>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 #include <string>
 
 using std::cin;
@@ -121,4 +128,189 @@ TEST(Buffer, File) {
   // 手动看了下是一样的(偷个懒)
 }
 
-}  // namespace MiniServer
\ No newline at end of file
+TEST(Buffer, view_and_pin) {
+  Buffer buffer;
+  buffer.write_buffer("GET / HTTP/1.1\r\nHost: a\r\n\r\n");
+  const char* line_end = buffer.find_crlf();
+  ASSERT_NE(line_end, nullptr);
+  StringView line(buffer.get_read_ptr(), line_end - buffer.get_read_ptr());
+  EXPECT_EQ(line, "GET / HTTP/1.1");
+  EXPECT_EQ(buffer.find_crlf(line_end + 2) - line_end, 9);
+  EXPECT_EQ(buffer.peek_view(3), "GET");
+
+  // pin 住后消耗、清空、扩容都不影响已有的视图
+  buffer.pin();
+  buffer.consume_until(line_end + 2);
+  EXPECT_EQ(buffer.peek_view(), "Host: a\r\n\r\n");
+  buffer.clear();
+  EXPECT_EQ(buffer.find_crlf(), nullptr);
+  buffer.write_buffer(std::string(ChunkPool::CHUNK_SIZE * 2, 'x'));
+  EXPECT_EQ(line, "GET / HTTP/1.1");
+  buffer.unpin();
+  EXPECT_FALSE(buffer.is_pinned());
+
+  // 没有 pin 住时 clear 回到开头,存储可以重用
+  buffer.clear();
+  size_t capacity = buffer.capacity();
+  buffer.write_buffer(std::string(capacity, 'y'));
+  EXPECT_EQ(buffer.capacity(), capacity);
+}
+
+// 原来的读法: 先读入可写空间,多出的读到栈上的 64 KB 数组再复制回来
+static ssize_t spill_read_fd(Buffer& buffer, int fd) {
+  char buff[65536];
+  if (buffer.get_writable_bytes() == 0) {
+    buffer.make_space(1);
+  }
+  const size_t writeable_bytes = buffer.get_writable_bytes();
+  struct iovec iov[2];
+  iov[0].iov_base = buffer.get_write_ptr();
+  iov[0].iov_len = writeable_bytes;
+  iov[1].iov_base = buff;
+  iov[1].iov_len = sizeof(buff);
+  const ssize_t len = readv(fd, iov, 2);
+  if (len <= 0) {
+    return len;
+  }
+  if (static_cast<size_t>(len) <= writeable_bytes) {
+    buffer.move_write_ptr(len);
+  } else {
+    buffer.move_write_ptr(writeable_bytes);
+    buffer.write_buffer(buff, len - writeable_bytes);
+  }
+  return len;
+}
+
+static std::string load_fixture() {
+  std::ifstream in("../data/test/buffer/buffer_read.txt");
+  std::stringstream ss;
+  ss << in.rdbuf();
+  return ss.str();
+}
+
+// 临时文件,内容是重复 count 次的 content
+static int make_body_file(const std::string& content, int count) {
+  char path[] = "/tmp/buffer_testXXXXXX";
+  int fd = mkstemp(path);
+  unlink(path);
+  for (int i = 0; i < count; i++) {
+    if (write(fd, content.data(), content.size()) !=
+        static_cast<ssize_t>(content.size())) {
+      close(fd);
+      return -1;
+    }
+  }
+  return fd;
+}
+
+TEST(Buffer, adaptive_read_size) {
+  const std::string fixture = load_fixture();
+  ASSERT_FALSE(fixture.empty());
+
+  // 大的请求体: 第一次读满预留的空间后按 FIONREAD 预留,但不超过 READ_SIZE_MAX,
+  // 之后随已有数据按容量翻倍增长,不会一次按整个请求体预留
+  const int COUNT = 512;
+  int file = make_body_file(fixture, COUNT);
+  ASSERT_GE(file, 0);
+  lseek(file, 0, SEEK_SET);
+  Buffer buffer;
+  int errno_ = 0;
+  int reads = 0;
+  size_t readable = 0;
+  ssize_t len;
+  while ((len = buffer.read_fd(file, &errno_)) > 0) {
+    EXPECT_LE(static_cast<size_t>(len),
+              std::max(Buffer::READ_SIZE_MAX, readable));
+    readable = buffer.get_readable_bytes();
+    reads++;
+  }
+  close(file);
+  EXPECT_GT(reads, 2);
+  ASSERT_EQ(buffer.get_readable_bytes(), fixture.size() * COUNT);
+  EXPECT_EQ(std::string(buffer.get_read_ptr(), fixture.size()), fixture);
+  EXPECT_GT(buffer.get_read_size(), Buffer::READ_SIZE_MIN);
+
+  // 之后一直是小请求,预留的空间逐步缩回最小值
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+  for (int i = 0; i < 20; i++) {
+    buffer.release();
+    ASSERT_EQ(write(fds[1], fixture.data(), fixture.size()),
+              static_cast<ssize_t>(fixture.size()));
+    EXPECT_EQ(buffer.read_fd(fds[0], &errno_),
+              static_cast<ssize_t>(fixture.size()));
+    EXPECT_EQ(buffer.read_fd(fds[0], &errno_), -1);
+    EXPECT_EQ(errno_, EAGAIN);
+  }
+  EXPECT_EQ(buffer.get_read_size(), Buffer::READ_SIZE_MIN);
+  EXPECT_EQ(buffer.read_all(), fixture);
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST(Buffer, benchmark_read_fd) {
+  const std::string fixture = load_fixture();
+  ASSERT_FALSE(fixture.empty());
+  int errno_ = 0;
+
+  // 小请求: 每轮一个 fixture,读到 EAGAIN 后取走
+  const int ROUNDS = 20000;
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+  auto run_small = [&](bool adaptive) {
+    Buffer buffer;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < ROUNDS; i++) {
+      ASSERT_EQ(write(fds[1], fixture.data(), fixture.size()),
+                static_cast<ssize_t>(fixture.size()));
+      while ((adaptive ? buffer.read_fd(fds[0], &errno_)
+                       : spill_read_fd(buffer, fds[0])) > 0) {
+      }
+      ASSERT_EQ(buffer.get_readable_bytes(), fixture.size());
+      buffer.clear();
+    }
+    std::cout << (adaptive ? "adaptive" : "spill") << " small: "
+              << std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     std::chrono::steady_clock::now() - begin)
+                         .count() /
+                     ROUNDS
+              << " ns/request" << std::endl;
+  };
+  run_small(false);
+  run_small(true);
+  close(fds[0]);
+  close(fds[1]);
+
+  // 大的请求体: 约 1 MB,每轮从头读完
+  const int COUNT = 560;
+  const int BODY_ROUNDS = 200;
+  int file = make_body_file(fixture, COUNT);
+  ASSERT_GE(file, 0);
+  auto run_body = [&](bool adaptive) {
+    Buffer buffer;
+    int reads = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < BODY_ROUNDS; i++) {
+      lseek(file, 0, SEEK_SET);
+      while ((adaptive ? buffer.read_fd(file, &errno_)
+                       : spill_read_fd(buffer, file)) > 0) {
+        reads++;
+      }
+      ASSERT_EQ(buffer.get_readable_bytes(), fixture.size() * COUNT);
+      // 每轮结束归还存储,读取历史保留
+      buffer.release();
+    }
+    std::cout << (adaptive ? "adaptive" : "spill") << " body: "
+              << std::chrono::duration_cast<std::chrono::microseconds>(
+                     std::chrono::steady_clock::now() - begin)
+                         .count() /
+                     BODY_ROUNDS
+              << " us/body, " << reads / BODY_ROUNDS << " reads/body"
+              << std::endl;
+  };
+  run_body(false);
+  run_body(true);
+  close(file);
+}
+
+}  // namespace MiniServer
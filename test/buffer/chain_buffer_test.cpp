@@ -0,0 +1,143 @@
+#include "buffer/chain_buffer.h"
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <string>
+
+namespace MiniServer {
+
+static const char STATUS_LINE[] = "HTTP/1.1 200 OK\r\n";
+
+// 读出管道中已有的数据
+static std::string drain(int fd) {
+  std::string result;
+  char buff[4096];
+  ssize_t n;
+  while ((n = read(fd, buff, sizeof(buff))) > 0) {
+    result.append(buff, n);
+  }
+  return result;
+}
+
+TEST(ChainBuffer, append_and_merge) {
+  ChainBuffer chain;
+  chain.append_static(STATUS_LINE, sizeof(STATUS_LINE) - 1);
+  // 相邻复制的数据合并为一个片段
+  chain.append("Content-Length: 5\r\n");
+  chain.append("\r\n");
+  Buffer body;
+  body.write_buffer("hello");
+  chain.append_buffer(body);
+  // 响应体被接管,不复制
+  EXPECT_EQ(body.get_readable_bytes(), 0u);
+
+  EXPECT_EQ(chain.get_slice_count(), 3u);
+  EXPECT_EQ(chain.to_string(),
+            "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nhello");
+
+  // 超过块大小的数据单独存放
+  std::string large(ChainBuffer::CHUNK_SIZE + 1, 'x');
+  chain.append(large);
+  EXPECT_EQ(chain.get_readable_bytes(), 43u + large.size());
+
+  chain.clear();
+  EXPECT_EQ(chain.get_readable_bytes(), 0u);
+  EXPECT_EQ(chain.get_slice_count(), 0u);
+}
+
+TEST(ChainBuffer, write_memory_file_and_mapped) {
+  // 文件内容
+  char path[] = "/tmp/chain_buffer_testXXXXXX";
+  int file = mkstemp(path);
+  ASSERT_GE(file, 0);
+  unlink(path);
+  std::string content = "0123456789abcdefghij";
+  ASSERT_EQ(write(file, content.data(), content.size()),
+            (ssize_t)content.size());
+  char* mapped = (char*)mmap(nullptr, content.size(), PROT_READ, MAP_PRIVATE,
+                             file, 0);
+  ASSERT_NE(mapped, MAP_FAILED);
+
+  ChainBuffer chain;
+  chain.append("head1|");
+  chain.append_mapped(mapped, 10);
+  chain.append_static("|", 1);
+  // fd 交给 chain 关闭
+  chain.append_file(dup(file), 10, 10);
+  chain.append("|tail");
+  close(file);
+  std::string expected = "head1|0123456789|abcdefghij|tail";
+  EXPECT_EQ(chain.to_string(), expected);
+
+  int fds[2];
+  ASSERT_EQ(pipe2(fds, O_NONBLOCK), 0);
+  int errno_ = 0;
+  // 第一次 writev 发送文件区间之前的三个内存片段
+  EXPECT_EQ(chain.write_fd(fds[1], &errno_), 17);
+  // 第二次 sendfile
+  EXPECT_EQ(chain.write_fd(fds[1], &errno_), 10);
+  EXPECT_EQ(chain.write_fd(fds[1], &errno_), 5);
+  EXPECT_EQ(chain.get_readable_bytes(), 0u);
+  EXPECT_EQ(drain(fds[0]), expected);
+  chain.clear();
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST(ChainBuffer, partial_write) {
+  int fds[2];
+  ASSERT_EQ(pipe2(fds, O_NONBLOCK), 0);
+  // 管道缓冲区只有一页,一次写不完
+  fcntl(fds[1], F_SETPIPE_SZ, 4096);
+  ChainBuffer chain;
+  std::string first(3000, 'a');
+  std::string second(3000, 'b');
+  chain.append(first);
+  chain.append_static(second.data(), second.size());
+
+  int errno_ = 0;
+  std::string received;
+  while (chain.get_readable_bytes() > 0) {
+    ssize_t len = chain.write_fd(fds[1], &errno_);
+    if (len < 0) {
+      ASSERT_EQ(errno_, EAGAIN);
+      received += drain(fds[0]);
+    }
+  }
+  received += drain(fds[0]);
+  EXPECT_EQ(received, first + second);
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST(ChainBuffer, truncated_file) {
+  char path[] = "/tmp/chain_buffer_testXXXXXX";
+  int file = mkstemp(path);
+  ASSERT_GE(file, 0);
+  unlink(path);
+  std::string content = "0123456789";
+  ASSERT_EQ(write(file, content.data(), content.size()),
+            (ssize_t)content.size());
+
+  ChainBuffer chain;
+  chain.append_file(dup(file), 0, 20);
+  int fds[2];
+  ASSERT_EQ(pipe2(fds, O_NONBLOCK), 0);
+  int errno_ = 0;
+  // 文件比登记的区间短: 先发出已有的部分,之后 sendfile 返回 0 时报错而不是一直重试
+  EXPECT_EQ(chain.write_fd(fds[1], &errno_), 10);
+  EXPECT_EQ(chain.write_fd(fds[1], &errno_), -1);
+  EXPECT_EQ(errno_, EIO);
+  EXPECT_EQ(chain.get_readable_bytes(), 10u);
+  EXPECT_EQ(drain(fds[0]), content);
+  chain.clear();
+  close(file);
+  close(fds[0]);
+  close(fds[1]);
+}
+
+}  // namespace MiniServer
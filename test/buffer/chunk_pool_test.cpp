@@ -0,0 +1,91 @@
+#include "buffer/chunk_pool.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "buffer/buffer.h"
+#include "buffer/chain_buffer.h"
+
+namespace MiniServer {
+
+TEST(ChunkPool, acquire_and_release) {
+  ChunkPool* pool = ChunkPool::get_instance();
+  ChunkPoolStats before = pool->get_stats();
+
+  std::vector<char*> chunks;
+  for (int i = 0; i < 100; i++) {
+    chunks.push_back(pool->acquire());
+  }
+  ChunkPoolStats stats = pool->get_stats();
+  EXPECT_EQ(stats.in_use, before.in_use + 100);
+  EXPECT_GE(stats.high_water, before.in_use + 100);
+  for (char* chunk : chunks) {
+    pool->release(chunk);
+  }
+  stats = pool->get_stats();
+  EXPECT_EQ(stats.in_use, before.in_use);
+
+  // 归还的块被复用,不再向系统申请
+  size_t allocated = stats.allocated;
+  for (int i = 0; i < 100; i++) {
+    chunks[i] = pool->acquire();
+  }
+  EXPECT_EQ(pool->get_stats().allocated, allocated);
+  for (char* chunk : chunks) {
+    pool->release(chunk);
+  }
+}
+
+TEST(ChunkPool, cross_thread) {
+  ChunkPool* pool = ChunkPool::get_instance();
+  size_t in_use = pool->get_stats().in_use;
+  std::vector<char*> chunks(1000);
+  // 一个线程借,另一个线程还
+  std::thread producer([&] {
+    for (auto& chunk : chunks) {
+      chunk = pool->acquire();
+    }
+  });
+  producer.join();
+  std::thread consumer([&] {
+    for (char* chunk : chunks) {
+      pool->release(chunk);
+    }
+  });
+  consumer.join();
+  EXPECT_EQ(pool->get_stats().in_use, in_use);
+}
+
+TEST(ChunkPool, idle_buffers_hold_no_chunks) {
+  ChunkPool* pool = ChunkPool::get_instance();
+  size_t in_use = pool->get_stats().in_use;
+
+  // 没有写入过的缓冲区不占存储
+  std::vector<Buffer> idle(1000);
+  EXPECT_EQ(pool->get_stats().in_use, in_use);
+
+  Buffer buffer;
+  buffer.write_buffer("GET / HTTP/1.1\r\n\r\n");
+  EXPECT_EQ(buffer.capacity(), ChunkPool::CHUNK_SIZE);
+  EXPECT_EQ(pool->get_stats().in_use, in_use + 1);
+  // 超过块大小时改为向系统申请,块还回块池
+  buffer.write_buffer(std::string(ChunkPool::CHUNK_SIZE, 'x'));
+  EXPECT_EQ(pool->get_stats().in_use, in_use);
+  EXPECT_EQ(buffer.get_readable_bytes(), 18 + ChunkPool::CHUNK_SIZE);
+  buffer.release();
+  EXPECT_EQ(buffer.capacity(), 0u);
+
+  ChainBuffer chain;
+  Buffer body;
+  body.write_buffer("hello");
+  chain.append("HTTP/1.1 200 OK\r\n\r\n");
+  chain.append_buffer(body);
+  EXPECT_EQ(pool->get_stats().in_use, in_use + 2);
+  chain.clear();
+  EXPECT_EQ(pool->get_stats().in_use, in_use);
+}
+
+}  // namespace MiniServer
@@ -0,0 +1,161 @@
+#include "buffer/ring_buffer.h"
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+namespace MiniServer {
+
+const std::string input(
+    "Life comes in a package. This package includes happiness and sorrow, "
+    "failure and success, hope and despair. Life is a learning process.");
+
+TEST(RingBuffer, read_and_write) {
+  RingBuffer buffer(5);
+  EXPECT_EQ(buffer.capacity(), 8u);
+
+  buffer.write_buffer(input);
+  EXPECT_EQ(buffer.get_readable_bytes(), input.size());
+  EXPECT_EQ(buffer.read(10), input.substr(0, 10));
+  EXPECT_EQ(buffer.read_all(), input.substr(10));
+  EXPECT_EQ(buffer.get_readable_bytes(), 0u);
+
+  // 写入自己
+  buffer.write_buffer("123456", 6);
+  buffer.write_buffer(buffer);
+  EXPECT_EQ(buffer.read_all(), "123456123456");
+}
+
+TEST(RingBuffer, wrap_around) {
+  RingBuffer buffer(16);
+  buffer.write_buffer("0123456789", 10);
+  buffer.move_read_ptr(8);
+  // 剩 2 字节,再写 12 字节跨过末尾,不扩容也不移动数据
+  buffer.write_buffer("abcdefghijkl", 12);
+  EXPECT_EQ(buffer.capacity(), 16u);
+  EXPECT_EQ(buffer.get_readable_bytes(), 14u);
+  EXPECT_EQ(buffer.get_contiguous_readable_bytes(), 8u);
+
+  struct iovec iov[2];
+  ASSERT_EQ(buffer.get_read_iov(iov), 2);
+  EXPECT_EQ(std::string(static_cast<char*>(iov[0].iov_base), iov[0].iov_len),
+            "89abcdef");
+  EXPECT_EQ(std::string(static_cast<char*>(iov[1].iov_base), iov[1].iov_len),
+            "ghijkl");
+  ASSERT_EQ(buffer.get_write_iov(iov), 1);
+  EXPECT_EQ(iov[0].iov_len, 2u);
+
+  // 满了以后扩容,数据保持顺序
+  buffer.write_buffer("XYZ", 3);
+  EXPECT_EQ(buffer.capacity(), 32u);
+  EXPECT_EQ(buffer.read_all(), "89abcdefghijklXYZ");
+}
+
+TEST(RingBuffer, read_and_write_fd) {
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+  RingBuffer out(16);
+  out.write_buffer("0123456789", 10);
+  out.move_read_ptr(6);
+  out.write_buffer("abcdefghij", 10);
+  int errno_ = 0;
+  // 两段一次 writev 写出
+  EXPECT_EQ(out.write_fd(fds[1], &errno_), 14);
+  EXPECT_EQ(out.get_readable_bytes(), 0u);
+
+  RingBuffer in(8);
+  in.write_buffer("01234", 5);
+  in.move_read_ptr(4);
+  // 可写空间不够预留的大小时先扩容,再直接读入
+  EXPECT_EQ(in.read_fd(fds[0], &errno_), 14);
+  EXPECT_EQ(in.read_all(), "46789abcdefghij");
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST(RingBuffer, adaptive_read_size) {
+  // 大的请求体: 读满后按 FIONREAD 预留,每次扩容最多预留 READ_SIZE_MAX,
+  // 不会一次按整个请求体扩容
+  char path[] = "/tmp/ring_buffer_testXXXXXX";
+  int file = mkstemp(path);
+  ASSERT_GE(file, 0);
+  unlink(path);
+  std::string body;
+  while (body.size() < 512 * 1024) {
+    body += input;
+  }
+  ASSERT_EQ(write(file, body.data(), body.size()),
+            static_cast<ssize_t>(body.size()));
+  lseek(file, 0, SEEK_SET);
+
+  RingBuffer buffer;
+  int errno_ = 0;
+  int reads = 0;
+  size_t readable = 0;
+  ssize_t len;
+  while ((len = buffer.read_fd(file, &errno_)) > 0) {
+    // 容量取整到 2 的幂,最多是需要的两倍
+    EXPECT_LE(buffer.capacity(), 2 * (readable + Buffer::READ_SIZE_MAX));
+    readable = buffer.get_readable_bytes();
+    reads++;
+  }
+  close(file);
+  EXPECT_GT(reads, 2);
+  EXPECT_GT(buffer.get_read_size(), Buffer::READ_SIZE_MIN);
+  EXPECT_EQ(buffer.read_all(), body);
+
+  // 之后一直是小请求,预留的空间逐步缩回最小值
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+  for (int i = 0; i < 20; i++) {
+    ASSERT_EQ(write(fds[1], input.data(), input.size()),
+              static_cast<ssize_t>(input.size()));
+    EXPECT_EQ(buffer.read_fd(fds[0], &errno_),
+              static_cast<ssize_t>(input.size()));
+    EXPECT_EQ(buffer.read_all(), input);
+  }
+  EXPECT_EQ(buffer.get_read_size(), Buffer::READ_SIZE_MIN);
+  close(fds[0]);
+  close(fds[1]);
+}
+
+// 慢速读取: 保持约 60KB 积压,每轮写入并读走 3000 字节
+// Buffer 写到末尾时要整理(复制全部积压)并按需扩容,环形缓冲区只在开始时扩容
+TEST(RingBuffer, benchmark_slow_reader) {
+  const int ROUNDS = 100000;
+  const size_t BACKLOG = 60 * 1024;
+  std::string chunk(3000, 'x');
+
+  auto begin = std::chrono::steady_clock::now();
+  RingBuffer ring(1024);
+  ring.write_buffer(std::string(BACKLOG, 'x'));
+  for (int i = 0; i < ROUNDS; i++) {
+    ring.write_buffer(chunk);
+    ring.move_read_ptr(chunk.size());
+  }
+  auto ring_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     std::chrono::steady_clock::now() - begin)
+                     .count();
+  EXPECT_EQ(ring.get_readable_bytes(), BACKLOG);
+
+  begin = std::chrono::steady_clock::now();
+  Buffer buffer(1024);
+  buffer.write_buffer(std::string(BACKLOG, 'x'));
+  for (int i = 0; i < ROUNDS; i++) {
+    buffer.write_buffer(chunk);
+    buffer.move_read_ptr(chunk.size());
+  }
+  auto buffer_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now() - begin)
+                       .count();
+
+  std::cout << "ring: " << ring_ns / ROUNDS << " ns/round, capacity "
+            << ring.capacity() << std::endl;
+  std::cout << "buffer: " << buffer_ns / ROUNDS << " ns/round" << std::endl;
+}
+
+}  // namespace MiniServer
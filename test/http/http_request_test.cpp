@@ -5,8 +5,11 @@
 #include <gtest/gtest.h>
 #include <stdio.h>
 
+#include <chrono>
 #include <iostream>
+#include <regex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "buffer/buffer.h"
@@ -63,10 +66,13 @@ TEST_F(HttpRequestTest, get) {
   cout << "request path:" << request.get_path() << endl;
 
   cout << "==========request head infomation==========" << endl;
-  auto header = request.get_header();
-  for (auto pair : header) {
-    EXPECT_TRUE(pair.second == request.query_header(pair.first));
-    cout << pair.first << ":" << pair.second << endl;
+  for (size_t i = 0; i < request.get_header_count(); i++) {
+    string name(request.get_header_name(i).data(),
+                request.get_header_name(i).size());
+    string value(request.get_header_value(i).data(),
+                 request.get_header_value(i).size());
+    EXPECT_TRUE(request.query_header(name) == value);
+    cout << name << ":" << value << endl;
   }
 
   cout << "==========get is keep alive==========" << endl;
@@ -94,4 +100,339 @@ TEST_F(HttpRequestTest, post) {
     cout << pair.first << ":" << pair.second.string_value() << endl;
   }
 }
-}
\ No newline at end of file
+
+TEST(HttpRequest, pipelining) {
+  Log::get_instance()->init(LOG_LEVEL::ELL_ERROR, "../data/test/log", ".log",
+                            0);
+  const string get = "GET /index.html HTTP/1.1\r\nHost: localhost\r\n\r\n";
+  const string body = "{\"user\": \"miniserver\"}";
+  const string post =
+      "POST /action/login HTTP/1.1\r\nContent-Type: application/json\r\n"
+      "Content-Length: " +
+      std::to_string(body.size()) + "\r\n\r\n" + body;
+
+  HttpRequest request;
+  Buffer buffer;
+  // 两个完整请求 + 半个请求
+  buffer.write_buffer(get + post + get.substr(0, 10));
+
+  EXPECT_EQ(request.parse(buffer), HttpRequest::PARSE_RESULT::PR_SUCCESS);
+  EXPECT_EQ(request.get_path(), "/index.html");
+  EXPECT_TRUE(request.get_is_keep_alive());
+
+  request.clear();
+  EXPECT_EQ(request.parse(buffer), HttpRequest::PARSE_RESULT::PR_SUCCESS);
+  EXPECT_EQ(request.get_path(), "/action/login");
+  EXPECT_EQ(request.query_post("user").string_value(), "miniserver");
+
+  // 剩下的半个请求保留在缓存中,补齐后可以继续解析
+  request.clear();
+  EXPECT_EQ(request.parse(buffer), HttpRequest::PARSE_RESULT::PR_INCOMPLETE);
+  EXPECT_EQ(buffer.get_readable_bytes(), 10);
+  buffer.write_buffer(get.substr(10));
+  EXPECT_EQ(request.parse(buffer), HttpRequest::PARSE_RESULT::PR_SUCCESS);
+  EXPECT_EQ(request.get_path(), "/index.html");
+  EXPECT_EQ(buffer.get_readable_bytes(), 0);
+}
+
+TEST(HttpRequest, body_framing) {
+  Log::get_instance()->init(LOG_LEVEL::ELL_ERROR, "../data/test/log", ".log",
+                            0);
+  // 请求体看起来像一个请求,按 Content-Length 跳过后不能被当作下一个请求
+  const string body = "GET /admin HTTP/1.1\r\n\r\n";
+  const string get_with_body = "GET /index.html HTTP/1.1\r\nContent-Length: " +
+                               std::to_string(body.size()) + "\r\n\r\n" +
+                               body;
+  const string del = "DELETE /secret HTTP/1.1\r\nContent-Length: 2\r\n\r\nok";
+  const string get = "GET /next HTTP/1.1\r\nContent-Length: 0\r\n\r\n";
+
+  HttpRequest request;
+  Buffer buffer;
+  buffer.write_buffer(get_with_body + del + get);
+
+  EXPECT_EQ(request.parse(buffer), HttpRequest::PARSE_RESULT::PR_SUCCESS);
+  EXPECT_EQ(request.get_path(), "/index.html");
+  EXPECT_EQ(request.get_body(), body);
+
+  request.clear();
+  EXPECT_EQ(request.parse(buffer), HttpRequest::PARSE_RESULT::PR_SUCCESS);
+  EXPECT_EQ(request.get_method(), "DELETE");
+  EXPECT_EQ(request.get_body(), "ok");
+
+  request.clear();
+  EXPECT_EQ(request.parse(buffer), HttpRequest::PARSE_RESULT::PR_SUCCESS);
+  EXPECT_EQ(request.get_path(), "/next");
+  EXPECT_TRUE(request.get_body().empty());
+  EXPECT_EQ(buffer.get_readable_bytes(), 0);
+
+  // 不支持 Transfer-Encoding,和 Content-Length 同时出现时更不能猜测长度
+  const char* bad_requests[] = {
+      "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n"
+      "Content-Length: 3\r\n\r\n0\r\n\r\n",
+      "GET / HTTP/1.1\r\nContent-Length: 0\r\n"
+      "transfer-encoding: chunked\r\n\r\n",
+      "GET / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n0\r\n\r\n",
+  };
+  for (const char* bad : bad_requests) {
+    request.clear();
+    buffer.release();
+    buffer.write_buffer(bad);
+    EXPECT_EQ(request.parse(buffer), HttpRequest::PARSE_RESULT::PR_ERROR)
+        << bad;
+  }
+}
+
+TEST(HttpRequest, views_stay_valid) {
+  Log::get_instance()->init(LOG_LEVEL::ELL_ERROR, "../data/test/log", ".log",
+                            0);
+  const string body = "{\"user\": \"miniserver\"}";
+  const string head =
+      "POST /action/login HTTP/1.1\r\nContent-Type: application/json\r\n"
+      "Content-Length: " +
+      std::to_string(body.size()) + "\r\n\r\n";
+
+  HttpRequest request;
+  Buffer buffer;
+  // 请求体还没到,请求行已经解析
+  buffer.write_buffer(head);
+  EXPECT_EQ(request.parse(buffer), HttpRequest::PARSE_RESULT::PR_INCOMPLETE);
+  EXPECT_TRUE(buffer.is_pinned());
+  StringView path = request.get_path_view();
+  EXPECT_EQ(path, "/action/login");
+
+  // 请求体到达时读缓存扩容,之前的视图仍然有效
+  buffer.write_buffer(body + string(8192, ' '));
+  EXPECT_EQ(request.parse(buffer), HttpRequest::PARSE_RESULT::PR_SUCCESS);
+  EXPECT_EQ(path, "/action/login");
+  EXPECT_EQ(request.get_body(), body);
+
+  // 副本不依赖读缓存
+  HttpRequest copy(request);
+  request.clear();
+  EXPECT_FALSE(buffer.is_pinned());
+  buffer.release();
+  EXPECT_EQ(copy.get_path(), "/action/login");
+  EXPECT_EQ(copy.get_body(), body);
+  EXPECT_EQ(copy.query_post("user").string_value(), "miniserver");
+}
+
+TEST(HttpRequest, request_line_and_headers) {
+  Log::get_instance()->init(LOG_LEVEL::ELL_ERROR, "../data/test/log", ".log",
+                            0);
+  HttpRequest request;
+  Buffer buffer;
+  buffer.write_buffer(
+      "GET /index.html?a=1 HTTP/1.0\r\n"
+      "Host:localhost\r\n"
+      "Connection: \t keep-alive \r\n"
+      "X-Empty:\r\n\r\n");
+  EXPECT_EQ(request.parse(buffer), HttpRequest::PARSE_RESULT::PR_SUCCESS);
+  EXPECT_EQ(request.get_method(), "GET");
+  EXPECT_EQ(request.get_path(), "/index.html?a=1");
+  EXPECT_EQ(request.get_version(), "1.0");
+  EXPECT_EQ(request.query_header("Host"), "localhost");
+  EXPECT_EQ(request.query_header("Connection"), "keep-alive");
+  EXPECT_EQ(request.query_header("X-Empty"), "");
+  EXPECT_TRUE(request.get_is_keep_alive());
+
+  const char* bad_requests[] = {
+      "GET  /index.html HTTP/1.1\r\n\r\n",
+      "GET /index.html\r\n\r\n",
+      "GET /index.html HTTP/\r\n\r\n",
+      "GET /index.html HTTQ/1.1\r\n\r\n",
+      "G(T / HTTP/1.1\r\n\r\n",
+      "GET / HTTP/1.1\r\nHost : localhost\r\n\r\n",
+      "GET / HTTP/1.1\r\n: localhost\r\n\r\n",
+      "GET / HTTP/1.1\r\nHost localhost\r\n\r\n",
+      "GET / HTTP/1.1\r\nHost: local\x01host\r\n\r\n",
+  };
+  for (const char* bad : bad_requests) {
+    request.clear();
+    buffer.release();
+    buffer.write_buffer(bad);
+    EXPECT_EQ(request.parse(buffer), HttpRequest::PARSE_RESULT::PR_ERROR)
+        << bad;
+  }
+}
+
+TEST(HttpRequest, header_lookup) {
+  Log::get_instance()->init(LOG_LEVEL::ELL_ERROR, "../data/test/log", ".log",
+                            0);
+  HttpRequest request;
+  Buffer buffer;
+  buffer.write_buffer(
+      "POST /echo HTTP/1.1\r\n"
+      "host: localhost\r\n"
+      "X-Trace-Id: abc\r\n"
+      "content-type: Application/JSON\r\n"
+      "Content-Length: 2\r\n"
+      "x-trace-id: def\r\n"
+      "\r\n{}");
+  EXPECT_EQ(request.parse(buffer), HttpRequest::PARSE_RESULT::PR_SUCCESS);
+  EXPECT_EQ(request.get_header_count(), 5u);
+  EXPECT_EQ(request.get_header_name(2), "content-type");
+
+  // 常用的请求头按 HEADER_KEY 或任意大小写的名称查找
+  EXPECT_EQ(HttpRequest::intern_header("CONTENT-LENGTH"),
+            HttpRequest::HK_CONTENT_LENGTH);
+  EXPECT_EQ(HttpRequest::intern_header("X-Trace-Id"), HttpRequest::HK_UNKNOWN);
+  EXPECT_EQ(request.query_header(HttpRequest::HK_HOST), "localhost");
+  EXPECT_EQ(request.query_header("Host"), "localhost");
+  EXPECT_EQ(request.query_header("content-length"), "2");
+  EXPECT_TRUE(request.get_post().is_object());
+  // 其他请求头按名称比较,同名时取最后一个
+  EXPECT_EQ(request.query_header("X-TRACE-ID"), "def");
+  EXPECT_TRUE(request.query_header("Cookie").empty());
+
+  HttpRequest copy(request);
+  request.clear();
+  buffer.release();
+  EXPECT_EQ(copy.query_header(HttpRequest::HK_CONTENT_TYPE),
+            "Application/JSON");
+  EXPECT_EQ(copy.query_header("x-trace-id"), "def");
+
+  // Content-Length 不是数字或多次出现且不同时拒绝
+  const char* bad_requests[] = {
+      "POST / HTTP/1.1\r\nContent-Length: 1x\r\n\r\n{}",
+      "POST / HTTP/1.1\r\nContent-Length: \r\n\r\n{}",
+      "POST / HTTP/1.1\r\nContent-Length: 99999999999999999999999\r\n\r\n",
+      "POST / HTTP/1.1\r\nContent-Length: 2\r\ncontent-length: 3\r\n\r\n{}",
+  };
+  for (const char* bad : bad_requests) {
+    request.clear();
+    buffer.release();
+    buffer.write_buffer(bad);
+    EXPECT_EQ(request.parse(buffer), HttpRequest::PARSE_RESULT::PR_ERROR)
+        << bad;
+  }
+}
+
+TEST(HttpRequest, size_limits) {
+  Log::get_instance()->init(LOG_LEVEL::ELL_ERROR, "../data/test/log", ".log",
+                            0);
+  HttpRequest request;
+  Buffer buffer;
+  // 请求头分多次到达,结尾的 CRLFCRLF 跨过两次到达的数据
+  buffer.write_buffer("GET / HTTP/1.1\r\nHost: localhost\r");
+  EXPECT_EQ(request.parse(buffer), HttpRequest::PARSE_RESULT::PR_INCOMPLETE);
+  request.init();
+  buffer.write_buffer("\n\r");
+  EXPECT_EQ(request.parse(buffer), HttpRequest::PARSE_RESULT::PR_INCOMPLETE);
+  request.init();
+  buffer.write_buffer("\n");
+  EXPECT_EQ(request.parse(buffer), HttpRequest::PARSE_RESULT::PR_SUCCESS);
+  EXPECT_EQ(request.query_header(HttpRequest::HK_HOST), "localhost");
+
+  // 一直不结束的请求头超过上限后拒绝
+  request.clear();
+  buffer.release();
+  buffer.write_buffer("GET / HTTP/1.1\r\n");
+  HttpRequest::PARSE_RESULT result = HttpRequest::PARSE_RESULT::PR_INCOMPLETE;
+  const string header = "X-Padding: " + string(100, 'x') + "\r\n";
+  while (result == HttpRequest::PARSE_RESULT::PR_INCOMPLETE &&
+         buffer.get_readable_bytes() <= 2 * HttpRequest::HEADER_SIZE_MAX) {
+    buffer.write_buffer(header);
+    result = request.parse(buffer);
+  }
+  EXPECT_EQ(result, HttpRequest::PARSE_RESULT::PR_ERROR);
+  EXPECT_EQ(request.get_error_code(), 431);
+  EXPECT_LE(buffer.get_readable_bytes(),
+            HttpRequest::HEADER_SIZE_MAX + header.size());
+
+  // 请求体超过上限时不等待请求体,直接拒绝
+  const size_t body_size_max = HttpRequest::get_body_size_max();
+  HttpRequest::set_body_size_max(16);
+  request.clear();
+  buffer.release();
+  buffer.write_buffer("PUT / HTTP/1.1\r\nContent-Length: 16\r\n\r\n");
+  EXPECT_EQ(request.parse(buffer), HttpRequest::PARSE_RESULT::PR_INCOMPLETE);
+  request.clear();
+  buffer.release();
+  buffer.write_buffer("PUT / HTTP/1.1\r\nContent-Length: 17\r\n\r\n");
+  EXPECT_EQ(request.parse(buffer), HttpRequest::PARSE_RESULT::PR_ERROR);
+  EXPECT_EQ(request.get_error_code(), 413);
+  HttpRequest::set_body_size_max(body_size_max);
+}
+
+// 原来基于正则的请求行和请求头解析,用于对比
+static bool regex_parse(const string& head) {
+  std::regex pattern("^([^ ]*) ([^ ]*) HTTP/([^ ]*)$");
+  std::smatch match;
+  size_t begin = 0;
+  size_t end = head.find("\r\n");
+  string line = head.substr(begin, end - begin);
+  if (!std::regex_match(line, match, pattern)) {
+    return false;
+  }
+  std::unordered_map<string, string> header;
+  while (true) {
+    begin = end + 2;
+    end = head.find("\r\n", begin);
+    line = head.substr(begin, end - begin);
+    if (line.empty()) {
+      return true;
+    }
+    std::regex pattern_header("^([^:]*): ?(.*)$");
+    if (!std::regex_match(line, match, pattern_header)) {
+      return false;
+    }
+    header[match[1]] = match[2];
+  }
+}
+
+TEST(HttpRequest, benchmark_parse) {
+  Log::get_instance()->init(LOG_LEVEL::ELL_ERROR, "../data/test/log", ".log",
+                            0);
+  // 浏览器经过反向代理后的典型请求
+  const string get =
+      "GET /static/js/app.3f2a1c.js?v=20230315 HTTP/1.1\r\n"
+      "Host: www.example.com\r\n"
+      "Connection: keep-alive\r\n"
+      "sec-ch-ua: \"Chromium\";v=\"112\", \"Google Chrome\";v=\"112\"\r\n"
+      "sec-ch-ua-mobile: ?0\r\n"
+      "User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64) "
+      "AppleWebKit/537.36 (KHTML, like Gecko) Chrome/112.0.0.0 "
+      "Safari/537.36\r\n"
+      "sec-ch-ua-platform: \"Windows\"\r\n"
+      "Accept: */*\r\n"
+      "Sec-Fetch-Site: same-origin\r\n"
+      "Sec-Fetch-Mode: no-cors\r\n"
+      "Sec-Fetch-Dest: script\r\n"
+      "Referer: https://www.example.com/index.html\r\n"
+      "Accept-Encoding: gzip, deflate, br\r\n"
+      "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+      "Cookie: session_id=8c1f2e3d4b5a69788796a5b4c3d2e1f0; "
+      "theme=dark; _ga=GA1.2.1234567890.1678888888\r\n"
+      "X-Forwarded-For: 203.0.113.195, 70.41.3.18\r\n"
+      "X-Forwarded-Proto: https\r\n"
+      "X-Real-IP: 203.0.113.195\r\n"
+      "\r\n";
+
+  const int ROUNDS = 100000;
+  HttpRequest request;
+  Buffer buffer;
+  auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < ROUNDS; i++) {
+    buffer.write_buffer(get);
+    ASSERT_EQ(request.parse(buffer), HttpRequest::PARSE_RESULT::PR_SUCCESS);
+    request.clear();
+  }
+  auto parser_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now() - begin)
+                       .count();
+  EXPECT_EQ(buffer.get_readable_bytes(), 0u);
+
+  // 正则太慢,只跑一部分
+  const int REGEX_ROUNDS = ROUNDS / 1000;
+  begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < REGEX_ROUNDS; i++) {
+    ASSERT_TRUE(regex_parse(get));
+  }
+  auto regex_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now() - begin)
+                      .count();
+
+  cout << "parser: " << parser_ns / ROUNDS << " ns/request" << endl;
+  cout << "regex: " << regex_ns / REGEX_ROUNDS << " ns/request" << endl;
+}
+}
@@ -35,12 +35,11 @@ namespace MiniServer
         HttpResponse response;
         response.init("../data/test/http/", "response_resource.txt", false, 200);
 
-        Buffer buff;
+        ChainBuffer buff;
 
         response.make_response(request, buff);
 
-        cout << buff.read_all() << endl;
-        cout << response.get_file() << endl;
+        cout << buff.to_string() << endl;
     }
 
     TEST_F(HttpResponseTest, failure)
@@ -48,12 +47,11 @@ namespace MiniServer
         HttpResponse response;
         response.init("../data/test/http/", "response_error.txt", false, 200);
 
-        Buffer buff;
+        ChainBuffer buff;
 
         response.make_response(request, buff);
 
-        cout << buff.read_all() << endl;
-        cout << response.get_file() << endl;
+        cout << buff.to_string() << endl;
     }
 
 }
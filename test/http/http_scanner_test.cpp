@@ -0,0 +1,104 @@
+#include "http/http_scanner.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace MiniServer {
+
+// CPU 支持的所有级别
+static std::vector<HttpScanner::SCAN_LEVEL> supported_levels() {
+  std::vector<HttpScanner::SCAN_LEVEL> levels;
+  for (int level = HttpScanner::SL_SCALAR;
+       level <= HttpScanner::get_best_level(); level++) {
+    levels.push_back(static_cast<HttpScanner::SCAN_LEVEL>(level));
+  }
+  return levels;
+}
+
+TEST(HttpScanner, levels_match_scalar) {
+  const HttpScanner::SCAN_LEVEL best = HttpScanner::get_best_level();
+  std::cout << "best level: " << HttpScanner::get_level_name(best)
+            << std::endl;
+  EXPECT_EQ(HttpScanner::get_level(), best);
+
+  // 每个字节值放在不同长度的合法数据中的每个位置,结果与逐字节扫描一致
+  const std::string token(80, 'a');
+  const std::string value(80, ' ');
+  for (HttpScanner::SCAN_LEVEL level : supported_levels()) {
+    for (int c = 0; c < 256; c++) {
+      for (size_t len = 1; len <= token.size(); len += 7) {
+        for (size_t pos = 0; pos < len; pos++) {
+          std::string data = token.substr(0, len);
+          data[pos] = static_cast<char>(c);
+          const char* begin = data.data();
+          const char* end = begin + len;
+
+          ASSERT_TRUE(HttpScanner::set_level(HttpScanner::SL_SCALAR));
+          const char* token_end = HttpScanner::scan_token(begin, end);
+          const char* target_end = HttpScanner::scan_target(begin, end);
+          ASSERT_TRUE(HttpScanner::set_level(level));
+          ASSERT_EQ(HttpScanner::scan_token(begin, end), token_end)
+              << HttpScanner::get_level_name(level) << " " << c;
+          ASSERT_EQ(HttpScanner::scan_target(begin, end), target_end)
+              << HttpScanner::get_level_name(level) << " " << c;
+          EXPECT_EQ(token_end == begin + pos, !HttpScanner::is_token_char(c));
+
+          data = value.substr(0, len);
+          data[pos] = static_cast<char>(c);
+          begin = data.data();
+          end = begin + len;
+          ASSERT_TRUE(HttpScanner::set_level(HttpScanner::SL_SCALAR));
+          const char* value_end = HttpScanner::scan_value(begin, end);
+          ASSERT_TRUE(HttpScanner::set_level(level));
+          ASSERT_EQ(HttpScanner::scan_value(begin, end), value_end)
+              << HttpScanner::get_level_name(level) << " " << c;
+        }
+      }
+    }
+  }
+  HttpScanner::set_level(best);
+}
+
+TEST(HttpScanner, find_header_end) {
+  std::string head = "GET / HTTP/1.1\r\nHost: a\r\n\r\nGET";
+  const char* begin = head.data();
+  const char* end = begin + head.size();
+  EXPECT_EQ(HttpScanner::find_header_end(begin, end), begin + 23);
+  EXPECT_EQ(HttpScanner::find_header_end(begin, begin + 26), nullptr);
+  EXPECT_EQ(HttpScanner::find_header_end(begin, begin + 27), begin + 23);
+  EXPECT_EQ(HttpScanner::find_header_end(begin, begin + 3), nullptr);
+}
+
+TEST(HttpScanner, benchmark) {
+  // 经过多层代理后的请求头的值
+  std::string line =
+      "X-Forwarded-For: 203.0.113.195, 70.41.3.18, 150.172.238.178, "
+      "198.51.100.17, 192.0.2.44\r\n";
+  const int ROUNDS = 200000;
+  const HttpScanner::SCAN_LEVEL best = HttpScanner::get_best_level();
+  for (HttpScanner::SCAN_LEVEL level : supported_levels()) {
+    HttpScanner::set_level(level);
+    const char* begin = line.data();
+    const char* end = begin + line.size();
+    size_t total = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ROUNDS; i++) {
+      const char* name_end = HttpScanner::scan_token(begin, end);
+      const char* line_end = HttpScanner::scan_value(name_end + 2, end);
+      total += line_end - name_end;
+    }
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+    EXPECT_EQ(total, static_cast<size_t>(ROUNDS) * (line.size() - 17));
+    std::cout << HttpScanner::get_level_name(level) << ": " << ns / ROUNDS
+              << " ns/line" << std::endl;
+  }
+  HttpScanner::set_level(best);
+}
+
+}  // namespace MiniServer
@@ -4,8 +4,11 @@
 #include <fcntl.h>
 #include <gtest/gtest.h>
 #include <stdio.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
 #include <unistd.h>
 
+#include <chrono>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -70,4 +73,355 @@ namespace MiniServer
         EXPECT_TRUE(mux.get_active_fd(0) == pipe_fds[0]);
         EXPECT_TRUE(mux.get_active_events(0) & EPOLLIN);
     }
-}
\ No newline at end of file
+}
+namespace MiniServer
+{
+
+    // 与上面相同的管道读事件,使用 io_uring 实现
+    TEST(MuxUringTest, oneshot)
+    {
+        Mux mux(512, MUX_URING);
+        if (mux.get_backend() != MUX_URING)
+        {
+            GTEST_SKIP() << "io_uring is unavailable";
+        }
+
+        int pipe_fds[2];
+        ASSERT_EQ(pipe(pipe_fds), 0);
+        uint32_t base_events = EPOLLONESHOT | EPOLLET | EPOLLHUP;
+
+        EXPECT_TRUE(mux.add_fd(pipe_fds[0], base_events | EPOLLIN));
+        write(pipe_fds[1], "hello", 5);
+        EXPECT_EQ(mux.wait(100), 1);
+        EXPECT_EQ(mux.get_active_fd(0), pipe_fds[0]);
+        EXPECT_TRUE(mux.get_active_events(0) & EPOLLIN);
+
+        // ONESHOT 触发后不再通知,直到重新注册
+        write(pipe_fds[1], "hello", 5);
+        EXPECT_EQ(mux.wait(50), 0);
+        EXPECT_TRUE(mux.mod_fd(pipe_fds[0], base_events | EPOLLIN));
+        EXPECT_EQ(mux.wait(100), 1);
+
+        // 删除后不再通知
+        EXPECT_TRUE(mux.mod_fd(pipe_fds[0], base_events | EPOLLIN));
+        EXPECT_TRUE(mux.del_fd(pipe_fds[0]));
+        EXPECT_EQ(mux.wait(50), 0);
+
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+    }
+
+    // 完成模式: multishot accept 直接返回新连接, multishot recv 直接返回数据
+    TEST(MuxUringTest, completion)
+    {
+        Mux mux(512, MUX_URING);
+        if (!mux.has_completion())
+        {
+            GTEST_SKIP() << "io_uring completion is unavailable";
+        }
+
+        int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        ASSERT_GE(listen_fd, 0);
+        struct sockaddr_in addr = {0};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        ASSERT_EQ(bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)), 0);
+        socklen_t len = sizeof(addr);
+        ASSERT_EQ(getsockname(listen_fd, (struct sockaddr *)&addr, &len), 0);
+        ASSERT_EQ(listen(listen_fd, 16), 0);
+        EXPECT_TRUE(mux.add_accept(listen_fd, 1));
+
+        // 连续两个连接,注册一次都能收到
+        int clients[2];
+        int conns[2];
+        for (int i = 0; i < 2; i++)
+        {
+            clients[i] = socket(AF_INET, SOCK_STREAM, 0);
+            ASSERT_EQ(connect(clients[i], (struct sockaddr *)&addr, sizeof(addr)), 0);
+            ASSERT_EQ(mux.wait(1000), 1);
+            EXPECT_EQ(mux.get_active_token(0), 1u);
+            EXPECT_EQ(mux.get_active_completion(0), MC_ACCEPT);
+            conns[i] = mux.get_active_result(0);
+            ASSERT_GE(conns[i], 0);
+        }
+
+        EXPECT_TRUE(mux.add_recv(conns[0], 2));
+        for (int i = 0; i < 3; i++)
+        {
+            string message = "hello " + std::to_string(i);
+            ASSERT_EQ(write(clients[0], message.data(), message.size()), (ssize_t)message.size());
+            ASSERT_EQ(mux.wait(1000), 1);
+            EXPECT_EQ(mux.get_active_token(0), 2u);
+            ASSERT_EQ(mux.get_active_completion(0), MC_RECV);
+            ASSERT_EQ(mux.get_active_result(0), (int)message.size());
+            EXPECT_EQ(string(mux.get_active_data(0), message.size()), message);
+        }
+
+        // recv 仍在内核中时可以同时等待可写
+        EXPECT_TRUE(mux.mod_fd(conns[0], EPOLLONESHOT | EPOLLOUT, 3));
+        ASSERT_EQ(mux.wait(1000), 1);
+        EXPECT_EQ(mux.get_active_token(0), 3u);
+        EXPECT_EQ(mux.get_active_completion(0), MC_READY);
+        EXPECT_TRUE(mux.get_active_events(0) & EPOLLOUT);
+
+        // 对端关闭时结果为 0
+        close(clients[0]);
+        ASSERT_EQ(mux.wait(1000), 1);
+        EXPECT_EQ(mux.get_active_completion(0), MC_RECV);
+        EXPECT_EQ(mux.get_active_result(0), 0);
+        EXPECT_TRUE(mux.del_fd(conns[0]));
+        close(conns[0]);
+
+        // 删除后取消 recv, 对端收到 EOF
+        EXPECT_TRUE(mux.add_recv(conns[1], 4));
+        EXPECT_TRUE(mux.del_fd(conns[1]));
+        close(conns[1]);
+        write(clients[1], "x", 1);
+        EXPECT_EQ(mux.wait(100), 0);
+        char c;
+        EXPECT_EQ(read(clients[1], &c, 1), 0);
+        close(clients[1]);
+
+        mux.del_fd(listen_fd);
+        close(listen_fd);
+    }
+
+    // 对比两种实现: 多个 socketpair 轮流收发 1 字节,每次读完后用 ONESHOT 重新注册
+    TEST(MuxBenchmark, epoll_vs_uring)
+    {
+        const int pair_num = 64;
+        const int rounds = 2000;
+        const MUX_BACKEND backends[] = {MUX_EPOLL, MUX_URING};
+
+        for (MUX_BACKEND backend : backends)
+        {
+            Mux mux(512, backend);
+            if (mux.get_backend() != backend)
+            {
+                cout << "io_uring is unavailable, skip" << endl;
+                continue;
+            }
+
+            std::vector<std::pair<int, int>> pairs(pair_num);
+            uint32_t events = EPOLLONESHOT | EPOLLET | EPOLLRDHUP | EPOLLIN;
+            for (auto &p : pairs)
+            {
+                int fds[2];
+                ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+                p = {fds[0], fds[1]};
+                mux.add_fd(p.first, events);
+            }
+
+            uint64_t syscall_begin = mux.get_syscall_count();
+            auto begin = std::chrono::steady_clock::now();
+            char c = 'x';
+            for (int r = 0; r < rounds; r++)
+            {
+                for (auto &p : pairs)
+                {
+                    ::write(p.second, &c, 1);
+                }
+                int received = 0;
+                while (received < pair_num)
+                {
+                    int n = mux.wait(1000);
+                    ASSERT_GT(n, 0);
+                    for (int i = 0; i < n; i++)
+                    {
+                        int fd = mux.get_active_fd(i);
+                        ASSERT_TRUE(mux.get_active_events(i) & EPOLLIN);
+                        ::read(fd, &c, 1);
+                        mux.mod_fd(fd, events);
+                    }
+                    received += n;
+                }
+            }
+            auto end = std::chrono::steady_clock::now();
+            uint64_t syscalls = mux.get_syscall_count() - syscall_begin;
+            long long us = std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count();
+
+            cout << (backend == MUX_EPOLL ? "epoll   " : "io_uring")
+                 << " events: " << rounds * pair_num
+                 << " time(us): " << us
+                 << " mux syscalls: " << syscalls
+                 << " syscalls/event: " << (double)syscalls / (rounds * pair_num)
+                 << endl;
+
+            for (auto &p : pairs)
+            {
+                mux.del_fd(p.first);
+                close(p.first);
+                close(p.second);
+            }
+        }
+    }
+
+    // 接近服务器的负载: TCP 连接的 accept 和 256 字节请求的接收
+    //   就绪通知: wait 之后 accept/read,再用 ONESHOT 重新注册
+    //   完成模式: multishot accept/recv,新连接和数据随事件返回
+    // 系统调用包括 mux 的调用和 accept/read
+    TEST(MuxBenchmark, readiness_vs_completion)
+    {
+        const int conn_num = 64;
+        const int rounds = 1000;
+        const string request(256, 'x');
+
+        for (int completion = 0; completion < 2; completion++)
+        {
+            Mux mux(512, MUX_URING);
+            if (completion ? !mux.has_completion() : mux.get_backend() != MUX_URING)
+            {
+                cout << "io_uring is unavailable, skip" << endl;
+                continue;
+            }
+
+            int listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+            ASSERT_GE(listen_fd, 0);
+            struct sockaddr_in addr = {0};
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            ASSERT_EQ(bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)), 0);
+            socklen_t len = sizeof(addr);
+            ASSERT_EQ(getsockname(listen_fd, (struct sockaddr *)&addr, &len), 0);
+            ASSERT_EQ(listen(listen_fd, conn_num), 0);
+
+            uint64_t syscalls = 0;
+            uint64_t syscall_begin = mux.get_syscall_count();
+            auto begin = std::chrono::steady_clock::now();
+            uint32_t events = EPOLLONESHOT | EPOLLRDHUP | EPOLLIN;
+            if (completion)
+            {
+                mux.add_accept(listen_fd, listen_fd);
+            }
+            else
+            {
+                mux.add_fd(listen_fd, EPOLLIN, listen_fd);
+            }
+
+            std::vector<int> clients(conn_num);
+            for (int &client : clients)
+            {
+                client = socket(AF_INET, SOCK_STREAM, 0);
+                ASSERT_EQ(connect(client, (struct sockaddr *)&addr, sizeof(addr)), 0);
+            }
+            std::vector<int> conns;
+            while ((int)conns.size() < conn_num)
+            {
+                int n = mux.wait(1000);
+                ASSERT_GT(n, 0);
+                for (int i = 0; i < n; i++)
+                {
+                    int fd = completion ? mux.get_active_result(i) : -1;
+                    while (!completion)
+                    {
+                        syscalls++;
+                        int accepted = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK);
+                        if (accepted < 0)
+                        {
+                            break;
+                        }
+                        conns.push_back(accepted);
+                        mux.add_fd(accepted, events, accepted);
+                    }
+                    if (completion)
+                    {
+                        ASSERT_GE(fd, 0);
+                        conns.push_back(fd);
+                        mux.add_recv(fd, fd);
+                    }
+                }
+            }
+
+            Buffer buffer;
+            for (int r = 0; r < rounds; r++)
+            {
+                for (int client : clients)
+                {
+                    ASSERT_EQ(::write(client, request.data(), request.size()), (ssize_t)request.size());
+                }
+                size_t received = 0;
+                while (received < request.size() * conn_num)
+                {
+                    int n = mux.wait(1000);
+                    ASSERT_GT(n, 0);
+                    for (int i = 0; i < n; i++)
+                    {
+                        int fd = static_cast<int>(mux.get_active_token(i));
+                        if (completion)
+                        {
+                            ASSERT_EQ(mux.get_active_completion(i), MC_RECV);
+                            ASSERT_GT(mux.get_active_result(i), 0);
+                            buffer.write_buffer(mux.get_active_data(i), mux.get_active_result(i));
+                            received += mux.get_active_result(i);
+                            continue;
+                        }
+                        int errno_;
+                        ssize_t ret;
+                        while ((ret = buffer.read_fd(fd, &errno_)) > 0)
+                        {
+                            syscalls++;
+                            received += ret;
+                        }
+                        syscalls++;
+                        mux.mod_fd(fd, events, fd);
+                    }
+                    buffer.clear();
+                }
+            }
+            auto end = std::chrono::steady_clock::now();
+            syscalls += mux.get_syscall_count() - syscall_begin;
+            long long us = std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count();
+
+            cout << (completion ? "completion" : "readiness ")
+                 << " requests: " << rounds * conn_num
+                 << " time(us): " << us
+                 << " syscalls: " << syscalls
+                 << " syscalls/request: " << (double)syscalls / (rounds * conn_num)
+                 << endl;
+
+            for (int i = 0; i < conn_num; i++)
+            {
+                mux.del_fd(conns[i]);
+                close(conns[i]);
+                close(clients[i]);
+            }
+            mux.del_fd(listen_fd);
+            close(listen_fd);
+        }
+    }
+}
+
+namespace MiniServer
+{
+
+    // 注册时携带的标记在事件触发时原样返回
+    TEST(MuxTokenTest, token)
+    {
+        const MUX_BACKEND backends[] = {MUX_EPOLL, MUX_URING};
+        for (MUX_BACKEND backend : backends)
+        {
+            Mux mux(512, backend);
+            int pipe_fds[2];
+            ASSERT_EQ(pipe(pipe_fds), 0);
+
+            uint64_t object = 0;
+            mux_token token = make_mux_token(&object, 5);
+            EXPECT_EQ(get_token_type(token), 5u);
+            EXPECT_EQ(get_token_ptr<uint64_t>(token), &object);
+
+            EXPECT_TRUE(mux.add_fd(pipe_fds[0], EPOLLONESHOT | EPOLLIN, token));
+            write(pipe_fds[1], "hello", 5);
+            ASSERT_EQ(mux.wait(100), 1);
+            EXPECT_EQ(mux.get_active_token(0), token);
+
+            // mod_fd 可以换成新的标记
+            mux_token new_token = make_mux_token(&object, 2);
+            EXPECT_TRUE(mux.mod_fd(pipe_fds[0], EPOLLONESHOT | EPOLLIN, new_token));
+            ASSERT_EQ(mux.wait(100), 1);
+            EXPECT_EQ(mux.get_active_token(0), new_token);
+
+            close(pipe_fds[0]);
+            close(pipe_fds[1]);
+        }
+    }
+}
@@ -0,0 +1,51 @@
+#include "pool/blocking_executor.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace MiniServer {
+
+TEST(BlockingExecutorTest, run_and_drain) {
+  std::atomic<int> count(0);
+  {
+    BlockingExecutor executor(2);
+    EXPECT_EQ(executor.get_thread_count(), 2u);
+    for (int i = 0; i < 20; i++) {
+      executor.AddTask([&count] {
+        // 模拟等待数据库
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        count++;
+      });
+    }
+    EXPECT_EQ(executor.get_submit_count(), 20u);
+    EXPECT_GT(executor.get_max_pending(), 0u);
+  }
+  // 析构时执行完所有已提交的任务
+  EXPECT_EQ(count.load(), 20);
+}
+
+TEST(BlockingExecutorTest, parallel) {
+  BlockingExecutor executor(4);
+  std::atomic<int> count(0);
+  auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < 4; i++) {
+    executor.AddTask([&count] {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      count++;
+    });
+  }
+  while (count.load() < 4) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                     std::chrono::steady_clock::now() - begin)
+                     .count();
+  // 阻塞的任务在各自的线程中同时等待
+  EXPECT_LT(elapsed, 300);
+  EXPECT_EQ(executor.get_execute_count(), 4u);
+}
+
+}  // namespace MiniServer
@@ -0,0 +1,214 @@
+#include "pool/task.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <queue>
+
+#include "pool/thread_pool.h"
+
+using std::cout;
+using std::endl;
+
+namespace MiniServer {
+
+// 与 Server::deal_read_conn_ 中提交的任务形状相同
+struct FakeServer {
+  void on_read(void* loop, void* client, uint32_t generation) {
+    sum += reinterpret_cast<uintptr_t>(loop) + reinterpret_cast<uintptr_t>(client) +
+           generation;
+  }
+  uintptr_t sum = 0;
+};
+
+// 探针可调用对象: 类内 operator new 统计 Task 放到堆上的次数,移动构造统计搬动次数
+// 不替换全局分配器,std::vector 等其他分配不计入
+template <size_t N>
+struct Probe {
+  static int heap_count;
+  static int move_count;
+
+  Probe(uintptr_t* sum, uintptr_t value) : sum(sum), value(value) {}
+  Probe(const Probe&) = default;
+  Probe(Probe&& other) noexcept : sum(other.sum), value(other.value) {
+    move_count++;
+  }
+  static void* operator new(size_t size) {
+    heap_count++;
+    return ::operator new(size);
+  }
+  static void operator delete(void* p) { ::operator delete(p); }
+  void operator()() { *sum += value; }
+
+  uintptr_t* sum;
+  uintptr_t value;
+  char pad[N];
+};
+template <size_t N>
+int Probe<N>::heap_count = 0;
+template <size_t N>
+int Probe<N>::move_count = 0;
+
+// 与 bind(&Server::on_read_, ...) 同样大小
+using SmallProbe = Probe<32>;
+using BigProbe = Probe<128>;
+
+TEST(TaskTest, inline_and_heap) {
+  FakeServer server;
+  auto bind_task =
+      std::bind(&FakeServer::on_read, &server, (void*)1, (void*)2, 3u);
+  EXPECT_LE(sizeof(bind_task), Task::INLINE_SIZE);
+  EXPECT_TRUE(Task::is_inline<decltype(bind_task)>());
+  Task bound(bind_task);
+  bound();
+  EXPECT_EQ(server.sum, 6u);
+
+  // 内联存放: 不分配,移动 Task 时搬动可调用对象本身
+  uintptr_t sum = 0;
+  EXPECT_TRUE(Task::is_inline<SmallProbe>());
+  SmallProbe::heap_count = 0;
+  SmallProbe::move_count = 0;
+  Task task(SmallProbe(&sum, 1));
+  EXPECT_EQ(SmallProbe::move_count, 1);
+  Task moved(std::move(task));
+  EXPECT_FALSE(static_cast<bool>(task));
+  EXPECT_EQ(SmallProbe::move_count, 2);
+  moved();
+  EXPECT_EQ(SmallProbe::heap_count, 0);
+  EXPECT_EQ(sum, 1u);
+
+  // 超过大小的放到堆上,只分配一次,移动 Task 只搬指针
+  EXPECT_FALSE(Task::is_inline<BigProbe>());
+  BigProbe::heap_count = 0;
+  BigProbe::move_count = 0;
+  Task heap_task(BigProbe(&sum, 2));
+  EXPECT_EQ(BigProbe::heap_count, 1);
+  Task heap_moved;
+  heap_moved = std::move(heap_task);
+  EXPECT_EQ(BigProbe::move_count, 1);
+  heap_moved();
+  EXPECT_EQ(BigProbe::heap_count, 1);
+  EXPECT_EQ(sum, 3u);
+}
+
+TEST(TaskTest, move_only_and_destroy) {
+  auto value = std::make_shared<int>(0);
+  {
+    // 只能移动的可调用对象
+    std::unique_ptr<int> owned(new int(5));
+    Task task([owned = std::move(owned), value] { *value += *owned; });
+    EXPECT_EQ(value.use_count(), 2);
+    TaskQueue queue(2);
+    queue.push(std::move(task));
+    Task out;
+    ASSERT_TRUE(queue.pop(out));
+    out();
+    EXPECT_FALSE(queue.pop(out));
+  }
+  // 所有副本都已析构
+  EXPECT_EQ(*value, 5);
+  EXPECT_EQ(value.use_count(), 1);
+}
+
+TEST(TaskTest, queue_wrap_and_grow) {
+  TaskQueue queue(4);
+  std::vector<int> order;
+  int next = 0;
+  for (int round = 0; round < 3; round++) {
+    for (int i = 0; i < 3; i++) {
+      int id = next++;
+      queue.push(Task([&order, id] { order.push_back(id); }));
+    }
+    Task task;
+    for (int i = 0; i < 3; i++) {
+      ASSERT_TRUE(queue.pop(task));
+      task();
+    }
+  }
+  // 下标绕回,没有扩容
+  EXPECT_EQ(queue.capacity(), 4u);
+  // 超过容量时扩容,保持先进先出
+  for (int i = 0; i < 10; i++) {
+    int id = next++;
+    queue.push(Task([&order, id] { order.push_back(id); }));
+  }
+  Task task;
+  while (queue.pop(task)) {
+    task();
+  }
+  ASSERT_EQ(order.size(), 19u);
+  for (int i = 0; i < 19; i++) {
+    EXPECT_EQ(order[i], i);
+  }
+}
+
+TEST(TaskTest, thread_pool) {
+  std::atomic<int> count(0);
+  ThreadPool pool(4);
+  for (int i = 0; i < 1000; i++) {
+    pool.AddTask([&count] { count++; });
+  }
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (count.load() < 1000 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::yield();
+  }
+  EXPECT_EQ(count.load(), 1000);
+}
+
+// 对比 std::queue<std::function> 与 TaskQueue<Task> 入队出队的耗时
+TEST(TaskTest, benchmark_enqueue_dequeue) {
+  const int task_num = 1000000;
+  // 队列中同时存在的任务数,模拟线程池积压
+  const int depth = 64;
+  FakeServer server;
+
+  {
+    std::queue<std::function<void()>> queue;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < task_num; i++) {
+      queue.emplace(std::bind(&FakeServer::on_read, &server, (void*)1,
+                              (void*)2, (uint32_t)i));
+      if (queue.size() >= depth) {
+        auto task = std::move(queue.front());
+        queue.pop();
+        task();
+      }
+    }
+    auto end = std::chrono::steady_clock::now();
+    cout << "std::function queue: "
+         << std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin)
+                    .count() /
+                task_num
+         << " ns/task" << endl;
+  }
+
+  {
+    TaskQueue queue;
+    size_t capacity = queue.capacity();
+    auto begin = std::chrono::steady_clock::now();
+    Task task;
+    for (int i = 0; i < task_num; i++) {
+      queue.push(Task(std::bind(&FakeServer::on_read, &server, (void*)1,
+                                (void*)2, (uint32_t)i)));
+      if (queue.size() >= depth) {
+        queue.pop(task);
+        task();
+      }
+    }
+    auto end = std::chrono::steady_clock::now();
+    cout << "Task ring queue:     "
+         << std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin)
+                    .count() /
+                task_num
+         << " ns/task" << endl;
+    // 任务内联存放,环形队列没有扩容,入队出队都不分配
+    EXPECT_EQ(queue.capacity(), capacity);
+  }
+  EXPECT_GT(server.sum, 0u);
+}
+
+}  // namespace MiniServer
@@ -0,0 +1,242 @@
+#include "pool/thread_pool.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using std::cout;
+using std::endl;
+
+namespace MiniServer {
+
+// 等待计数达到 target,超时返回 false
+static bool wait_count(const std::atomic<int>& count, int target,
+                       int timeout_ms = 10000) {
+  auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+  while (count.load() < target) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+// 占住唯一的工作线程,直到 release 被设置
+struct Blocker {
+  std::atomic<bool> started{false};
+  std::atomic<bool> release{false};
+  void operator()() {
+    started = true;
+    while (!release) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+};
+
+TEST(ThreadPoolTest, reject) {
+  ThreadPool pool(1, 2, QP_REJECT);
+  Blocker blocker;
+  pool.AddTask([&blocker] { blocker(); });
+  while (!blocker.started) {
+    std::this_thread::yield();
+  }
+
+  std::atomic<int> done(0);
+  std::atomic<int> dropped(0);
+  int accepted = 0;
+  for (int i = 0; i < 5; i++) {
+    if (pool.AddTask([&done] { done++; }, [&dropped] { dropped++; })) {
+      accepted++;
+    }
+  }
+  EXPECT_EQ(accepted, 2);
+  EXPECT_EQ(dropped.load(), 3);
+
+  blocker.release = true;
+  EXPECT_TRUE(wait_count(done, 2));
+  ThreadPoolStats stats = pool.get_stats();
+  EXPECT_EQ(stats.queued, 3u);
+  EXPECT_EQ(stats.rejected, 3u);
+  EXPECT_EQ(stats.dropped, 0u);
+}
+
+TEST(ThreadPoolTest, block) {
+  ThreadPool pool(1, 1, QP_BLOCK);
+  Blocker blocker;
+  pool.AddTask([&blocker] { blocker(); });
+  while (!blocker.started) {
+    std::this_thread::yield();
+  }
+
+  std::atomic<int> done(0);
+  pool.AddTask([&done] { done++; });
+  // 队列已满,提交线程阻塞到工作线程取走任务
+  std::atomic<bool> submitted(false);
+  std::thread producer([&] {
+    pool.AddTask([&done] { done++; });
+    submitted = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(submitted.load());
+
+  blocker.release = true;
+  producer.join();
+  EXPECT_TRUE(submitted.load());
+  EXPECT_TRUE(wait_count(done, 2));
+  EXPECT_EQ(pool.get_stats().rejected, 0u);
+}
+
+TEST(ThreadPoolTest, codel) {
+  // 排队目标 1ms,统计间隔 10ms
+  ThreadPool pool(1, 0, QP_CODEL, 1, 10);
+  std::atomic<int> done(0);
+  std::atomic<int> dropped(0);
+  // 每个任务 2ms,持续积压,排队时间远超目标
+  const int task_num = 200;
+  for (int i = 0; i < task_num; i++) {
+    pool.AddTask(
+        [&done] {
+          std::this_thread::sleep_for(std::chrono::milliseconds(2));
+          done++;
+        },
+        [&dropped] { dropped++; });
+  }
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (done + dropped < task_num &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_EQ(done + dropped, task_num);
+  // 过载后丢弃排队过久的任务,执行的任务远少于提交的
+  EXPECT_GT(dropped.load(), task_num / 2);
+  EXPECT_GT(done.load(), 0);
+
+  ThreadPoolStats stats = pool.get_stats();
+  EXPECT_EQ(stats.dropped, (uint64_t)dropped.load());
+  EXPECT_EQ(stats.executed, (uint64_t)done.load());
+  EXPECT_GT(stats.wait_max_us, 0u);
+  cout << "codel executed: " << stats.executed << " dropped: " << stats.dropped
+       << " avg wait(us): " << stats.wait_total_us / stats.executed
+       << " max wait(us): " << stats.wait_max_us << endl;
+}
+
+TEST(ThreadPoolTest, codel_full_queue_sheds_oldest) {
+  ThreadPool pool(1, 2, QP_CODEL);
+  Blocker blocker;
+  pool.AddTask([&blocker] { blocker(); });
+  while (!blocker.started) {
+    std::this_thread::yield();
+  }
+
+  std::atomic<int> done(0);
+  std::vector<int> dropped_ids;
+  std::mutex mtx;
+  for (int i = 0; i < 4; i++) {
+    pool.AddTask([&done] { done++; }, [&, i] {
+      std::lock_guard<std::mutex> locker(mtx);
+      dropped_ids.push_back(i);
+    });
+  }
+  // 队列满时丢弃最早的任务
+  EXPECT_EQ(dropped_ids, std::vector<int>({0, 1}));
+  blocker.release = true;
+  EXPECT_TRUE(wait_count(done, 2));
+}
+
+TEST(ThreadPoolTest, codel_resets_after_idle) {
+  // 排队目标 2ms,统计间隔 50ms
+  ThreadPool pool(1, 0, QP_CODEL, 2, 50);
+  std::atomic<int> done(0);
+  std::atomic<int> dropped(0);
+  auto count_done = [&done] { done++; };
+  auto count_dropped = [&dropped] { dropped++; };
+
+  // 第一个间隔从 first 出队开始,之后出队的任务都排队 60ms
+  Blocker first;
+  Blocker second;
+  pool.AddTask([&first] { first(); }, count_dropped);
+  while (!first.started) {
+    std::this_thread::yield();
+  }
+  pool.AddTask([&second] { second(); }, count_dropped);
+  for (int i = 0; i < 3; i++) {
+    pool.AddTask(count_done, count_dropped);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(60));
+  first.release = true;
+  while (!second.started) {
+    std::this_thread::yield();
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(60));
+  second.release = true;
+  // 上一个间隔的最短排队时间超过目标,积压的任务被丢弃
+  EXPECT_TRUE(wait_count(dropped, 3));
+  EXPECT_EQ(done.load(), 0);
+
+  // 空闲超过一个间隔后,排队超过 2 倍目标的任务也不应被丢弃
+  std::this_thread::sleep_for(std::chrono::milliseconds(120));
+  Blocker busy;
+  pool.AddTask([&busy] { busy(); }, count_dropped);
+  while (!busy.started) {
+    std::this_thread::yield();
+  }
+  pool.AddTask(count_done, count_dropped);
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  busy.release = true;
+  EXPECT_TRUE(wait_count(done, 1));
+  EXPECT_EQ(dropped.load(), 3);
+  EXPECT_EQ(pool.get_stats().dropped, 3u);
+}
+
+TEST(ThreadPoolTest, elastic) {
+  ThreadPoolConfig config;
+  config.min_threads = 1;
+  config.max_threads = 4;
+  config.grow_wait_ms = 5;
+  config.idle_timeout_ms = 100;
+  ThreadPool pool(config);
+  EXPECT_EQ(pool.get_stats().thread_count, 1u);
+
+  // 耗时任务积压,排队超过 grow_wait_ms 后逐个增加线程
+  std::atomic<int> done(0);
+  for (int i = 0; i < 40; i++) {
+    pool.AddTask([&done] {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      done++;
+    });
+  }
+  EXPECT_TRUE(wait_count(done, 40));
+  ThreadPoolStats stats = pool.get_stats();
+  EXPECT_EQ(stats.grow_count, 3u);
+  EXPECT_LE(stats.thread_count, 4u);
+
+  // 空闲超时后回到最少线程数
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (pool.get_stats().thread_count > 1 &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  stats = pool.get_stats();
+  EXPECT_EQ(stats.thread_count, 1u);
+  EXPECT_EQ(stats.shrink_count, 3u);
+
+  // 再次积压时重新增加,退出的线程在这时 join
+  done = 0;
+  for (int i = 0; i < 20; i++) {
+    pool.AddTask([&done] {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      done++;
+    });
+  }
+  EXPECT_TRUE(wait_count(done, 20));
+  EXPECT_GT(pool.get_stats().grow_count, 3u);
+}
+
+}  // namespace MiniServer
@@ -0,0 +1,114 @@
+#include "pool/work_stealing_pool.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "pool/thread_pool.h"
+
+using std::cout;
+using std::endl;
+
+namespace MiniServer {
+
+// 等待计数达到 target,超时返回 false
+static bool wait_count(const std::atomic<int>& count, int target,
+                       int timeout_ms = 10000) {
+  auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+  while (count.load() < target) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::yield();
+  }
+  return true;
+}
+
+TEST(WorkStealingPoolTest, run_all) {
+  std::atomic<int> count(0);
+  {
+    WorkStealingPool pool(4);
+    for (int i = 0; i < 10000; i++) {
+      pool.AddTask([&count] { count++; });
+    }
+    EXPECT_TRUE(wait_count(count, 10000));
+  }
+  EXPECT_EQ(count.load(), 10000);
+}
+
+TEST(WorkStealingPoolTest, nested_and_steal) {
+  std::atomic<int> count(0);
+  WorkStealingPool pool(4);
+  // 一个任务在工作线程中提交大量子任务,其他线程需要偷走它们
+  pool.AddTask([&pool, &count] {
+    for (int i = 0; i < 1000; i++) {
+      pool.AddTask([&count] {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+        count++;
+      });
+    }
+  });
+  EXPECT_TRUE(wait_count(count, 1000));
+  EXPECT_GT(pool.get_steal_count(), 0u);
+}
+
+TEST(WorkStealingPoolTest, drain_on_destroy) {
+  std::atomic<int> count(0);
+  {
+    WorkStealingPool pool(2);
+    for (int i = 0; i < 100; i++) {
+      pool.AddTask([&count] {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        count++;
+      });
+    }
+  }
+  // 析构时执行完所有已提交的任务
+  EXPECT_EQ(count.load(), 100);
+}
+
+// 多个线程同时提交很小的任务,对比单队列线程池和工作窃取线程池
+template <class Pool>
+static long long contention_benchmark(size_t worker_num, int producer_num,
+                                      int task_num) {
+  std::atomic<int> count(0);
+  Pool pool(worker_num);
+  auto begin = std::chrono::steady_clock::now();
+  std::vector<std::thread> producers;
+  for (int p = 0; p < producer_num; p++) {
+    producers.emplace_back([&pool, &count, task_num] {
+      for (int i = 0; i < task_num; i++) {
+        pool.AddTask([&count] { count.fetch_add(1, std::memory_order_relaxed); });
+      }
+    });
+  }
+  for (auto& producer : producers) {
+    producer.join();
+  }
+  EXPECT_TRUE(wait_count(count, producer_num * task_num, 60000));
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::microseconds>(end - begin)
+      .count();
+}
+
+TEST(WorkStealingPoolTest, benchmark_contention) {
+  const size_t worker_num = 8;
+  const int producer_num = 4;
+  const int task_num = 100000;
+
+  long long queue_us =
+      contention_benchmark<ThreadPool>(worker_num, producer_num, task_num);
+  long long steal_us = contention_benchmark<WorkStealingPool>(
+      worker_num, producer_num, task_num);
+  cout << "tasks: " << producer_num * task_num << " workers: " << worker_num
+       << endl;
+  cout << "ThreadPool       time(us): " << queue_us << endl;
+  cout << "WorkStealingPool time(us): " << steal_us << endl;
+}
+
+}  // namespace MiniServer
@@ -0,0 +1,102 @@
+#include "server/co_router.h"
+
+#include <gtest/gtest.h>
+
+#ifdef MINISERVER_COROUTINE
+
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+namespace MiniServer {
+
+// 手动驱动循环: 执行交付的任务和到期的定时器,直到 done 或超时
+static void pump(EventLoop& loop, const bool& done) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (!done && std::chrono::steady_clock::now() < deadline) {
+    int timeout;
+    {
+      std::lock_guard<std::mutex> locker(loop.get_timer_mtx());
+      timeout = loop.get_timer()->get_next_timeout_period();
+    }
+    int n = loop.get_mux()->wait(timeout < 0 ? 100 : timeout);
+    for (int i = 0; i < n; i++) {
+      if (get_token_type(loop.get_mux()->get_active_token(i)) == FT_WAKEUP) {
+        loop.handle_wakeup();
+      }
+    }
+  }
+}
+
+TEST(CoRouterTest, blocking_and_sleep) {
+  EventLoop loop(0);
+  BlockingExecutor executor(1);
+  std::thread::id loop_thread = std::this_thread::get_id();
+  std::thread::id blocking_thread;
+  std::thread::id resume_thread;
+
+  co_router_cb route = [&](const HttpRequest&, Buffer& body) -> RouteTask {
+    int value = co_await co_blocking([&blocking_thread] {
+      blocking_thread = std::this_thread::get_id();
+      return 42;
+    });
+    resume_thread = std::this_thread::get_id();
+    co_await co_sleep(20);
+    body.write_buffer(std::to_string(value));
+    co_return true;
+  };
+
+  CoRouteContext context;
+  context.loop = &loop;
+  context.executor = &executor;
+  context.task = route(context.request, context.body);
+  bool done = false;
+  bool result = false;
+  auto begin = std::chrono::steady_clock::now();
+  context.task.start(&context, [&](bool ok) {
+    done = true;
+    result = ok;
+  });
+  // 第一次挂起前没有完成
+  EXPECT_FALSE(done);
+  pump(loop, done);
+
+  ASSERT_TRUE(done);
+  EXPECT_TRUE(result);
+  EXPECT_EQ(context.body.read_all(), "42");
+  EXPECT_NE(blocking_thread, loop_thread);
+  EXPECT_EQ(resume_thread, loop_thread);
+  // 定时器按毫秒取整,可能提前不到 1 毫秒
+  EXPECT_GE(std::chrono::steady_clock::now() - begin,
+            std::chrono::milliseconds(19));
+  EXPECT_EQ(loop.get_user_timer_count(), 0);
+}
+
+TEST(CoRouterTest, exception_fails_route) {
+  EventLoop loop(0);
+  BlockingExecutor executor(1);
+
+  co_router_cb route = [](const HttpRequest&, Buffer&) -> RouteTask {
+    co_await co_blocking([]() -> int { throw std::runtime_error("db"); });
+    co_return true;
+  };
+
+  CoRouteContext context;
+  context.loop = &loop;
+  context.executor = &executor;
+  context.task = route(context.request, context.body);
+  bool done = false;
+  bool result = true;
+  context.task.start(&context, [&](bool ok) {
+    done = true;
+    result = ok;
+  });
+  pump(loop, done);
+
+  ASSERT_TRUE(done);
+  EXPECT_FALSE(result);
+}
+
+}  // namespace MiniServer
+
+#endif  // MINISERVER_COROUTINE
@@ -0,0 +1,74 @@
+#include "server/fd_slab.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+namespace MiniServer {
+
+struct Item {
+  int value = 0;
+};
+
+TEST(FdSlab, get_and_find) {
+  FdSlab<Item> slab(1000);
+
+  // 页未分配前 find 不会分配
+  EXPECT_EQ(slab.find(3), nullptr);
+
+  Item* item = slab.get(3);
+  ASSERT_NE(item, nullptr);
+  item->value = 3;
+  EXPECT_EQ(slab.find(3), item);
+  EXPECT_EQ(slab.get(3)->value, 3);
+
+  // 同一页内的其他 fd 已可查到,其他页仍未分配
+  EXPECT_NE(slab.find(4), nullptr);
+  EXPECT_EQ(slab.find(FdSlab<Item>::PAGE_SIZE), nullptr);
+}
+
+TEST(FdSlab, out_of_range) {
+  FdSlab<Item> slab(1000);
+
+  EXPECT_EQ(slab.get(-1), nullptr);
+  EXPECT_EQ(slab.get(1000), nullptr);
+  EXPECT_EQ(slab.find(1000), nullptr);
+  EXPECT_NE(slab.get(999), nullptr);
+}
+
+TEST(FdSlab, stable_address) {
+  FdSlab<Item> slab(65535);
+
+  Item* first = slab.get(0);
+  first->value = 1;
+  // 分配其他页之后,已有对象的地址不变
+  for (int fd = 0; fd < 65535; fd += 97) {
+    slab.get(fd);
+  }
+  EXPECT_EQ(slab.get(0), first);
+  EXPECT_EQ(first->value, 1);
+}
+
+TEST(FdSlab, concurrent_get) {
+  FdSlab<Item> slab(4096);
+  std::vector<Item*> result[4];
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; i++) {
+    threads.emplace_back([&slab, &result, i]() {
+      for (int fd = 0; fd < 4096; fd++) {
+        result[i].push_back(slab.get(fd));
+      }
+    });
+  }
+  for (std::thread& t : threads) {
+    t.join();
+  }
+  // 多个线程同时分配同一页,得到的是同一个对象
+  for (int i = 1; i < 4; i++) {
+    EXPECT_EQ(result[i], result[0]);
+  }
+}
+
+}  // namespace MiniServer
@@ -0,0 +1,114 @@
+#include "timer/time_wheel.h"
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "timer/timer.h"
+
+using std::cout;
+using std::endl;
+
+namespace MiniServer {
+
+// 一直等到所有定时器触发
+static void run_until_empty(TimerBase& timer) {
+  int next;
+  while ((next = timer.get_next_timeout_period()) >= 0) {
+    usleep(next * 1000);
+  }
+}
+
+TEST(TimeWheelTest, order) {
+  TimeWheel wheel;
+  std::vector<int> delays = {30, 5, 300, 20, 1200, 0};
+  std::vector<int> fired;
+  auto begin = Clock::now();
+
+  for (size_t i = 0; i < delays.size(); i++) {
+    int delay = delays[i];
+    wheel.add_timer(i, delay, [&fired, &begin, delay]() {
+      int elapsed =
+          std::chrono::duration_cast<MS>(Clock::now() - begin).count();
+      // 不会提前触发
+      EXPECT_GE(elapsed, delay);
+      fired.push_back(delay);
+    });
+  }
+  EXPECT_EQ(wheel.size(), delays.size());
+  run_until_empty(wheel);
+
+  EXPECT_EQ(fired, std::vector<int>({0, 5, 20, 30, 300, 1200}));
+  EXPECT_EQ(wheel.size(), 0u);
+}
+
+TEST(TimeWheelTest, adjust_cancel_do_work) {
+  TimeWheel wheel;
+  std::vector<int> fired;
+  for (int id = 0; id < 4; id++) {
+    wheel.add_timer(id, 10, [&fired, id]() { fired.push_back(id); });
+  }
+
+  // 延后 0, 取消 1, 立即执行 2
+  wheel.adjust(0, 50);
+  wheel.cancel(1);
+  wheel.do_work(2);
+  EXPECT_EQ(fired, std::vector<int>({2}));
+  // 已经删除的定时器再操作不会出错
+  wheel.cancel(1);
+  wheel.do_work(2);
+
+  run_until_empty(wheel);
+  EXPECT_EQ(fired, std::vector<int>({2, 3, 0}));
+}
+
+TEST(TimeWheelTest, readd_in_callback) {
+  TimeWheel wheel;
+  int count = 0;
+  std::function<void()> cb = [&]() {
+    if (++count < 3) {
+      // 回调中重新添加同一个定时器
+      wheel.add_timer(7, 0, cb);
+    }
+  };
+  wheel.add_timer(7, 0, cb);
+  run_until_empty(wheel);
+  EXPECT_EQ(count, 3);
+}
+
+// 对比大量连接时刷新超时的开销
+TEST(TimeWheelTest, benchmark_adjust) {
+  const int timer_num = 100000;
+  const int rounds = 10;
+
+  Timer heap;
+  TimeWheel wheel;
+  TimerBase* timers[] = {&heap, &wheel};
+  const char* names[] = {"heap ", "wheel"};
+
+  for (int t = 0; t < 2; t++) {
+    TimerBase* timer = timers[t];
+    for (int id = 0; id < timer_num; id++) {
+      timer->add_timer(id, 60000 + id % 1000, []() {});
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+      for (int id = 0; id < timer_num; id++) {
+        timer->adjust(id, 60000 + (id * 7 + r) % 5000);
+      }
+    }
+    auto end = std::chrono::steady_clock::now();
+    long long ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin)
+            .count();
+    cout << names[t] << " adjust: " << ns / (timer_num * rounds) << " ns/op"
+         << endl;
+    timer->clear();
+  }
+}
+
+}  // namespace MiniServer
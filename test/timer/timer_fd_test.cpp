@@ -0,0 +1,57 @@
+#include "timer/timer_fd.h"
+
+#include <gtest/gtest.h>
+#include <poll.h>
+
+#include <chrono>
+
+namespace MiniServer {
+
+// 等待 timerfd 可读,返回等待的毫秒数,超时返回 -1
+static int wait_readable(int fd, int timeout_ms) {
+  auto begin = std::chrono::steady_clock::now();
+  struct pollfd pfd = {fd, POLLIN, 0};
+  if (poll(&pfd, 1, timeout_ms) <= 0) {
+    return -1;
+  }
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now() - begin)
+      .count();
+}
+
+TEST(TimerFdTest, arm) {
+  TimerFd timer_fd;
+  timer_fd.arm(30);
+  int waited = wait_readable(timer_fd.get_fd(), 1000);
+  EXPECT_GE(waited, 25);
+  EXPECT_EQ(timer_fd.read_expirations(), 1u);
+
+  // 停止后不再触发
+  timer_fd.arm(10);
+  timer_fd.arm(-1);
+  EXPECT_EQ(wait_readable(timer_fd.get_fd(), 50), -1);
+
+  // 0 表示立即触发而不是停止
+  timer_fd.arm(0);
+  EXPECT_GE(wait_readable(timer_fd.get_fd(), 100), 0);
+  timer_fd.read_expirations();
+}
+
+TEST(TimerFdTest, arm_earlier) {
+  TimerFd timer_fd;
+  timer_fd.arm(500);
+  // 更早的时间生效
+  timer_fd.arm_earlier(20);
+  int waited = wait_readable(timer_fd.get_fd(), 1000);
+  EXPECT_GE(waited, 15);
+  EXPECT_LT(waited, 400);
+  timer_fd.read_expirations();
+
+  // 更晚的时间不生效
+  timer_fd.arm(20);
+  timer_fd.arm_earlier(500);
+  waited = wait_readable(timer_fd.get_fd(), 1000);
+  EXPECT_LT(waited, 400);
+}
+
+}  // namespace MiniServer